@@ -0,0 +1,13 @@
+-- Integer arithmetic in a numeric for loop, which is dominated by instruction dispatch.
+-- Compare the interpreter with the template JIT (built with -DQUOKKA_JIT):
+--   luac -o arith_loop.out bench/arith_loop.lua
+--   ./quokka arith_loop.out
+local s = 0
+
+start_time = os.clock()
+for i=1,5000000 do
+  s = s + i * 2 - (i % 7)
+end
+end_time = os.clock()
+
+print("Arith loop: " .. (end_time - start_time) .. " second(s)")
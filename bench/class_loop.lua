@@ -0,0 +1,34 @@
+-- Calls methods of objects through the __index of their class (and base class), and adds
+-- vectors with __add. Method lookups are cached by the instruction that makes them, and plain
+-- tables only pay a bit test for the metatable they don't have.
+--   luac -o class_loop.out bench/class_loop.lua
+--   ./quokka class_loop.out
+local Vec = {}
+Vec.__index = Vec
+function Vec.new(x, y) return setmetatable({ x = x, y = y }, Vec) end
+function Vec.__add(a, b) return Vec.new(a.x + b.x, a.y + b.y) end
+
+local Body = {}
+Body.__index = Body
+function Body:energy() return self.mass * (self.vel.x * self.vel.x + self.vel.y * self.vel.y) end
+function Body:step() self.pos = self.pos + self.vel end
+
+local Ship = setmetatable({}, { __index = Body })
+Ship.__index = Ship
+function Ship.new(i) return setmetatable({ mass = i, pos = Vec.new(0, 0), vel = Vec.new(1, i) }, Ship) end
+
+local ships = {}
+for i = 1, 100 do ships[i] = Ship.new(i) end
+
+start_time = os.clock()
+local energy = 0
+for r = 1, 200 do
+  for i = 1, 100 do
+    local s = ships[i]
+    s:step()
+    energy = energy + s:energy()
+  end
+end
+end_time = os.clock()
+
+print("Class loop: " .. (end_time - start_time) .. " second(s), " .. energy .. ", " .. ships[100].pos.y)
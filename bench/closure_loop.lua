@@ -0,0 +1,47 @@
+-- Creates closures in loops, as callbacks and iterators do, while many other objects are alive.
+-- Callbacks without upvals are allocated once, and the other closures reuse the slots of the
+-- closures freed before them, so the object pool is never searched.
+--   luac -o closure_loop.out bench/closure_loop.lua
+--   ./quokka closure_loop.out
+keep = {}
+for i=1,2000 do
+  keep[i] = { i }
+end
+
+local function apply(f, x)
+  return f(x)
+end
+
+local function range(n)
+  local i = 0
+  return function()
+    i = i + 1
+    if i <= n then return i end
+  end
+end
+
+local n, m = 200000, 20000
+
+start_time = os.clock()
+local s = 0
+for i=1,n do
+  s = s + apply(function(x) return x + 1 end, 1)
+end
+local callback_time = os.clock() - start_time
+
+start_time = os.clock()
+for i=1,n do
+  local k = i % 8
+  s = s + apply(function(x) return x + k end, 1)
+end
+local capture_time = os.clock() - start_time
+
+start_time = os.clock()
+for i=1,m do
+  for j in range(10) do
+    s = s + j
+  end
+end
+local iterator_time = os.clock() - start_time
+
+print("Closures: " .. n .. " callbacks in " .. callback_time .. " second(s), " .. n .. " capturing in " .. capture_time .. " second(s), " .. m .. " iterators in " .. iterator_time .. " second(s), " .. s)
@@ -0,0 +1,27 @@
+-- Recursive fib(30), which is dominated by the cost of calls and returns.
+--   luac -o fib.out bench/fib.lua
+--   ./quokka fib.out
+function fib(n)
+  if n < 2 then return n end
+  return fib(n - 1) + fib(n - 2)
+end
+
+start_time = os.clock()
+local r = fib(30)
+end_time = os.clock()
+
+print("fib(30) = " .. r .. ": " .. (end_time - start_time) .. " second(s)")
+
+-- Deep recursion, growing the register stack across many segments
+function depth(n)
+  if n == 0 then return 0 end
+  return 1 + depth(n - 1)
+end
+
+start_time = os.clock()
+for i=1,20 do
+  depth(5000)
+end
+end_time = os.clock()
+
+print("depth(5000) x20: " .. (end_time - start_time) .. " second(s)")
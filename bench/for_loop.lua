@@ -0,0 +1,19 @@
+-- Empty numeric for loops, which are dominated by OP_FORLOOP. OP_FORPREP specialises the loop
+-- for integer or float counters (OP_FORLOOP_INT / OP_FORLOOP_FLT).
+--   luac -o for_loop.out bench/for_loop.lua
+--   ./quokka for_loop.out
+start_time = os.clock()
+for j=1,100 do
+  for i=1,100000 do end
+end
+end_time = os.clock()
+
+print("Integer for loop: " .. (end_time - start_time) .. " second(s)")
+
+start_time = os.clock()
+for j=1,100 do
+  for i=0.5,100000,1.0 do end
+end
+end_time = os.clock()
+
+print("Float for loop: " .. (end_time - start_time) .. " second(s)")
@@ -0,0 +1,13 @@
+-- Calls to math and string functions, which are run inline as intrinsics (OP_CALL_INTRINSIC)
+-- when the host defines them with intrinsics::define_all.
+--   luac -o intrinsic_loop.out bench/intrinsic_loop.lua
+--   ./quokka intrinsic_loop.out
+local s = "quokka"
+start_time = os.clock()
+local total = 0
+for i=1,1000000 do
+  total = total + math.abs(-i) + math.floor(i / 3) + math.max(i, 10) + string.len(s)
+end
+end_time = os.clock()
+
+print("Intrinsic calls: " .. (end_time - start_time) .. " second(s), total " .. total)
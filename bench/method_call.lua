@@ -0,0 +1,25 @@
+-- Calls the same function as a local and as a method of a table (OP_SELF then OP_CALL).
+-- The method lookup is served by the inline cache of OP_SELF, so both loops should take
+-- about the same time.
+--   luac -o method_call.out bench/method_call.lua
+--   ./quokka method_call.out
+local counter = { n = 0, name = "counter", step = 1 }
+
+local function add(self, k)
+  self.n = self.n + k
+end
+counter.add = add
+
+start_time = os.clock()
+for i = 1, 1000000 do
+  add(counter, 1)
+end
+local local_time = os.clock() - start_time
+
+start_time = os.clock()
+for i = 1, 1000000 do
+  counter:add(1)
+end
+local method_time = os.clock() - start_time
+
+print("Local calls: " .. local_time .. " second(s), method calls: " .. method_time .. " second(s), " .. counter.n)
@@ -0,0 +1,32 @@
+-- Reads and writes the fields of record-style tables, and calls methods, in a tight loop.
+-- Each access has a constant key, so it is served by the inline cache of its instruction.
+--   luac -o record_loop.out bench/record_loop.lua
+--   ./quokka record_loop.out
+local function new_particle(i)
+  return { id = i, kind = "particle", mass = 1, x = i, y = 0, vx = 1, vy = 2, step = false }
+end
+
+local function step(p, dt)
+  p.x = p.x + p.vx * dt
+  p.y = p.y + p.vy * dt
+end
+
+local particles = {}
+for i = 1, 100 do
+  local p = new_particle(i)
+  p.step = step
+  particles[i] = p
+end
+
+start_time = os.clock()
+for r = 1, 2000 do
+  for i = 1, 100 do
+    local p = particles[i]
+    p:step(1)
+  end
+end
+end_time = os.clock()
+
+local sx = 0
+for i = 1, 100 do sx = sx + particles[i].x end
+print("Record loop: " .. (end_time - start_time) .. " second(s), " .. sx)
@@ -0,0 +1,27 @@
+-- Moves tables between registers in a tight loop, which is dominated by reference counting
+-- of the objects held in registers. Compare the default VM with deferred reference counting:
+--   luac -o table_loop.out bench/table_loop.lua
+--   ./quokka table_loop.out
+--   ./quokka table_loop.out --deferred
+t = { x = 1, y = { z = 2 } }
+
+start_time = os.clock()
+local s = 0
+for i=1,1000000 do
+  local y = t.y
+  local u = y
+  s = s + y.z + t.x + u.z
+end
+end_time = os.clock()
+
+print("Table loop: " .. (end_time - start_time) .. " second(s)")
+
+start_time = os.clock()
+for i=1,200000 do
+  local a = { x = i }
+  local b = a
+  s = s + b.x
+end
+end_time = os.clock()
+
+print("Table alloc: " .. (end_time - start_time) .. " second(s)")
@@ -0,0 +1,24 @@
+-- Creates closures while many closed upvals are alive, which stresses closing and finding
+-- open upvals.
+--   luac -o upval_loop.out bench/upval_loop.lua
+--   ./quokka upval_loop.out
+keep = {}
+for i=1,2000 do
+  local x = i
+  keep[i] = function() return x end
+end
+
+function mk(a)
+  local b = a + 1
+  local f = function() return a + b end
+  return f()
+end
+
+start_time = os.clock()
+local s = 0
+for i=1,20000 do
+  s = s + mk(i)
+end
+end_time = os.clock()
+
+print("Upval loop: " .. (end_time - start_time) .. " second(s)")
@@ -0,0 +1,32 @@
+-- Bulk arithmetic over typed arrays, as Lua loops and with the vec library (SIMD on x86-64).
+--   luac -o vec_loop.out bench/vec_loop.lua
+--   ./quokka vec_loop.out
+local n = 10000
+local a, b, c = vec.new(n), vec.new(n), vec.new(n)
+for i=1,n do
+  a[i] = i * 0.5
+  b[i] = (n - i) * 0.25
+end
+
+start_time = os.clock()
+local dot = 0
+for r=1,100 do
+  for i=1,n do
+    c[i] = a[i] * b[i] + c[i]
+  end
+  dot = 0
+  for i=1,n do
+    dot = dot + a[i] * c[i]
+  end
+end
+end_time = os.clock()
+print("Lua loops: " .. (end_time - start_time) .. " second(s), dot " .. dot)
+
+c = vec.new(n)
+start_time = os.clock()
+for r=1,100 do
+  vec.fma(c, a, b, c)
+  dot = vec.dot(a, c)
+end
+end_time = os.clock()
+print("vec: " .. (end_time - start_time) .. " second(s), dot " .. dot)
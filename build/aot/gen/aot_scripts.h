@@ -0,0 +1,13 @@
+AOT_SCRIPT(light)
+AOT_SCRIPT(arith_loop)
+AOT_SCRIPT(class_loop)
+AOT_SCRIPT(closure_loop)
+AOT_SCRIPT(fib)
+AOT_SCRIPT(for_loop)
+AOT_SCRIPT(intrinsic_loop)
+AOT_SCRIPT(method_call)
+AOT_SCRIPT(record_loop)
+AOT_SCRIPT(table_literal)
+AOT_SCRIPT(table_loop)
+AOT_SCRIPT(upval_loop)
+AOT_SCRIPT(vec_loop)
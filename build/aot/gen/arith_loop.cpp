@@ -0,0 +1,109 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with arith_loop_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t arith_loop_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    default: return pc;
+  }
+ L0:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)0));
+ L1:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[2], proto.cache(1));
+ L2:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[3], proto.cache(2));
+ L3:  // CALL
+  return 3;
+ L4:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[1], vm_ops::R(vm, 1), proto.cache(4));
+ L5:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)1));
+ L6:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)5000000));
+ L7:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1));
+ L8:  // FORPREP
+  return 8;
+ L9:  // MUL
+  vm_ops::arith<op_mul>(vm, 5, vm_ops::R(vm, 4), lua_value((lua_integer)2));
+ L10:  // ADD
+  vm_ops::arith<op_add>(vm, 5, vm_ops::R(vm, 0), vm_ops::R(vm, 5));
+ L11:  // MOD
+  vm_ops::arith<op_mod>(vm, 6, vm_ops::R(vm, 4), lua_value((lua_integer)7));
+ L12:  // SUB
+  vm_ops::arith<op_sub>(vm, 0, vm_ops::R(vm, 5), vm_ops::R(vm, 6));
+ L13:  // FORLOOP
+  if (vm_ops::forloop(vm, 1)) goto L9;
+ L14:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[2], proto.cache(14));
+ L15:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[3], proto.cache(15));
+ L16:  // CALL
+  return 16;
+ L17:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[8], vm_ops::R(vm, 1), proto.cache(17));
+ L18:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[9], proto.cache(18));
+ L19:  // LOADK
+  vm_ops::loadk(vm, 2, proto.constants[10]);
+ L20:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[8], proto.cache(20));
+ L21:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[1], proto.cache(21));
+ L22:  // SUB
+  vm_ops::arith<op_sub>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 4));
+ L23:  // LOADK
+  vm_ops::loadk(vm, 4, proto.constants[11]);
+ L24:  // CONCAT
+  return 24;
+ L25:  // CALL
+  return 25;
+ L26:  // RETURN
+  return 26;
+  return 26;
+}
+}  // namespace
+
+bool arith_loop_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    arith_loop_proto_0,
+  };
+  static const uint32_t checksums[] = {
+    4195166645u,
+  };
+  return aot_attach(chunk, functions, checksums, 1);
+}
@@ -0,0 +1,455 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with class_loop_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t class_loop_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    case 41: goto L41;
+    case 42: goto L42;
+    case 43: goto L43;
+    case 44: goto L44;
+    case 45: goto L45;
+    case 46: goto L46;
+    case 47: goto L47;
+    case 48: goto L48;
+    case 49: goto L49;
+    case 50: goto L50;
+    case 51: goto L51;
+    case 52: goto L52;
+    case 53: goto L53;
+    case 54: goto L54;
+    case 55: goto L55;
+    case 56: goto L56;
+    case 57: goto L57;
+    case 58: goto L58;
+    case 59: goto L59;
+    case 60: goto L60;
+    case 61: goto L61;
+    case 62: goto L62;
+    case 63: goto L63;
+    case 64: goto L64;
+    case 65: goto L65;
+    case 66: goto L66;
+    case 67: goto L67;
+    case 68: goto L68;
+    default: return pc;
+  }
+ L0:  // NEWTABLE
+  vm_ops::newtable(vm, 0, 0, 0);
+ L1:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[0], vm_ops::R(vm, 0), proto.cache(1));
+ L2:  // CLOSURE
+  return 2;
+ L3:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[1], vm_ops::R(vm, 1), proto.cache(3));
+ L4:  // CLOSURE
+  return 4;
+ L5:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[2], vm_ops::R(vm, 1), proto.cache(5));
+ L6:  // NEWTABLE
+  vm_ops::newtable(vm, 1, 0, 0);
+ L7:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[0], vm_ops::R(vm, 1), proto.cache(7));
+ L8:  // CLOSURE
+  return 8;
+ L9:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[3], vm_ops::R(vm, 2), proto.cache(9));
+ L10:  // CLOSURE
+  return 10;
+ L11:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[4], vm_ops::R(vm, 2), proto.cache(11));
+ L12:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[5], proto.cache(12));
+ L13:  // NEWTABLE
+  vm_ops::newtable(vm, 3, 0, 0);
+ L14:  // NEWTABLE
+  vm_ops::newtable(vm, 4, 0, 1);
+ L15:  // SETTABLE
+  vm_ops::settable(vm, 4, proto.constants[0], vm_ops::R(vm, 1), proto.cache(15));
+ L16:  // CALL
+  return 16;
+ L17:  // SETTABLE
+  vm_ops::settable(vm, 2, proto.constants[0], vm_ops::R(vm, 2), proto.cache(17));
+ L18:  // CLOSURE
+  return 18;
+ L19:  // SETTABLE
+  vm_ops::settable(vm, 2, proto.constants[6], vm_ops::R(vm, 3), proto.cache(19));
+ L20:  // NEWTABLE
+  vm_ops::newtable(vm, 3, 0, 0);
+ L21:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)1));
+ L22:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)100));
+ L23:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)1));
+ L24:  // FORPREP
+  return 24;
+ L25:  // GETTABLE
+  vm_ops::gettable(vm, 8, 2, proto.constants[9], proto.cache(25));
+ L26:  // MOVE
+  vm_ops::move(vm, 9, 7);
+ L27:  // CALL
+  return 27;
+ L28:  // SETTABLE
+  vm_ops::settable(vm, 3, vm_ops::R(vm, 7), vm_ops::R(vm, 8));
+ L29:  // FORLOOP
+  if (vm_ops::forloop(vm, 4)) goto L25;
+ L30:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[11], proto.cache(30));
+ L31:  // GETTABLE
+  vm_ops::gettable(vm, 4, 4, proto.constants[12], proto.cache(31));
+ L32:  // CALL
+  return 32;
+ L33:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[10], vm_ops::R(vm, 4), proto.cache(33));
+ L34:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)0));
+ L35:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)1));
+ L36:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)200));
+ L37:  // LOADK
+  vm_ops::loadk(vm, 7, lua_value((lua_integer)1));
+ L38:  // FORPREP
+  return 38;
+ L39:  // LOADK
+  vm_ops::loadk(vm, 9, lua_value((lua_integer)1));
+ L40:  // LOADK
+  vm_ops::loadk(vm, 10, lua_value((lua_integer)100));
+ L41:  // LOADK
+  vm_ops::loadk(vm, 11, lua_value((lua_integer)1));
+ L42:  // FORPREP
+  return 42;
+ L43:  // GETTABLE
+  vm_ops::gettable(vm, 13, 3, vm_ops::R(vm, 12));
+ L44:  // SELF
+  vm_ops::self(vm, 14, 13, proto.constants[4], proto.cache(44));
+ L45:  // CALL
+  return 45;
+ L46:  // SELF
+  vm_ops::self(vm, 14, 13, proto.constants[3], proto.cache(46));
+ L47:  // CALL
+  return 47;
+ L48:  // ADD
+  vm_ops::arith<op_add>(vm, 4, vm_ops::R(vm, 4), vm_ops::R(vm, 14));
+ L49:  // FORLOOP
+  if (vm_ops::forloop(vm, 9)) goto L43;
+ L50:  // FORLOOP
+  if (vm_ops::forloop(vm, 5)) goto L39;
+ L51:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[11], proto.cache(51));
+ L52:  // GETTABLE
+  vm_ops::gettable(vm, 5, 5, proto.constants[12], proto.cache(52));
+ L53:  // CALL
+  return 53;
+ L54:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[15], vm_ops::R(vm, 5), proto.cache(54));
+ L55:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[16], proto.cache(55));
+ L56:  // LOADK
+  vm_ops::loadk(vm, 6, proto.constants[17]);
+ L57:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[15], proto.cache(57));
+ L58:  // GETTABUP
+  vm_ops::gettabup(vm, 8, 0, proto.constants[10], proto.cache(58));
+ L59:  // SUB
+  vm_ops::arith<op_sub>(vm, 7, vm_ops::R(vm, 7), vm_ops::R(vm, 8));
+ L60:  // LOADK
+  vm_ops::loadk(vm, 8, proto.constants[18]);
+ L61:  // MOVE
+  vm_ops::move(vm, 9, 4);
+ L62:  // LOADK
+  vm_ops::loadk(vm, 10, proto.constants[19]);
+ L63:  // GETTABLE
+  vm_ops::gettable(vm, 11, 3, lua_value((lua_integer)100), proto.cache(63));
+ L64:  // GETTABLE
+  vm_ops::gettable(vm, 11, 11, proto.constants[20], proto.cache(64));
+ L65:  // GETTABLE
+  vm_ops::gettable(vm, 11, 11, proto.constants[21], proto.cache(65));
+ L66:  // CONCAT
+  return 66;
+ L67:  // CALL
+  return 67;
+ L68:  // RETURN
+  return 68;
+  return 68;
+}
+
+size_t class_loop_proto_1(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    default: return pc;
+  }
+ L0:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[0], proto.cache(0));
+ L1:  // NEWTABLE
+  vm_ops::newtable(vm, 3, 0, 2);
+ L2:  // SETTABLE
+  vm_ops::settable(vm, 3, proto.constants[1], vm_ops::R(vm, 0), proto.cache(2));
+ L3:  // SETTABLE
+  vm_ops::settable(vm, 3, proto.constants[2], vm_ops::R(vm, 1), proto.cache(3));
+ L4:  // GETUPVAL
+  vm_ops::getupval(vm, 4, 1);
+ L5:  // TAILCALL
+  return 5;
+ L6:  // RETURN
+  return 6;
+ L7:  // RETURN
+  return 7;
+  return 7;
+}
+
+size_t class_loop_proto_2(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    default: return pc;
+  }
+ L0:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[0], proto.cache(0));
+ L1:  // GETTABLE
+  vm_ops::gettable(vm, 3, 0, proto.constants[1], proto.cache(1));
+ L2:  // GETTABLE
+  vm_ops::gettable(vm, 4, 1, proto.constants[1], proto.cache(2));
+ L3:  // ADD
+  vm_ops::arith<op_add>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 4));
+ L4:  // GETTABLE
+  vm_ops::gettable(vm, 4, 0, proto.constants[2], proto.cache(4));
+ L5:  // GETTABLE
+  vm_ops::gettable(vm, 5, 1, proto.constants[2], proto.cache(5));
+ L6:  // ADD
+  vm_ops::arith<op_add>(vm, 4, vm_ops::R(vm, 4), vm_ops::R(vm, 5));
+ L7:  // TAILCALL
+  return 7;
+ L8:  // RETURN
+  return 8;
+ L9:  // RETURN
+  return 9;
+  return 9;
+}
+
+size_t class_loop_proto_3(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    default: return pc;
+  }
+ L0:  // GETTABLE
+  vm_ops::gettable(vm, 1, 0, proto.constants[0], proto.cache(0));
+ L1:  // GETTABLE
+  vm_ops::gettable(vm, 2, 0, proto.constants[1], proto.cache(1));
+ L2:  // GETTABLE
+  vm_ops::gettable(vm, 2, 2, proto.constants[2], proto.cache(2));
+ L3:  // GETTABLE
+  vm_ops::gettable(vm, 3, 0, proto.constants[1], proto.cache(3));
+ L4:  // GETTABLE
+  vm_ops::gettable(vm, 3, 3, proto.constants[2], proto.cache(4));
+ L5:  // MUL
+  vm_ops::arith<op_mul>(vm, 2, vm_ops::R(vm, 2), vm_ops::R(vm, 3));
+ L6:  // GETTABLE
+  vm_ops::gettable(vm, 3, 0, proto.constants[1], proto.cache(6));
+ L7:  // GETTABLE
+  vm_ops::gettable(vm, 3, 3, proto.constants[3], proto.cache(7));
+ L8:  // GETTABLE
+  vm_ops::gettable(vm, 4, 0, proto.constants[1], proto.cache(8));
+ L9:  // GETTABLE
+  vm_ops::gettable(vm, 4, 4, proto.constants[3], proto.cache(9));
+ L10:  // MUL
+  vm_ops::arith<op_mul>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 4));
+ L11:  // ADD
+  vm_ops::arith<op_add>(vm, 2, vm_ops::R(vm, 2), vm_ops::R(vm, 3));
+ L12:  // MUL
+  vm_ops::arith<op_mul>(vm, 1, vm_ops::R(vm, 1), vm_ops::R(vm, 2));
+ L13:  // RETURN
+  return 13;
+ L14:  // RETURN
+  return 14;
+  return 14;
+}
+
+size_t class_loop_proto_4(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    default: return pc;
+  }
+ L0:  // GETTABLE
+  vm_ops::gettable(vm, 1, 0, proto.constants[0], proto.cache(0));
+ L1:  // GETTABLE
+  vm_ops::gettable(vm, 2, 0, proto.constants[1], proto.cache(1));
+ L2:  // ADD
+  vm_ops::arith<op_add>(vm, 1, vm_ops::R(vm, 1), vm_ops::R(vm, 2));
+ L3:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[0], vm_ops::R(vm, 1), proto.cache(3));
+ L4:  // RETURN
+  return 4;
+  return 4;
+}
+
+size_t class_loop_proto_5(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    default: return pc;
+  }
+ L0:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[0], proto.cache(0));
+ L1:  // NEWTABLE
+  vm_ops::newtable(vm, 2, 0, 3);
+ L2:  // SETTABLE
+  vm_ops::settable(vm, 2, proto.constants[1], vm_ops::R(vm, 0), proto.cache(2));
+ L3:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 1, proto.constants[3], proto.cache(3));
+ L4:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)0));
+ L5:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)0));
+ L6:  // CALL
+  return 6;
+ L7:  // SETTABLE
+  vm_ops::settable(vm, 2, proto.constants[2], vm_ops::R(vm, 3), proto.cache(7));
+ L8:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 1, proto.constants[3], proto.cache(8));
+ L9:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)1));
+ L10:  // MOVE
+  vm_ops::move(vm, 5, 0);
+ L11:  // CALL
+  return 11;
+ L12:  // SETTABLE
+  vm_ops::settable(vm, 2, proto.constants[5], vm_ops::R(vm, 3), proto.cache(12));
+ L13:  // GETUPVAL
+  vm_ops::getupval(vm, 3, 2);
+ L14:  // TAILCALL
+  return 14;
+ L15:  // RETURN
+  return 15;
+ L16:  // RETURN
+  return 16;
+  return 16;
+}
+}  // namespace
+
+bool class_loop_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    class_loop_proto_0,
+    class_loop_proto_1,
+    class_loop_proto_2,
+    class_loop_proto_3,
+    class_loop_proto_4,
+    class_loop_proto_5,
+  };
+  static const uint32_t checksums[] = {
+    1373597569u,
+    4043527671u,
+    2507925852u,
+    1809694400u,
+    1553048024u,
+    3501003091u,
+  };
+  return aot_attach(chunk, functions, checksums, 6);
+}
@@ -0,0 +1,450 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with closure_loop_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t closure_loop_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    case 41: goto L41;
+    case 42: goto L42;
+    case 43: goto L43;
+    case 44: goto L44;
+    case 45: goto L45;
+    case 46: goto L46;
+    case 47: goto L47;
+    case 48: goto L48;
+    case 49: goto L49;
+    case 50: goto L50;
+    case 51: goto L51;
+    case 52: goto L52;
+    case 53: goto L53;
+    case 54: goto L54;
+    case 55: goto L55;
+    case 56: goto L56;
+    case 57: goto L57;
+    case 58: goto L58;
+    case 59: goto L59;
+    case 60: goto L60;
+    case 61: goto L61;
+    case 62: goto L62;
+    case 63: goto L63;
+    case 64: goto L64;
+    case 65: goto L65;
+    case 66: goto L66;
+    case 67: goto L67;
+    case 68: goto L68;
+    case 69: goto L69;
+    case 70: goto L70;
+    case 71: goto L71;
+    case 72: goto L72;
+    case 73: goto L73;
+    case 74: goto L74;
+    case 75: goto L75;
+    case 76: goto L76;
+    case 77: goto L77;
+    case 78: goto L78;
+    case 79: goto L79;
+    case 80: goto L80;
+    case 81: goto L81;
+    case 82: goto L82;
+    case 83: goto L83;
+    case 84: goto L84;
+    case 85: goto L85;
+    case 86: goto L86;
+    case 87: goto L87;
+    case 88: goto L88;
+    case 89: goto L89;
+    case 90: goto L90;
+    case 91: goto L91;
+    case 92: goto L92;
+    case 93: goto L93;
+    case 94: goto L94;
+    case 95: goto L95;
+    default: return pc;
+  }
+ L0:  // NEWTABLE
+  vm_ops::newtable(vm, 0, 0, 0);
+ L1:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[0], vm_ops::R(vm, 0), proto.cache(1));
+ L2:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)1));
+ L3:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)2000));
+ L4:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)1));
+ L5:  // FORPREP
+  return 5;
+ L6:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[0], proto.cache(6));
+ L7:  // NEWTABLE
+  vm_ops::newtable(vm, 5, 1, 0);
+ L8:  // MOVE
+  vm_ops::move(vm, 6, 3);
+ L9:  // SETLIST
+  return 9;
+ L10:  // SETTABLE
+  vm_ops::settable(vm, 4, vm_ops::R(vm, 3), vm_ops::R(vm, 5));
+ L11:  // FORLOOP
+  if (vm_ops::forloop(vm, 0)) goto L6;
+ L12:  // CLOSURE
+  return 12;
+ L13:  // CLOSURE
+  return 13;
+ L14:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)200000));
+ L15:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)20000));
+ L16:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[6], proto.cache(16));
+ L17:  // GETTABLE
+  vm_ops::gettable(vm, 4, 4, proto.constants[7], proto.cache(17));
+ L18:  // CALL
+  return 18;
+ L19:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[5], vm_ops::R(vm, 4), proto.cache(19));
+ L20:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)0));
+ L21:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)1));
+ L22:  // MOVE
+  vm_ops::move(vm, 6, 2);
+ L23:  // LOADK
+  vm_ops::loadk(vm, 7, lua_value((lua_integer)1));
+ L24:  // FORPREP
+  return 24;
+ L25:  // MOVE
+  vm_ops::move(vm, 9, 0);
+ L26:  // CLOSURE
+  return 26;
+ L27:  // LOADK
+  vm_ops::loadk(vm, 11, lua_value((lua_integer)1));
+ L28:  // CALL
+  return 28;
+ L29:  // ADD
+  vm_ops::arith<op_add>(vm, 4, vm_ops::R(vm, 4), vm_ops::R(vm, 9));
+ L30:  // FORLOOP
+  if (vm_ops::forloop(vm, 5)) goto L25;
+ L31:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[6], proto.cache(31));
+ L32:  // GETTABLE
+  vm_ops::gettable(vm, 5, 5, proto.constants[7], proto.cache(32));
+ L33:  // CALL
+  return 33;
+ L34:  // GETTABUP
+  vm_ops::gettabup(vm, 6, 0, proto.constants[5], proto.cache(34));
+ L35:  // SUB
+  vm_ops::arith<op_sub>(vm, 5, vm_ops::R(vm, 5), vm_ops::R(vm, 6));
+ L36:  // GETTABUP
+  vm_ops::gettabup(vm, 6, 0, proto.constants[6], proto.cache(36));
+ L37:  // GETTABLE
+  vm_ops::gettable(vm, 6, 6, proto.constants[7], proto.cache(37));
+ L38:  // CALL
+  return 38;
+ L39:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[5], vm_ops::R(vm, 6), proto.cache(39));
+ L40:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)1));
+ L41:  // MOVE
+  vm_ops::move(vm, 7, 2);
+ L42:  // LOADK
+  vm_ops::loadk(vm, 8, lua_value((lua_integer)1));
+ L43:  // FORPREP
+  return 43;
+ L44:  // MOD
+  vm_ops::arith<op_mod>(vm, 10, vm_ops::R(vm, 9), lua_value((lua_integer)8));
+ L45:  // MOVE
+  vm_ops::move(vm, 11, 0);
+ L46:  // CLOSURE
+  return 46;
+ L47:  // LOADK
+  vm_ops::loadk(vm, 13, lua_value((lua_integer)1));
+ L48:  // CALL
+  return 48;
+ L49:  // ADD
+  vm_ops::arith<op_add>(vm, 4, vm_ops::R(vm, 4), vm_ops::R(vm, 11));
+ L50:  // JMP
+  vm_ops::close(vm, 11);
+  goto L51;
+ L51:  // FORLOOP
+  if (vm_ops::forloop(vm, 6)) goto L44;
+ L52:  // GETTABUP
+  vm_ops::gettabup(vm, 6, 0, proto.constants[6], proto.cache(52));
+ L53:  // GETTABLE
+  vm_ops::gettable(vm, 6, 6, proto.constants[7], proto.cache(53));
+ L54:  // CALL
+  return 54;
+ L55:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[5], proto.cache(55));
+ L56:  // SUB
+  vm_ops::arith<op_sub>(vm, 6, vm_ops::R(vm, 6), vm_ops::R(vm, 7));
+ L57:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[6], proto.cache(57));
+ L58:  // GETTABLE
+  vm_ops::gettable(vm, 7, 7, proto.constants[7], proto.cache(58));
+ L59:  // CALL
+  return 59;
+ L60:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[5], vm_ops::R(vm, 7), proto.cache(60));
+ L61:  // LOADK
+  vm_ops::loadk(vm, 7, lua_value((lua_integer)1));
+ L62:  // MOVE
+  vm_ops::move(vm, 8, 3);
+ L63:  // LOADK
+  vm_ops::loadk(vm, 9, lua_value((lua_integer)1));
+ L64:  // FORPREP
+  return 64;
+ L65:  // MOVE
+  vm_ops::move(vm, 11, 1);
+ L66:  // LOADK
+  vm_ops::loadk(vm, 12, lua_value((lua_integer)10));
+ L67:  // CALL
+  return 67;
+ L68:  // JMP
+  goto L70;
+ L69:  // ADD
+  vm_ops::arith<op_add>(vm, 4, vm_ops::R(vm, 4), vm_ops::R(vm, 14));
+ L70:  // TFORCALL
+  return 70;
+ L71:  // TFORLOOP
+  if (vm_ops::tforloop(vm, 13)) goto L69;
+ L72:  // FORLOOP
+  if (vm_ops::forloop(vm, 7)) goto L65;
+ L73:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[6], proto.cache(73));
+ L74:  // GETTABLE
+  vm_ops::gettable(vm, 7, 7, proto.constants[7], proto.cache(74));
+ L75:  // CALL
+  return 75;
+ L76:  // GETTABUP
+  vm_ops::gettabup(vm, 8, 0, proto.constants[5], proto.cache(76));
+ L77:  // SUB
+  vm_ops::arith<op_sub>(vm, 7, vm_ops::R(vm, 7), vm_ops::R(vm, 8));
+ L78:  // GETTABUP
+  vm_ops::gettabup(vm, 8, 0, proto.constants[13], proto.cache(78));
+ L79:  // LOADK
+  vm_ops::loadk(vm, 9, proto.constants[14]);
+ L80:  // MOVE
+  vm_ops::move(vm, 10, 2);
+ L81:  // LOADK
+  vm_ops::loadk(vm, 11, proto.constants[15]);
+ L82:  // MOVE
+  vm_ops::move(vm, 12, 5);
+ L83:  // LOADK
+  vm_ops::loadk(vm, 13, proto.constants[16]);
+ L84:  // MOVE
+  vm_ops::move(vm, 14, 2);
+ L85:  // LOADK
+  vm_ops::loadk(vm, 15, proto.constants[17]);
+ L86:  // MOVE
+  vm_ops::move(vm, 16, 6);
+ L87:  // LOADK
+  vm_ops::loadk(vm, 17, proto.constants[16]);
+ L88:  // MOVE
+  vm_ops::move(vm, 18, 3);
+ L89:  // LOADK
+  vm_ops::loadk(vm, 19, proto.constants[18]);
+ L90:  // MOVE
+  vm_ops::move(vm, 20, 7);
+ L91:  // LOADK
+  vm_ops::loadk(vm, 21, proto.constants[16]);
+ L92:  // MOVE
+  vm_ops::move(vm, 22, 4);
+ L93:  // CONCAT
+  return 93;
+ L94:  // CALL
+  return 94;
+ L95:  // RETURN
+  return 95;
+  return 95;
+}
+
+size_t closure_loop_proto_1(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    default: return pc;
+  }
+ L0:  // MOVE
+  vm_ops::move(vm, 2, 0);
+ L1:  // MOVE
+  vm_ops::move(vm, 3, 1);
+ L2:  // TAILCALL
+  return 2;
+ L3:  // RETURN
+  return 3;
+ L4:  // RETURN
+  return 4;
+  return 4;
+}
+
+size_t closure_loop_proto_2(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    default: return pc;
+  }
+ L0:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)0));
+ L1:  // CLOSURE
+  return 1;
+ L2:  // RETURN
+  return 2;
+ L3:  // RETURN
+  return 3;
+  return 3;
+}
+
+size_t closure_loop_proto_3(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    default: return pc;
+  }
+ L0:  // GETUPVAL
+  vm_ops::getupval(vm, 0, 0);
+ L1:  // ADD
+  vm_ops::arith<op_add>(vm, 0, vm_ops::R(vm, 0), lua_value((lua_integer)1));
+ L2:  // SETUPVAL
+  vm_ops::setupval(vm, 0, 0);
+ L3:  // GETUPVAL
+  vm_ops::getupval(vm, 0, 0);
+ L4:  // GETUPVAL
+  vm_ops::getupval(vm, 1, 1);
+ L5:  // LE
+  if (vm_ops::le(vm, vm_ops::R(vm, 0), vm_ops::R(vm, 1)) != false) goto L7;
+ L6:  // JMP
+  goto L9;
+ L7:  // GETUPVAL
+  vm_ops::getupval(vm, 0, 0);
+ L8:  // RETURN
+  return 8;
+ L9:  // RETURN
+  return 9;
+  return 9;
+}
+
+size_t closure_loop_proto_4(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    default: return pc;
+  }
+ L0:  // ADD
+  vm_ops::arith<op_add>(vm, 1, vm_ops::R(vm, 0), lua_value((lua_integer)1));
+ L1:  // RETURN
+  return 1;
+ L2:  // RETURN
+  return 2;
+  return 2;
+}
+
+size_t closure_loop_proto_5(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    default: return pc;
+  }
+ L0:  // GETUPVAL
+  vm_ops::getupval(vm, 1, 0);
+ L1:  // ADD
+  vm_ops::arith<op_add>(vm, 1, vm_ops::R(vm, 0), vm_ops::R(vm, 1));
+ L2:  // RETURN
+  return 2;
+ L3:  // RETURN
+  return 3;
+  return 3;
+}
+}  // namespace
+
+bool closure_loop_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    closure_loop_proto_0,
+    closure_loop_proto_1,
+    closure_loop_proto_2,
+    closure_loop_proto_3,
+    closure_loop_proto_4,
+    closure_loop_proto_5,
+  };
+  static const uint32_t checksums[] = {
+    1366617351u,
+    2209713251u,
+    335515415u,
+    2825170673u,
+    643311351u,
+    777713678u,
+  };
+  return aot_attach(chunk, functions, checksums, 6);
+}
@@ -0,0 +1,266 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with fib_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t fib_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    case 41: goto L41;
+    case 42: goto L42;
+    case 43: goto L43;
+    case 44: goto L44;
+    case 45: goto L45;
+    case 46: goto L46;
+    case 47: goto L47;
+    case 48: goto L48;
+    case 49: goto L49;
+    default: return pc;
+  }
+ L0:  // CLOSURE
+  return 0;
+ L1:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[0], vm_ops::R(vm, 0), proto.cache(1));
+ L2:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[2], proto.cache(2));
+ L3:  // GETTABLE
+  vm_ops::gettable(vm, 0, 0, proto.constants[3], proto.cache(3));
+ L4:  // CALL
+  return 4;
+ L5:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[1], vm_ops::R(vm, 0), proto.cache(5));
+ L6:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[4], proto.cache(6));
+ L7:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)30));
+ L8:  // CALL
+  return 8;
+ L9:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[2], proto.cache(9));
+ L10:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[3], proto.cache(10));
+ L11:  // CALL
+  return 11;
+ L12:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[6], vm_ops::R(vm, 1), proto.cache(12));
+ L13:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[7], proto.cache(13));
+ L14:  // LOADK
+  vm_ops::loadk(vm, 2, proto.constants[8]);
+ L15:  // MOVE
+  vm_ops::move(vm, 3, 0);
+ L16:  // LOADK
+  vm_ops::loadk(vm, 4, proto.constants[9]);
+ L17:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[6], proto.cache(17));
+ L18:  // GETTABUP
+  vm_ops::gettabup(vm, 6, 0, proto.constants[1], proto.cache(18));
+ L19:  // SUB
+  vm_ops::arith<op_sub>(vm, 5, vm_ops::R(vm, 5), vm_ops::R(vm, 6));
+ L20:  // LOADK
+  vm_ops::loadk(vm, 6, proto.constants[10]);
+ L21:  // CONCAT
+  return 21;
+ L22:  // CALL
+  return 22;
+ L23:  // CLOSURE
+  return 23;
+ L24:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[11], vm_ops::R(vm, 1), proto.cache(24));
+ L25:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[2], proto.cache(25));
+ L26:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[3], proto.cache(26));
+ L27:  // CALL
+  return 27;
+ L28:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[1], vm_ops::R(vm, 1), proto.cache(28));
+ L29:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)1));
+ L30:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)20));
+ L31:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1));
+ L32:  // FORPREP
+  return 32;
+ L33:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[14], proto.cache(33));
+ L34:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)5000));
+ L35:  // CALL
+  return 35;
+ L36:  // FORLOOP
+  if (vm_ops::forloop(vm, 1)) goto L33;
+ L37:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[2], proto.cache(37));
+ L38:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[3], proto.cache(38));
+ L39:  // CALL
+  return 39;
+ L40:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[6], vm_ops::R(vm, 1), proto.cache(40));
+ L41:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[7], proto.cache(41));
+ L42:  // LOADK
+  vm_ops::loadk(vm, 2, proto.constants[16]);
+ L43:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[6], proto.cache(43));
+ L44:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[1], proto.cache(44));
+ L45:  // SUB
+  vm_ops::arith<op_sub>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 4));
+ L46:  // LOADK
+  vm_ops::loadk(vm, 4, proto.constants[10]);
+ L47:  // CONCAT
+  return 47;
+ L48:  // CALL
+  return 48;
+ L49:  // RETURN
+  return 49;
+  return 49;
+}
+
+size_t fib_proto_1(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    default: return pc;
+  }
+ L0:  // LT
+  if (vm_ops::lt(vm, vm_ops::R(vm, 0), lua_value((lua_integer)2)) != false) goto L2;
+ L1:  // JMP
+  goto L3;
+ L2:  // RETURN
+  return 2;
+ L3:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[1], proto.cache(3));
+ L4:  // SUB
+  vm_ops::arith<op_sub>(vm, 2, vm_ops::R(vm, 0), lua_value((lua_integer)1));
+ L5:  // CALL
+  return 5;
+ L6:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[1], proto.cache(6));
+ L7:  // SUB
+  vm_ops::arith<op_sub>(vm, 3, vm_ops::R(vm, 0), lua_value((lua_integer)2));
+ L8:  // CALL
+  return 8;
+ L9:  // ADD
+  vm_ops::arith<op_add>(vm, 1, vm_ops::R(vm, 1), vm_ops::R(vm, 2));
+ L10:  // RETURN
+  return 10;
+ L11:  // RETURN
+  return 11;
+  return 11;
+}
+
+size_t fib_proto_2(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    default: return pc;
+  }
+ L0:  // EQ
+  if (vm_ops::eq(vm, vm_ops::R(vm, 0), lua_value((lua_integer)0)) != false) goto L2;
+ L1:  // JMP
+  goto L4;
+ L2:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)0));
+ L3:  // RETURN
+  return 3;
+ L4:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[1], proto.cache(4));
+ L5:  // SUB
+  vm_ops::arith<op_sub>(vm, 2, vm_ops::R(vm, 0), lua_value((lua_integer)1));
+ L6:  // CALL
+  return 6;
+ L7:  // ADD
+  vm_ops::arith<op_add>(vm, 1, lua_value((lua_integer)1), vm_ops::R(vm, 1));
+ L8:  // RETURN
+  return 8;
+ L9:  // RETURN
+  return 9;
+  return 9;
+}
+}  // namespace
+
+bool fib_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    fib_proto_0,
+    fib_proto_1,
+    fib_proto_2,
+  };
+  static const uint32_t checksums[] = {
+    3783276274u,
+    4280126636u,
+    593760998u,
+  };
+  return aot_attach(chunk, functions, checksums, 3);
+}
@@ -0,0 +1,187 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with for_loop_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t for_loop_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    case 41: goto L41;
+    case 42: goto L42;
+    case 43: goto L43;
+    case 44: goto L44;
+    case 45: goto L45;
+    case 46: goto L46;
+    case 47: goto L47;
+    case 48: goto L48;
+    case 49: goto L49;
+    case 50: goto L50;
+    case 51: goto L51;
+    case 52: goto L52;
+    default: return pc;
+  }
+ L0:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[1], proto.cache(0));
+ L1:  // GETTABLE
+  vm_ops::gettable(vm, 0, 0, proto.constants[2], proto.cache(1));
+ L2:  // CALL
+  return 2;
+ L3:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[0], vm_ops::R(vm, 0), proto.cache(3));
+ L4:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)1));
+ L5:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)100));
+ L6:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)1));
+ L7:  // FORPREP
+  return 7;
+ L8:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)1));
+ L9:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)100000));
+ L10:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)1));
+ L11:  // FORPREP
+  return 11;
+ L12:  // FORLOOP
+  if (vm_ops::forloop(vm, 4)) goto L12;
+ L13:  // FORLOOP
+  if (vm_ops::forloop(vm, 0)) goto L8;
+ L14:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[1], proto.cache(14));
+ L15:  // GETTABLE
+  vm_ops::gettable(vm, 0, 0, proto.constants[2], proto.cache(15));
+ L16:  // CALL
+  return 16;
+ L17:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[6], vm_ops::R(vm, 0), proto.cache(17));
+ L18:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[7], proto.cache(18));
+ L19:  // LOADK
+  vm_ops::loadk(vm, 1, proto.constants[8]);
+ L20:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[6], proto.cache(20));
+ L21:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[0], proto.cache(21));
+ L22:  // SUB
+  vm_ops::arith<op_sub>(vm, 2, vm_ops::R(vm, 2), vm_ops::R(vm, 3));
+ L23:  // LOADK
+  vm_ops::loadk(vm, 3, proto.constants[9]);
+ L24:  // CONCAT
+  return 24;
+ L25:  // CALL
+  return 25;
+ L26:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[1], proto.cache(26));
+ L27:  // GETTABLE
+  vm_ops::gettable(vm, 0, 0, proto.constants[2], proto.cache(27));
+ L28:  // CALL
+  return 28;
+ L29:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[0], vm_ops::R(vm, 0), proto.cache(29));
+ L30:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)1));
+ L31:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)100));
+ L32:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)1));
+ L33:  // FORPREP
+  return 33;
+ L34:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_number)0x1p-1));
+ L35:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)100000));
+ L36:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_number)0x1p+0));
+ L37:  // FORPREP
+  return 37;
+ L38:  // FORLOOP
+  if (vm_ops::forloop(vm, 4)) goto L38;
+ L39:  // FORLOOP
+  if (vm_ops::forloop(vm, 0)) goto L34;
+ L40:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[1], proto.cache(40));
+ L41:  // GETTABLE
+  vm_ops::gettable(vm, 0, 0, proto.constants[2], proto.cache(41));
+ L42:  // CALL
+  return 42;
+ L43:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[6], vm_ops::R(vm, 0), proto.cache(43));
+ L44:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[7], proto.cache(44));
+ L45:  // LOADK
+  vm_ops::loadk(vm, 1, proto.constants[12]);
+ L46:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[6], proto.cache(46));
+ L47:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[0], proto.cache(47));
+ L48:  // SUB
+  vm_ops::arith<op_sub>(vm, 2, vm_ops::R(vm, 2), vm_ops::R(vm, 3));
+ L49:  // LOADK
+  vm_ops::loadk(vm, 3, proto.constants[9]);
+ L50:  // CONCAT
+  return 50;
+ L51:  // CALL
+  return 51;
+ L52:  // RETURN
+  return 52;
+  return 52;
+}
+}  // namespace
+
+bool for_loop_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    for_loop_proto_0,
+  };
+  static const uint32_t checksums[] = {
+    1607478166u,
+  };
+  return aot_attach(chunk, functions, checksums, 1);
+}
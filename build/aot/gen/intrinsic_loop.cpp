@@ -0,0 +1,166 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with intrinsic_loop_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t intrinsic_loop_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    case 41: goto L41;
+    case 42: goto L42;
+    case 43: goto L43;
+    case 44: goto L44;
+    case 45: goto L45;
+    default: return pc;
+  }
+ L0:  // LOADK
+  vm_ops::loadk(vm, 0, proto.constants[0]);
+ L1:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[2], proto.cache(1));
+ L2:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[3], proto.cache(2));
+ L3:  // CALL
+  return 3;
+ L4:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[1], vm_ops::R(vm, 1), proto.cache(4));
+ L5:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)0));
+ L6:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)1));
+ L7:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1000000));
+ L8:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)1));
+ L9:  // FORPREP
+  return 9;
+ L10:  // GETTABUP
+  vm_ops::gettabup(vm, 6, 0, proto.constants[7], proto.cache(10));
+ L11:  // GETTABLE
+  vm_ops::gettable(vm, 6, 6, proto.constants[8], proto.cache(11));
+ L12:  // UNM
+  vm_ops::unm(vm, 7, 5);
+ L13:  // CALL
+  return 13;
+ L14:  // ADD
+  vm_ops::arith<op_add>(vm, 6, vm_ops::R(vm, 1), vm_ops::R(vm, 6));
+ L15:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[7], proto.cache(15));
+ L16:  // GETTABLE
+  vm_ops::gettable(vm, 7, 7, proto.constants[9], proto.cache(16));
+ L17:  // DIV
+  return 17;
+ L18:  // CALL
+  return 18;
+ L19:  // ADD
+  vm_ops::arith<op_add>(vm, 6, vm_ops::R(vm, 6), vm_ops::R(vm, 7));
+ L20:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[7], proto.cache(20));
+ L21:  // GETTABLE
+  vm_ops::gettable(vm, 7, 7, proto.constants[11], proto.cache(21));
+ L22:  // MOVE
+  vm_ops::move(vm, 8, 5);
+ L23:  // LOADK
+  vm_ops::loadk(vm, 9, lua_value((lua_integer)10));
+ L24:  // CALL
+  return 24;
+ L25:  // ADD
+  vm_ops::arith<op_add>(vm, 6, vm_ops::R(vm, 6), vm_ops::R(vm, 7));
+ L26:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[13], proto.cache(26));
+ L27:  // GETTABLE
+  vm_ops::gettable(vm, 7, 7, proto.constants[14], proto.cache(27));
+ L28:  // MOVE
+  vm_ops::move(vm, 8, 0);
+ L29:  // CALL
+  return 29;
+ L30:  // ADD
+  vm_ops::arith<op_add>(vm, 1, vm_ops::R(vm, 6), vm_ops::R(vm, 7));
+ L31:  // FORLOOP
+  if (vm_ops::forloop(vm, 2)) goto L10;
+ L32:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[2], proto.cache(32));
+ L33:  // GETTABLE
+  vm_ops::gettable(vm, 2, 2, proto.constants[3], proto.cache(33));
+ L34:  // CALL
+  return 34;
+ L35:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[15], vm_ops::R(vm, 2), proto.cache(35));
+ L36:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[16], proto.cache(36));
+ L37:  // LOADK
+  vm_ops::loadk(vm, 3, proto.constants[17]);
+ L38:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[15], proto.cache(38));
+ L39:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[1], proto.cache(39));
+ L40:  // SUB
+  vm_ops::arith<op_sub>(vm, 4, vm_ops::R(vm, 4), vm_ops::R(vm, 5));
+ L41:  // LOADK
+  vm_ops::loadk(vm, 5, proto.constants[18]);
+ L42:  // MOVE
+  vm_ops::move(vm, 6, 1);
+ L43:  // CONCAT
+  return 43;
+ L44:  // CALL
+  return 44;
+ L45:  // RETURN
+  return 45;
+  return 45;
+}
+}  // namespace
+
+bool intrinsic_loop_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    intrinsic_loop_proto_0,
+  };
+  static const uint32_t checksums[] = {
+    979955134u,
+  };
+  return aot_attach(chunk, functions, checksums, 1);
+}
@@ -0,0 +1,162 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with light_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t light_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    default: return pc;
+  }
+ L0:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[1], proto.cache(0));
+ L1:  // GETTABLE
+  vm_ops::gettable(vm, 0, 0, proto.constants[2], proto.cache(1));
+ L2:  // CALL
+  return 2;
+ L3:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[0], vm_ops::R(vm, 0), proto.cache(3));
+ L4:  // CLOSURE
+  return 4;
+ L5:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[3], vm_ops::R(vm, 0), proto.cache(5));
+ L6:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)1));
+ L7:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)1000));
+ L8:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)1));
+ L9:  // FORPREP
+  return 9;
+ L10:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[3], proto.cache(10));
+ L11:  // CALL
+  return 11;
+ L12:  // FORLOOP
+  if (vm_ops::forloop(vm, 0)) goto L10;
+ L13:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[1], proto.cache(13));
+ L14:  // GETTABLE
+  vm_ops::gettable(vm, 0, 0, proto.constants[2], proto.cache(14));
+ L15:  // CALL
+  return 15;
+ L16:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[6], vm_ops::R(vm, 0), proto.cache(16));
+ L17:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[7], proto.cache(17));
+ L18:  // LOADK
+  vm_ops::loadk(vm, 1, proto.constants[8]);
+ L19:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[6], proto.cache(19));
+ L20:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[0], proto.cache(20));
+ L21:  // SUB
+  vm_ops::arith<op_sub>(vm, 2, vm_ops::R(vm, 2), vm_ops::R(vm, 3));
+ L22:  // LOADK
+  vm_ops::loadk(vm, 3, proto.constants[9]);
+ L23:  // CONCAT
+  return 23;
+ L24:  // CALL
+  return 24;
+ L25:  // RETURN
+  return 25;
+  return 25;
+}
+
+size_t light_proto_1(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    default: return pc;
+  }
+ L0:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)30));
+ L1:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_number)0x1p-1));
+ L2:  // LOADK
+  vm_ops::loadk(vm, 2, proto.constants[2]);
+ L3:  // LOADK
+  vm_ops::loadk(vm, 3, proto.constants[3]);
+ L4:  // CONCAT
+  return 4;
+ L5:  // NEWTABLE
+  vm_ops::newtable(vm, 3, 5, 0);
+ L6:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)1));
+ L7:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)2));
+ L8:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)3));
+ L9:  // LOADK
+  vm_ops::loadk(vm, 7, lua_value((lua_integer)4));
+ L10:  // LOADK
+  vm_ops::loadk(vm, 8, lua_value((lua_integer)5));
+ L11:  // SETLIST
+  return 11;
+ L12:  // SETTABLE
+  vm_ops::settable(vm, 3, vm_ops::R(vm, 0), vm_ops::R(vm, 1));
+ L13:  // GETTABLE
+  vm_ops::gettable(vm, 4, 3, vm_ops::R(vm, 0));
+ L14:  // RETURN
+  return 14;
+  return 14;
+}
+}  // namespace
+
+bool light_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    light_proto_0,
+    light_proto_1,
+  };
+  static const uint32_t checksums[] = {
+    4013671839u,
+    2208213721u,
+  };
+  return aot_attach(chunk, functions, checksums, 2);
+}
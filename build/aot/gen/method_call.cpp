@@ -0,0 +1,204 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with method_call_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t method_call_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    case 41: goto L41;
+    case 42: goto L42;
+    case 43: goto L43;
+    case 44: goto L44;
+    case 45: goto L45;
+    case 46: goto L46;
+    case 47: goto L47;
+    case 48: goto L48;
+    case 49: goto L49;
+    case 50: goto L50;
+    default: return pc;
+  }
+ L0:  // NEWTABLE
+  vm_ops::newtable(vm, 0, 0, 3);
+ L1:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[0], lua_value((lua_integer)0), proto.cache(1));
+ L2:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[2], proto.constants[3], proto.cache(2));
+ L3:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[4], lua_value((lua_integer)1), proto.cache(3));
+ L4:  // CLOSURE
+  return 4;
+ L5:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[6], vm_ops::R(vm, 1), proto.cache(5));
+ L6:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[8], proto.cache(6));
+ L7:  // GETTABLE
+  vm_ops::gettable(vm, 2, 2, proto.constants[9], proto.cache(7));
+ L8:  // CALL
+  return 8;
+ L9:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[7], vm_ops::R(vm, 2), proto.cache(9));
+ L10:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)1));
+ L11:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1000000));
+ L12:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)1));
+ L13:  // FORPREP
+  return 13;
+ L14:  // MOVE
+  vm_ops::move(vm, 6, 1);
+ L15:  // MOVE
+  vm_ops::move(vm, 7, 0);
+ L16:  // LOADK
+  vm_ops::loadk(vm, 8, lua_value((lua_integer)1));
+ L17:  // CALL
+  return 17;
+ L18:  // FORLOOP
+  if (vm_ops::forloop(vm, 2)) goto L14;
+ L19:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[8], proto.cache(19));
+ L20:  // GETTABLE
+  vm_ops::gettable(vm, 2, 2, proto.constants[9], proto.cache(20));
+ L21:  // CALL
+  return 21;
+ L22:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[7], proto.cache(22));
+ L23:  // SUB
+  vm_ops::arith<op_sub>(vm, 2, vm_ops::R(vm, 2), vm_ops::R(vm, 3));
+ L24:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[8], proto.cache(24));
+ L25:  // GETTABLE
+  vm_ops::gettable(vm, 3, 3, proto.constants[9], proto.cache(25));
+ L26:  // CALL
+  return 26;
+ L27:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[7], vm_ops::R(vm, 3), proto.cache(27));
+ L28:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1));
+ L29:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)1000000));
+ L30:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)1));
+ L31:  // FORPREP
+  return 31;
+ L32:  // SELF
+  vm_ops::self(vm, 7, 0, proto.constants[6], proto.cache(32));
+ L33:  // LOADK
+  vm_ops::loadk(vm, 9, lua_value((lua_integer)1));
+ L34:  // CALL
+  return 34;
+ L35:  // FORLOOP
+  if (vm_ops::forloop(vm, 3)) goto L32;
+ L36:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[8], proto.cache(36));
+ L37:  // GETTABLE
+  vm_ops::gettable(vm, 3, 3, proto.constants[9], proto.cache(37));
+ L38:  // CALL
+  return 38;
+ L39:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[7], proto.cache(39));
+ L40:  // SUB
+  vm_ops::arith<op_sub>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 4));
+ L41:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[11], proto.cache(41));
+ L42:  // LOADK
+  vm_ops::loadk(vm, 5, proto.constants[12]);
+ L43:  // MOVE
+  vm_ops::move(vm, 6, 2);
+ L44:  // LOADK
+  vm_ops::loadk(vm, 7, proto.constants[13]);
+ L45:  // MOVE
+  vm_ops::move(vm, 8, 3);
+ L46:  // LOADK
+  vm_ops::loadk(vm, 9, proto.constants[14]);
+ L47:  // GETTABLE
+  vm_ops::gettable(vm, 10, 0, proto.constants[0], proto.cache(47));
+ L48:  // CONCAT
+  return 48;
+ L49:  // CALL
+  return 49;
+ L50:  // RETURN
+  return 50;
+  return 50;
+}
+
+size_t method_call_proto_1(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    default: return pc;
+  }
+ L0:  // GETTABLE
+  vm_ops::gettable(vm, 2, 0, proto.constants[0], proto.cache(0));
+ L1:  // ADD
+  vm_ops::arith<op_add>(vm, 2, vm_ops::R(vm, 2), vm_ops::R(vm, 1));
+ L2:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[0], vm_ops::R(vm, 2), proto.cache(2));
+ L3:  // RETURN
+  return 3;
+  return 3;
+}
+}  // namespace
+
+bool method_call_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    method_call_proto_0,
+    method_call_proto_1,
+  };
+  static const uint32_t checksums[] = {
+    2671352779u,
+    1868333092u,
+  };
+  return aot_attach(chunk, functions, checksums, 2);
+}
@@ -0,0 +1,278 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with record_loop_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t record_loop_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    case 41: goto L41;
+    case 42: goto L42;
+    case 43: goto L43;
+    case 44: goto L44;
+    case 45: goto L45;
+    case 46: goto L46;
+    case 47: goto L47;
+    case 48: goto L48;
+    case 49: goto L49;
+    case 50: goto L50;
+    case 51: goto L51;
+    case 52: goto L52;
+    case 53: goto L53;
+    default: return pc;
+  }
+ L0:  // CLOSURE
+  return 0;
+ L1:  // CLOSURE
+  return 1;
+ L2:  // NEWTABLE
+  vm_ops::newtable(vm, 2, 0, 0);
+ L3:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1));
+ L4:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)100));
+ L5:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)1));
+ L6:  // FORPREP
+  return 6;
+ L7:  // MOVE
+  vm_ops::move(vm, 7, 0);
+ L8:  // MOVE
+  vm_ops::move(vm, 8, 6);
+ L9:  // CALL
+  return 9;
+ L10:  // SETTABLE
+  vm_ops::settable(vm, 7, proto.constants[2], vm_ops::R(vm, 1), proto.cache(10));
+ L11:  // SETTABLE
+  vm_ops::settable(vm, 2, vm_ops::R(vm, 6), vm_ops::R(vm, 7));
+ L12:  // FORLOOP
+  if (vm_ops::forloop(vm, 3)) goto L7;
+ L13:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[4], proto.cache(13));
+ L14:  // GETTABLE
+  vm_ops::gettable(vm, 3, 3, proto.constants[5], proto.cache(14));
+ L15:  // CALL
+  return 15;
+ L16:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[3], vm_ops::R(vm, 3), proto.cache(16));
+ L17:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1));
+ L18:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)2000));
+ L19:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)1));
+ L20:  // FORPREP
+  return 20;
+ L21:  // LOADK
+  vm_ops::loadk(vm, 7, lua_value((lua_integer)1));
+ L22:  // LOADK
+  vm_ops::loadk(vm, 8, lua_value((lua_integer)100));
+ L23:  // LOADK
+  vm_ops::loadk(vm, 9, lua_value((lua_integer)1));
+ L24:  // FORPREP
+  return 24;
+ L25:  // GETTABLE
+  vm_ops::gettable(vm, 11, 2, vm_ops::R(vm, 10));
+ L26:  // SELF
+  vm_ops::self(vm, 12, 11, proto.constants[2], proto.cache(26));
+ L27:  // LOADK
+  vm_ops::loadk(vm, 14, lua_value((lua_integer)1));
+ L28:  // CALL
+  return 28;
+ L29:  // FORLOOP
+  if (vm_ops::forloop(vm, 7)) goto L25;
+ L30:  // FORLOOP
+  if (vm_ops::forloop(vm, 3)) goto L21;
+ L31:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[4], proto.cache(31));
+ L32:  // GETTABLE
+  vm_ops::gettable(vm, 3, 3, proto.constants[5], proto.cache(32));
+ L33:  // CALL
+  return 33;
+ L34:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[7], vm_ops::R(vm, 3), proto.cache(34));
+ L35:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)0));
+ L36:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)1));
+ L37:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)100));
+ L38:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)1));
+ L39:  // FORPREP
+  return 39;
+ L40:  // GETTABLE
+  vm_ops::gettable(vm, 8, 2, vm_ops::R(vm, 7));
+ L41:  // GETTABLE
+  vm_ops::gettable(vm, 8, 8, proto.constants[9], proto.cache(41));
+ L42:  // ADD
+  vm_ops::arith<op_add>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 8));
+ L43:  // FORLOOP
+  if (vm_ops::forloop(vm, 4)) goto L40;
+ L44:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[10], proto.cache(44));
+ L45:  // LOADK
+  vm_ops::loadk(vm, 5, proto.constants[11]);
+ L46:  // GETTABUP
+  vm_ops::gettabup(vm, 6, 0, proto.constants[7], proto.cache(46));
+ L47:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[3], proto.cache(47));
+ L48:  // SUB
+  vm_ops::arith<op_sub>(vm, 6, vm_ops::R(vm, 6), vm_ops::R(vm, 7));
+ L49:  // LOADK
+  vm_ops::loadk(vm, 7, proto.constants[12]);
+ L50:  // MOVE
+  vm_ops::move(vm, 8, 3);
+ L51:  // CONCAT
+  return 51;
+ L52:  // CALL
+  return 52;
+ L53:  // RETURN
+  return 53;
+  return 53;
+}
+
+size_t record_loop_proto_1(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    default: return pc;
+  }
+ L0:  // NEWTABLE
+  vm_ops::newtable(vm, 1, 0, 8);
+ L1:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[0], vm_ops::R(vm, 0), proto.cache(1));
+ L2:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[1], proto.constants[2], proto.cache(2));
+ L3:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[3], lua_value((lua_integer)1), proto.cache(3));
+ L4:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[5], vm_ops::R(vm, 0), proto.cache(4));
+ L5:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[6], lua_value((lua_integer)0), proto.cache(5));
+ L6:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[8], lua_value((lua_integer)1), proto.cache(6));
+ L7:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[9], lua_value((lua_integer)2), proto.cache(7));
+ L8:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[11], lua_value(false), proto.cache(8));
+ L9:  // RETURN
+  return 9;
+ L10:  // RETURN
+  return 10;
+  return 10;
+}
+
+size_t record_loop_proto_2(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    default: return pc;
+  }
+ L0:  // GETTABLE
+  vm_ops::gettable(vm, 2, 0, proto.constants[0], proto.cache(0));
+ L1:  // GETTABLE
+  vm_ops::gettable(vm, 3, 0, proto.constants[1], proto.cache(1));
+ L2:  // MUL
+  vm_ops::arith<op_mul>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 1));
+ L3:  // ADD
+  vm_ops::arith<op_add>(vm, 2, vm_ops::R(vm, 2), vm_ops::R(vm, 3));
+ L4:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[0], vm_ops::R(vm, 2), proto.cache(4));
+ L5:  // GETTABLE
+  vm_ops::gettable(vm, 2, 0, proto.constants[2], proto.cache(5));
+ L6:  // GETTABLE
+  vm_ops::gettable(vm, 3, 0, proto.constants[3], proto.cache(6));
+ L7:  // MUL
+  vm_ops::arith<op_mul>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 1));
+ L8:  // ADD
+  vm_ops::arith<op_add>(vm, 2, vm_ops::R(vm, 2), vm_ops::R(vm, 3));
+ L9:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[2], vm_ops::R(vm, 2), proto.cache(9));
+ L10:  // RETURN
+  return 10;
+  return 10;
+}
+}  // namespace
+
+bool record_loop_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    record_loop_proto_0,
+    record_loop_proto_1,
+    record_loop_proto_2,
+  };
+  static const uint32_t checksums[] = {
+    1982047885u,
+    425096100u,
+    2464508644u,
+  };
+  return aot_attach(chunk, functions, checksums, 3);
+}
@@ -0,0 +1,223 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with table_loop_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t table_loop_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    case 41: goto L41;
+    case 42: goto L42;
+    case 43: goto L43;
+    case 44: goto L44;
+    case 45: goto L45;
+    case 46: goto L46;
+    case 47: goto L47;
+    case 48: goto L48;
+    case 49: goto L49;
+    case 50: goto L50;
+    case 51: goto L51;
+    case 52: goto L52;
+    case 53: goto L53;
+    case 54: goto L54;
+    case 55: goto L55;
+    case 56: goto L56;
+    case 57: goto L57;
+    case 58: goto L58;
+    case 59: goto L59;
+    case 60: goto L60;
+    case 61: goto L61;
+    case 62: goto L62;
+    case 63: goto L63;
+    case 64: goto L64;
+    default: return pc;
+  }
+ L0:  // NEWTABLE
+  vm_ops::newtable(vm, 0, 0, 2);
+ L1:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[1], lua_value((lua_integer)1), proto.cache(1));
+ L2:  // NEWTABLE
+  vm_ops::newtable(vm, 1, 0, 1);
+ L3:  // SETTABLE
+  vm_ops::settable(vm, 1, proto.constants[4], lua_value((lua_integer)2), proto.cache(3));
+ L4:  // SETTABLE
+  vm_ops::settable(vm, 0, proto.constants[3], vm_ops::R(vm, 1), proto.cache(4));
+ L5:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[0], vm_ops::R(vm, 0), proto.cache(5));
+ L6:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[7], proto.cache(6));
+ L7:  // GETTABLE
+  vm_ops::gettable(vm, 0, 0, proto.constants[8], proto.cache(7));
+ L8:  // CALL
+  return 8;
+ L9:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[6], vm_ops::R(vm, 0), proto.cache(9));
+ L10:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)0));
+ L11:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)1));
+ L12:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)1000000));
+ L13:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1));
+ L14:  // FORPREP
+  return 14;
+ L15:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[0], proto.cache(15));
+ L16:  // GETTABLE
+  vm_ops::gettable(vm, 5, 5, proto.constants[3], proto.cache(16));
+ L17:  // MOVE
+  vm_ops::move(vm, 6, 5);
+ L18:  // GETTABLE
+  vm_ops::gettable(vm, 7, 5, proto.constants[4], proto.cache(18));
+ L19:  // ADD
+  vm_ops::arith<op_add>(vm, 7, vm_ops::R(vm, 0), vm_ops::R(vm, 7));
+ L20:  // GETTABUP
+  vm_ops::gettabup(vm, 8, 0, proto.constants[0], proto.cache(20));
+ L21:  // GETTABLE
+  vm_ops::gettable(vm, 8, 8, proto.constants[1], proto.cache(21));
+ L22:  // ADD
+  vm_ops::arith<op_add>(vm, 7, vm_ops::R(vm, 7), vm_ops::R(vm, 8));
+ L23:  // GETTABLE
+  vm_ops::gettable(vm, 8, 6, proto.constants[4], proto.cache(23));
+ L24:  // ADD
+  vm_ops::arith<op_add>(vm, 0, vm_ops::R(vm, 7), vm_ops::R(vm, 8));
+ L25:  // FORLOOP
+  if (vm_ops::forloop(vm, 1)) goto L15;
+ L26:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[7], proto.cache(26));
+ L27:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[8], proto.cache(27));
+ L28:  // CALL
+  return 28;
+ L29:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[11], vm_ops::R(vm, 1), proto.cache(29));
+ L30:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[12], proto.cache(30));
+ L31:  // LOADK
+  vm_ops::loadk(vm, 2, proto.constants[13]);
+ L32:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[11], proto.cache(32));
+ L33:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[6], proto.cache(33));
+ L34:  // SUB
+  vm_ops::arith<op_sub>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 4));
+ L35:  // LOADK
+  vm_ops::loadk(vm, 4, proto.constants[14]);
+ L36:  // CONCAT
+  return 36;
+ L37:  // CALL
+  return 37;
+ L38:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[7], proto.cache(38));
+ L39:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[8], proto.cache(39));
+ L40:  // CALL
+  return 40;
+ L41:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[6], vm_ops::R(vm, 1), proto.cache(41));
+ L42:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)1));
+ L43:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)200000));
+ L44:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1));
+ L45:  // FORPREP
+  return 45;
+ L46:  // NEWTABLE
+  vm_ops::newtable(vm, 5, 0, 1);
+ L47:  // SETTABLE
+  vm_ops::settable(vm, 5, proto.constants[1], vm_ops::R(vm, 4), proto.cache(47));
+ L48:  // MOVE
+  vm_ops::move(vm, 6, 5);
+ L49:  // GETTABLE
+  vm_ops::gettable(vm, 7, 6, proto.constants[1], proto.cache(49));
+ L50:  // ADD
+  vm_ops::arith<op_add>(vm, 0, vm_ops::R(vm, 0), vm_ops::R(vm, 7));
+ L51:  // FORLOOP
+  if (vm_ops::forloop(vm, 1)) goto L46;
+ L52:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[7], proto.cache(52));
+ L53:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[8], proto.cache(53));
+ L54:  // CALL
+  return 54;
+ L55:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[11], vm_ops::R(vm, 1), proto.cache(55));
+ L56:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[12], proto.cache(56));
+ L57:  // LOADK
+  vm_ops::loadk(vm, 2, proto.constants[16]);
+ L58:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[11], proto.cache(58));
+ L59:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[6], proto.cache(59));
+ L60:  // SUB
+  vm_ops::arith<op_sub>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 4));
+ L61:  // LOADK
+  vm_ops::loadk(vm, 4, proto.constants[14]);
+ L62:  // CONCAT
+  return 62;
+ L63:  // CALL
+  return 63;
+ L64:  // RETURN
+  return 64;
+  return 64;
+}
+}  // namespace
+
+bool table_loop_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    table_loop_proto_0,
+  };
+  static const uint32_t checksums[] = {
+    4109944541u,
+  };
+  return aot_attach(chunk, functions, checksums, 1);
+}
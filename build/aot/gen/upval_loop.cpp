@@ -0,0 +1,227 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with upval_loop_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t upval_loop_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    default: return pc;
+  }
+ L0:  // NEWTABLE
+  vm_ops::newtable(vm, 0, 0, 0);
+ L1:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[0], vm_ops::R(vm, 0), proto.cache(1));
+ L2:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)1));
+ L3:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)2000));
+ L4:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)1));
+ L5:  // FORPREP
+  return 5;
+ L6:  // MOVE
+  vm_ops::move(vm, 4, 3);
+ L7:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[0], proto.cache(7));
+ L8:  // CLOSURE
+  return 8;
+ L9:  // SETTABLE
+  vm_ops::settable(vm, 5, vm_ops::R(vm, 3), vm_ops::R(vm, 6));
+ L10:  // JMP
+  vm_ops::close(vm, 5);
+  goto L11;
+ L11:  // FORLOOP
+  if (vm_ops::forloop(vm, 0)) goto L6;
+ L12:  // CLOSURE
+  return 12;
+ L13:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[3], vm_ops::R(vm, 0), proto.cache(13));
+ L14:  // GETTABUP
+  vm_ops::gettabup(vm, 0, 0, proto.constants[5], proto.cache(14));
+ L15:  // GETTABLE
+  vm_ops::gettable(vm, 0, 0, proto.constants[6], proto.cache(15));
+ L16:  // CALL
+  return 16;
+ L17:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[4], vm_ops::R(vm, 0), proto.cache(17));
+ L18:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)0));
+ L19:  // LOADK
+  vm_ops::loadk(vm, 1, lua_value((lua_integer)1));
+ L20:  // LOADK
+  vm_ops::loadk(vm, 2, lua_value((lua_integer)20000));
+ L21:  // LOADK
+  vm_ops::loadk(vm, 3, lua_value((lua_integer)1));
+ L22:  // FORPREP
+  return 22;
+ L23:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[3], proto.cache(23));
+ L24:  // MOVE
+  vm_ops::move(vm, 6, 4);
+ L25:  // CALL
+  return 25;
+ L26:  // ADD
+  vm_ops::arith<op_add>(vm, 0, vm_ops::R(vm, 0), vm_ops::R(vm, 5));
+ L27:  // FORLOOP
+  if (vm_ops::forloop(vm, 1)) goto L23;
+ L28:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[5], proto.cache(28));
+ L29:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[6], proto.cache(29));
+ L30:  // CALL
+  return 30;
+ L31:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[10], vm_ops::R(vm, 1), proto.cache(31));
+ L32:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[11], proto.cache(32));
+ L33:  // LOADK
+  vm_ops::loadk(vm, 2, proto.constants[12]);
+ L34:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[10], proto.cache(34));
+ L35:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[4], proto.cache(35));
+ L36:  // SUB
+  vm_ops::arith<op_sub>(vm, 3, vm_ops::R(vm, 3), vm_ops::R(vm, 4));
+ L37:  // LOADK
+  vm_ops::loadk(vm, 4, proto.constants[13]);
+ L38:  // CONCAT
+  return 38;
+ L39:  // CALL
+  return 39;
+ L40:  // RETURN
+  return 40;
+  return 40;
+}
+
+size_t upval_loop_proto_1(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    default: return pc;
+  }
+ L0:  // GETUPVAL
+  vm_ops::getupval(vm, 0, 0);
+ L1:  // RETURN
+  return 1;
+ L2:  // RETURN
+  return 2;
+  return 2;
+}
+
+size_t upval_loop_proto_2(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    default: return pc;
+  }
+ L0:  // ADD
+  vm_ops::arith<op_add>(vm, 1, vm_ops::R(vm, 0), lua_value((lua_integer)1));
+ L1:  // CLOSURE
+  return 1;
+ L2:  // MOVE
+  vm_ops::move(vm, 3, 2);
+ L3:  // TAILCALL
+  return 3;
+ L4:  // RETURN
+  return 4;
+ L5:  // RETURN
+  return 5;
+  return 5;
+}
+
+size_t upval_loop_proto_3(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    default: return pc;
+  }
+ L0:  // GETUPVAL
+  vm_ops::getupval(vm, 0, 0);
+ L1:  // GETUPVAL
+  vm_ops::getupval(vm, 1, 1);
+ L2:  // ADD
+  vm_ops::arith<op_add>(vm, 0, vm_ops::R(vm, 0), vm_ops::R(vm, 1));
+ L3:  // RETURN
+  return 3;
+ L4:  // RETURN
+  return 4;
+  return 4;
+}
+}  // namespace
+
+bool upval_loop_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    upval_loop_proto_0,
+    upval_loop_proto_1,
+    upval_loop_proto_2,
+    upval_loop_proto_3,
+  };
+  static const uint32_t checksums[] = {
+    3278798196u,
+    783141807u,
+    3546801474u,
+    895115735u,
+  };
+  return aot_attach(chunk, functions, checksums, 4);
+}
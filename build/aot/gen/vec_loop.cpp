@@ -0,0 +1,352 @@
+// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.
+// Compile with QUOKKA_AOT defined, and attach to the chunk with vec_loop_attach().
+#include "quokka/engine/ops.h"
+#include "quokka/engine/aot.h"
+
+using namespace quokka::engine;
+
+namespace {
+
+size_t vec_loop_proto_0(quokka_vm &vm, size_t pc) {
+  bytecode_prototype &proto = vm_ops::proto(vm);
+  (void)proto;
+  switch (pc) {
+    case 0: goto L0;
+    case 1: goto L1;
+    case 2: goto L2;
+    case 3: goto L3;
+    case 4: goto L4;
+    case 5: goto L5;
+    case 6: goto L6;
+    case 7: goto L7;
+    case 8: goto L8;
+    case 9: goto L9;
+    case 10: goto L10;
+    case 11: goto L11;
+    case 12: goto L12;
+    case 13: goto L13;
+    case 14: goto L14;
+    case 15: goto L15;
+    case 16: goto L16;
+    case 17: goto L17;
+    case 18: goto L18;
+    case 19: goto L19;
+    case 20: goto L20;
+    case 21: goto L21;
+    case 22: goto L22;
+    case 23: goto L23;
+    case 24: goto L24;
+    case 25: goto L25;
+    case 26: goto L26;
+    case 27: goto L27;
+    case 28: goto L28;
+    case 29: goto L29;
+    case 30: goto L30;
+    case 31: goto L31;
+    case 32: goto L32;
+    case 33: goto L33;
+    case 34: goto L34;
+    case 35: goto L35;
+    case 36: goto L36;
+    case 37: goto L37;
+    case 38: goto L38;
+    case 39: goto L39;
+    case 40: goto L40;
+    case 41: goto L41;
+    case 42: goto L42;
+    case 43: goto L43;
+    case 44: goto L44;
+    case 45: goto L45;
+    case 46: goto L46;
+    case 47: goto L47;
+    case 48: goto L48;
+    case 49: goto L49;
+    case 50: goto L50;
+    case 51: goto L51;
+    case 52: goto L52;
+    case 53: goto L53;
+    case 54: goto L54;
+    case 55: goto L55;
+    case 56: goto L56;
+    case 57: goto L57;
+    case 58: goto L58;
+    case 59: goto L59;
+    case 60: goto L60;
+    case 61: goto L61;
+    case 62: goto L62;
+    case 63: goto L63;
+    case 64: goto L64;
+    case 65: goto L65;
+    case 66: goto L66;
+    case 67: goto L67;
+    case 68: goto L68;
+    case 69: goto L69;
+    case 70: goto L70;
+    case 71: goto L71;
+    case 72: goto L72;
+    case 73: goto L73;
+    case 74: goto L74;
+    case 75: goto L75;
+    case 76: goto L76;
+    case 77: goto L77;
+    case 78: goto L78;
+    case 79: goto L79;
+    case 80: goto L80;
+    case 81: goto L81;
+    case 82: goto L82;
+    case 83: goto L83;
+    case 84: goto L84;
+    case 85: goto L85;
+    case 86: goto L86;
+    case 87: goto L87;
+    case 88: goto L88;
+    case 89: goto L89;
+    case 90: goto L90;
+    case 91: goto L91;
+    case 92: goto L92;
+    case 93: goto L93;
+    case 94: goto L94;
+    case 95: goto L95;
+    case 96: goto L96;
+    case 97: goto L97;
+    case 98: goto L98;
+    case 99: goto L99;
+    case 100: goto L100;
+    case 101: goto L101;
+    case 102: goto L102;
+    case 103: goto L103;
+    case 104: goto L104;
+    case 105: goto L105;
+    case 106: goto L106;
+    case 107: goto L107;
+    default: return pc;
+  }
+ L0:  // LOADK
+  vm_ops::loadk(vm, 0, lua_value((lua_integer)10000));
+ L1:  // GETTABUP
+  vm_ops::gettabup(vm, 1, 0, proto.constants[1], proto.cache(1));
+ L2:  // GETTABLE
+  vm_ops::gettable(vm, 1, 1, proto.constants[2], proto.cache(2));
+ L3:  // MOVE
+  vm_ops::move(vm, 2, 0);
+ L4:  // CALL
+  return 4;
+ L5:  // GETTABUP
+  vm_ops::gettabup(vm, 2, 0, proto.constants[1], proto.cache(5));
+ L6:  // GETTABLE
+  vm_ops::gettable(vm, 2, 2, proto.constants[2], proto.cache(6));
+ L7:  // MOVE
+  vm_ops::move(vm, 3, 0);
+ L8:  // CALL
+  return 8;
+ L9:  // GETTABUP
+  vm_ops::gettabup(vm, 3, 0, proto.constants[1], proto.cache(9));
+ L10:  // GETTABLE
+  vm_ops::gettable(vm, 3, 3, proto.constants[2], proto.cache(10));
+ L11:  // MOVE
+  vm_ops::move(vm, 4, 0);
+ L12:  // CALL
+  return 12;
+ L13:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)1));
+ L14:  // MOVE
+  vm_ops::move(vm, 5, 0);
+ L15:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)1));
+ L16:  // FORPREP
+  return 16;
+ L17:  // MUL
+  vm_ops::arith<op_mul>(vm, 8, vm_ops::R(vm, 7), lua_value((lua_number)0x1p-1));
+ L18:  // SETTABLE
+  vm_ops::settable(vm, 1, vm_ops::R(vm, 7), vm_ops::R(vm, 8));
+ L19:  // SUB
+  vm_ops::arith<op_sub>(vm, 8, vm_ops::R(vm, 0), vm_ops::R(vm, 7));
+ L20:  // MUL
+  vm_ops::arith<op_mul>(vm, 8, vm_ops::R(vm, 8), lua_value((lua_number)0x1p-2));
+ L21:  // SETTABLE
+  vm_ops::settable(vm, 2, vm_ops::R(vm, 7), vm_ops::R(vm, 8));
+ L22:  // FORLOOP
+  if (vm_ops::forloop(vm, 4)) goto L17;
+ L23:  // GETTABUP
+  vm_ops::gettabup(vm, 4, 0, proto.constants[7], proto.cache(23));
+ L24:  // GETTABLE
+  vm_ops::gettable(vm, 4, 4, proto.constants[8], proto.cache(24));
+ L25:  // CALL
+  return 25;
+ L26:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[6], vm_ops::R(vm, 4), proto.cache(26));
+ L27:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)0));
+ L28:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)1));
+ L29:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)100));
+ L30:  // LOADK
+  vm_ops::loadk(vm, 7, lua_value((lua_integer)1));
+ L31:  // FORPREP
+  return 31;
+ L32:  // LOADK
+  vm_ops::loadk(vm, 9, lua_value((lua_integer)1));
+ L33:  // MOVE
+  vm_ops::move(vm, 10, 0);
+ L34:  // LOADK
+  vm_ops::loadk(vm, 11, lua_value((lua_integer)1));
+ L35:  // FORPREP
+  return 35;
+ L36:  // GETTABLE
+  vm_ops::gettable(vm, 13, 1, vm_ops::R(vm, 12));
+ L37:  // GETTABLE
+  vm_ops::gettable(vm, 14, 2, vm_ops::R(vm, 12));
+ L38:  // MUL
+  vm_ops::arith<op_mul>(vm, 13, vm_ops::R(vm, 13), vm_ops::R(vm, 14));
+ L39:  // GETTABLE
+  vm_ops::gettable(vm, 14, 3, vm_ops::R(vm, 12));
+ L40:  // ADD
+  vm_ops::arith<op_add>(vm, 13, vm_ops::R(vm, 13), vm_ops::R(vm, 14));
+ L41:  // SETTABLE
+  vm_ops::settable(vm, 3, vm_ops::R(vm, 12), vm_ops::R(vm, 13));
+ L42:  // FORLOOP
+  if (vm_ops::forloop(vm, 9)) goto L36;
+ L43:  // LOADK
+  vm_ops::loadk(vm, 4, lua_value((lua_integer)0));
+ L44:  // LOADK
+  vm_ops::loadk(vm, 9, lua_value((lua_integer)1));
+ L45:  // MOVE
+  vm_ops::move(vm, 10, 0);
+ L46:  // LOADK
+  vm_ops::loadk(vm, 11, lua_value((lua_integer)1));
+ L47:  // FORPREP
+  return 47;
+ L48:  // GETTABLE
+  vm_ops::gettable(vm, 13, 1, vm_ops::R(vm, 12));
+ L49:  // GETTABLE
+  vm_ops::gettable(vm, 14, 3, vm_ops::R(vm, 12));
+ L50:  // MUL
+  vm_ops::arith<op_mul>(vm, 13, vm_ops::R(vm, 13), vm_ops::R(vm, 14));
+ L51:  // ADD
+  vm_ops::arith<op_add>(vm, 4, vm_ops::R(vm, 4), vm_ops::R(vm, 13));
+ L52:  // FORLOOP
+  if (vm_ops::forloop(vm, 9)) goto L48;
+ L53:  // FORLOOP
+  if (vm_ops::forloop(vm, 5)) goto L32;
+ L54:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[7], proto.cache(54));
+ L55:  // GETTABLE
+  vm_ops::gettable(vm, 5, 5, proto.constants[8], proto.cache(55));
+ L56:  // CALL
+  return 56;
+ L57:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[11], vm_ops::R(vm, 5), proto.cache(57));
+ L58:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[12], proto.cache(58));
+ L59:  // LOADK
+  vm_ops::loadk(vm, 6, proto.constants[13]);
+ L60:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[11], proto.cache(60));
+ L61:  // GETTABUP
+  vm_ops::gettabup(vm, 8, 0, proto.constants[6], proto.cache(61));
+ L62:  // SUB
+  vm_ops::arith<op_sub>(vm, 7, vm_ops::R(vm, 7), vm_ops::R(vm, 8));
+ L63:  // LOADK
+  vm_ops::loadk(vm, 8, proto.constants[14]);
+ L64:  // MOVE
+  vm_ops::move(vm, 9, 4);
+ L65:  // CONCAT
+  return 65;
+ L66:  // CALL
+  return 66;
+ L67:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[1], proto.cache(67));
+ L68:  // GETTABLE
+  vm_ops::gettable(vm, 5, 5, proto.constants[2], proto.cache(68));
+ L69:  // MOVE
+  vm_ops::move(vm, 6, 0);
+ L70:  // CALL
+  return 70;
+ L71:  // MOVE
+  vm_ops::move(vm, 3, 5);
+ L72:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[7], proto.cache(72));
+ L73:  // GETTABLE
+  vm_ops::gettable(vm, 5, 5, proto.constants[8], proto.cache(73));
+ L74:  // CALL
+  return 74;
+ L75:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[6], vm_ops::R(vm, 5), proto.cache(75));
+ L76:  // LOADK
+  vm_ops::loadk(vm, 5, lua_value((lua_integer)1));
+ L77:  // LOADK
+  vm_ops::loadk(vm, 6, lua_value((lua_integer)100));
+ L78:  // LOADK
+  vm_ops::loadk(vm, 7, lua_value((lua_integer)1));
+ L79:  // FORPREP
+  return 79;
+ L80:  // GETTABUP
+  vm_ops::gettabup(vm, 9, 0, proto.constants[1], proto.cache(80));
+ L81:  // GETTABLE
+  vm_ops::gettable(vm, 9, 9, proto.constants[15], proto.cache(81));
+ L82:  // MOVE
+  vm_ops::move(vm, 10, 3);
+ L83:  // MOVE
+  vm_ops::move(vm, 11, 1);
+ L84:  // MOVE
+  vm_ops::move(vm, 12, 2);
+ L85:  // MOVE
+  vm_ops::move(vm, 13, 3);
+ L86:  // CALL
+  return 86;
+ L87:  // GETTABUP
+  vm_ops::gettabup(vm, 9, 0, proto.constants[1], proto.cache(87));
+ L88:  // GETTABLE
+  vm_ops::gettable(vm, 9, 9, proto.constants[16], proto.cache(88));
+ L89:  // MOVE
+  vm_ops::move(vm, 10, 1);
+ L90:  // MOVE
+  vm_ops::move(vm, 11, 3);
+ L91:  // CALL
+  return 91;
+ L92:  // MOVE
+  vm_ops::move(vm, 4, 9);
+ L93:  // FORLOOP
+  if (vm_ops::forloop(vm, 5)) goto L80;
+ L94:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[7], proto.cache(94));
+ L95:  // GETTABLE
+  vm_ops::gettable(vm, 5, 5, proto.constants[8], proto.cache(95));
+ L96:  // CALL
+  return 96;
+ L97:  // SETTABUP
+  vm_ops::settabup(vm, 0, proto.constants[11], vm_ops::R(vm, 5), proto.cache(97));
+ L98:  // GETTABUP
+  vm_ops::gettabup(vm, 5, 0, proto.constants[12], proto.cache(98));
+ L99:  // LOADK
+  vm_ops::loadk(vm, 6, proto.constants[17]);
+ L100:  // GETTABUP
+  vm_ops::gettabup(vm, 7, 0, proto.constants[11], proto.cache(100));
+ L101:  // GETTABUP
+  vm_ops::gettabup(vm, 8, 0, proto.constants[6], proto.cache(101));
+ L102:  // SUB
+  vm_ops::arith<op_sub>(vm, 7, vm_ops::R(vm, 7), vm_ops::R(vm, 8));
+ L103:  // LOADK
+  vm_ops::loadk(vm, 8, proto.constants[14]);
+ L104:  // MOVE
+  vm_ops::move(vm, 9, 4);
+ L105:  // CONCAT
+  return 105;
+ L106:  // CALL
+  return 106;
+ L107:  // RETURN
+  return 107;
+  return 107;
+}
+}  // namespace
+
+bool vec_loop_attach(bytecode_chunk &chunk) {
+  static const aot_function functions[] = {
+    vec_loop_proto_0,
+  };
+  static const uint32_t checksums[] = {
+    2617050623u,
+  };
+  return aot_attach(chunk, functions, checksums, 1);
+}
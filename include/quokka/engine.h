@@ -1,3 +1,8 @@
 #pragma once
 
-#include "engine/vm.h"
\ No newline at end of file
+#include "engine/vm.h"
+#include "engine/bind.h"
+#include "engine/intrinsics.h"
+#include "engine/iterators.h"
+#include "engine/metatables.h"
+#include "engine/vec.h"
\ No newline at end of file
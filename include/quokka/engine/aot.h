@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+
+#include "smallvector.h"
+
+namespace quokka {
+namespace engine {
+
+  class quokka_vm;
+  struct bytecode_prototype;
+  struct bytecode_chunk;
+
+  /**
+   * A prototype compiled ahead-of-time to C++ by aot_compiler.
+   *
+   * The function runs the current frame of the VM, starting at an instruction, until it
+   * reaches an instruction that it doesn't compile (such as a call or return). It then
+   * returns the index of that instruction, so that the interpreter can carry on from there.
+   */
+  using aot_function = size_t (*)(quokka_vm &vm, size_t pc);
+
+  /**
+   * Checksum of the instructions of a prototype, used to check that AOT compiled code
+   * belongs to the prototype it is attached to.
+   */
+  uint32_t aot_checksum(const bytecode_prototype &proto);
+
+#ifdef QUOKKA_AOT
+  /**
+   * Attach AOT compiled functions to the prototypes of a chunk. This is called by the
+   * code generated by aot_compiler, and should be called after the chunk is read, but
+   * before it is loaded into a VM.
+   *
+   * @param chunk The chunk the functions were compiled from
+   * @param functions The compiled functions, one for each prototype in depth-first order
+   * @param checksums The aot_checksum() of each prototype when it was compiled
+   * @param count The number of prototypes
+   * @return true if the chunk matches the compiled code, and the functions were attached
+   */
+  bool aot_attach(bytecode_chunk &chunk, const aot_function *functions, const uint32_t *checksums, size_t count);
+#endif
+
+#ifdef WITH_AOT_COMPILER
+  /**
+   * The AOT compiler writes a bytecode chunk as C++ source, so that scripts known ahead of
+   * time can be compiled into the host program and run without the dispatch overhead of the
+   * interpreter, while letting the C++ compiler optimize across instructions.
+   *
+   * Each prototype is written as an aot_function that runs the instructions of its frame
+   * through vm_ops (see ops.h), with the control flow of the bytecode as gotos. Constant
+   * numbers are written as literals. Calls, returns, closures and the other instructions
+   * that manage frames are left to the interpreter.
+   *
+   * For a chunk written with the name `foo`, the source defines
+   *   `bool foo_attach(quokka::engine::bytecode_chunk &chunk);`
+   * which attaches the compiled code to the chunk (see aot_attach()). The generated source
+   * must be compiled with QUOKKA_AOT defined, as must the engine.
+   */
+  class aot_compiler {
+   public:
+    /**
+     * Create a new AOT compiler
+     * @param stream The output stream for the C++ source
+     * @param name The name of the chunk, which must be a valid C++ identifier
+     */
+    aot_compiler(std::ostream &stream, const char *name);
+
+    /**
+     * Write a bytecode chunk as C++ source to the stream
+     * @param c The bytecode chunk to write
+     */
+    void write_chunk(bytecode_chunk &c);
+
+    /* INTERNAL */
+
+    void write_function(bytecode_prototype &, size_t id);
+    void write_instruction(bytecode_prototype &, size_t pc);
+    void write_rk(bytecode_prototype &, unsigned int v);
+    void write_constant(bytecode_prototype &, size_t idx);
+   private:
+    std::ostream &_stream;
+    const char *_name;
+    small_vector<bytecode_prototype *, 16> _protos;
+  };
+#endif
+
+}  // namespace engine
+}  // namespace quokka
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "vm.h"
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace quokka {
+namespace engine {
+
+  /**
+   * Conversion of a C++ type to and from lua_value, for the arguments and results of bound
+   * functions (see alloc_bound_function). Binding a function that takes or returns a type
+   * without a specialisation is a compile error.
+   *
+   * from() converts an argument, returning false if the argument can't be converted.
+   * to() converts a result.
+   */
+  template <typename T, typename = void>
+  struct native_type;
+
+  template <>
+  struct native_type<lua_value> {
+    static bool from(const lua_value &v, lua_value &out) { out = v; return true; }
+    static lua_value to(const lua_value &v) { return v; }
+  };
+
+  template <>
+  struct native_type<bool> {
+    static bool from(const lua_value &v, bool &out) { out = !falsey(v); return true; }
+    static lua_value to(bool v) { return v; }
+  };
+
+  template <typename T>
+  struct native_type<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+    static bool from(const lua_value &v, T &out) {
+      lua_number n;
+      if (!tonumber(v, n))
+        return false;
+      out = (T)n;
+      return true;
+    }
+    static lua_value to(T v) { return (lua_number)v; }
+  };
+
+  template <typename T>
+  struct native_type<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+    static bool from(const lua_value &v, T &out) {
+      lua_integer i;
+      if (!tointeger(v, i))
+        return false;
+      out = (T)i;
+      return true;
+    }
+    static lua_value to(T v) { return (lua_integer)v; }
+  };
+
+  template <>
+  struct native_type<lua_string> {
+    static bool from(const lua_value &v, lua_string &out) { return tostring(v, out); }
+    static lua_value to(const lua_string &v) { return v; }
+  };
+
+  template <>
+  struct native_type<object_view> {
+    static bool from(const lua_value &v, object_view &out) {
+      if (!is<object_view>(v))
+        return false;
+      out = std::get<object_view>(v);
+      return true;
+    }
+    static lua_value to(const object_view &v) { return v; }
+  };
+
+  /**
+   * The fast native (see lua_fast_native) of a bound C++ function. Arguments are converted with
+   * native_type, with missing arguments being nil. If an argument can't be converted, the
+   * function isn't called and the result is nil.
+   */
+  template <auto F>
+  struct native_binding;
+
+  template <typename R, typename... Args, R (*F)(Args...)>
+  struct native_binding<F> {
+    static int call(quokka_vm &, lua_args args, lua_value &result) {
+      return invoke(args, result, std::index_sequence_for<Args...>{});
+    }
+
+   private:
+    template <size_t... I>
+    static int invoke([[maybe_unused]] lua_args args, [[maybe_unused]] lua_value &result, std::index_sequence<I...>) {
+      std::tuple<std::decay_t<Args>...> values;
+      if (!(native_type<std::decay_t<Args>>::from(args[I], std::get<I>(values)) && ...))
+        return 0;
+
+      if constexpr (std::is_void_v<R>) {
+        F(std::get<I>(values)...);
+        return 0;
+      } else {
+        result = native_type<std::decay_t<R>>::to(F(std::get<I>(values)...));
+        return 1;
+      }
+    }
+  };
+
+  /**
+   * Allocate a native function that calls a C++ function, converting its arguments and result
+   * (see native_type), e.g. alloc_bound_function<lerp>(vm) for `double lerp(double a, double b, double t)`.
+   */
+  template <auto F>
+  inline object_view alloc_bound_function(quokka_vm &vm) {
+    return vm.alloc_fast_native_function(&native_binding<F>::call);
+  }
+
+  /**
+   * Define a bound C++ function in the global env. This is a shortcut for
+   * vm.env().set(key, alloc_bound_function<F>(vm)).
+   */
+  template <auto F>
+  inline void define_bound_function(quokka_vm &vm, const char *key) {
+    object_view func = alloc_bound_function<F>(vm);
+    vm.env().set(key, func);
+  }
+}  // namespace engine
+}  // namespace quokka
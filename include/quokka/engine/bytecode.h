@@ -8,6 +8,9 @@
 #include "smallstring.h"
 #include "smallvector.h"
 #include "types.h"
+#include "jit.h"
+#include "aot.h"
+#include "opstats.h"
 
 namespace quokka {
 namespace engine {
@@ -67,11 +70,33 @@ struct bytecode_upvalue {
   uint8_t idx;
 };
 
+/**
+ * The closures that a VM has made of a prototype (with OP_CLOSURE), by their slot in its object
+ * pool. As the closure cache of Lua 5.3, a closure is reused for as long as it captures the same
+ * upvals, and the slot of a closure that has since been freed is reclaimed for the next one,
+ * without searching the pool for a free slot. Slots are hints, which are checked before use.
+ */
+struct closure_pool {
+  static constexpr size_t SIZE = 4;
+
+  size_t slots[SIZE] = { SIZE_MAX, SIZE_MAX, SIZE_MAX, SIZE_MAX };
+  // The slot replaced by the next closure
+  uint8_t next = 0;
+  /**
+   * Set when the chunk is loaded if every closure of the prototype captures the same upvals,
+   * i.e. it has no upvals, or it only has upvals of an enclosing function that is constant itself
+   * (such as _ENV). The VM holds such closures for as long as it exists, so they are only
+   * allocated once.
+   */
+  bool constant = false;
+};
+
 /**
  * Prototype is a description of a Lua function (aka closure), providing its
  * layout in bytecode, but without any of its runtime features.
  * 
- * Debug information is not included in Quokka LE.
+ * Debug information is not included in Quokka LE, except for the line of each instruction if
+ * the reader is asked to keep it (see bytecode_reader::set_line_info()).
  */
 struct bytecode_prototype {
   small_string<16> source;
@@ -94,11 +119,37 @@ struct bytecode_prototype {
      have some heap allocations */
   int num_protos;
   small_vector<std::shared_ptr<bytecode_prototype>, 16> protos;
-  // Debugging information is ignored, but still must be parsed.
+  /* Line of each instruction, or nullptr if it wasn't kept (or the bytecode is stripped). The
+     rest of the debugging information is ignored, but still must be parsed. */
+  std::unique_ptr<int[]> line_info;
   
   /* RUNTIME INFO */
-  /* This is used by the runtime to cache the closure. It has no bytecode purpose */
-  object_view closure_cache;
+  /* Closures of this prototype, used by the runtime to reuse them. It has no bytecode purpose */
+  closure_pool closures;
+  /* Inline caches of table accesses with a constant key, by instruction. Allocated on first use.
+     Without shapes, caches are never filled, so the instructions share one. */
+  std::unique_ptr<inline_cache[]> caches;
+
+  inline_cache &cache(size_t pc) {
+    if constexpr (!engine_traits::shapes)
+      pc = 0;
+    if (caches == nullptr)
+      caches.reset(new inline_cache[engine_traits::shapes ? instructions.size() : 1]);
+    return caches[pc];
+  }
+#ifdef QUOKKA_JIT
+  /* Machine code compiled by the JIT, and the count of calls and loops used to decide when to compile */
+  std::shared_ptr<jit_function> jit;
+  uint32_t jit_hotness = 0;
+#endif
+#ifdef QUOKKA_AOT
+  /* Code compiled ahead-of-time by aot_compiler, attached with aot_attach() */
+  aot_function aot = nullptr;
+#endif
+#ifdef QUOKKA_OPCODE_STATS
+  /* Instructions of this prototype run by the interpreter, see opcode_stats */
+  prototype_stats stats;
+#endif
 };
 
 /**
@@ -139,10 +190,18 @@ class bytecode_reader {
     return c;
   }
 
+  /**
+   * Keep the line of each instruction of the chunks read from now on, for lua_profiler. This
+   * takes an int for each instruction. Off by default.
+   */
+  void set_line_info(bool keep) {
+    _line_info = keep;
+  }
+
   /* INTERNAL */
 
   void read_header(bytecode_header &);
-  void read_function(bytecode_architecture, bytecode_prototype &);
+  void read_function(bytecode_architecture, bytecode_prototype &, const bytecode_prototype *parent = nullptr);
 
   uint8_t read_byte();
   void    read_block(uint8_t *out, size_t count);
@@ -155,6 +214,7 @@ class bytecode_reader {
  private:
   std::istream &_stream;
   const bytecode_architecture _sys_arch = bytecode_architecture::system();
+  bool _line_info = false;
 };
 
 #ifdef WITH_BYTECODE_WRITER
@@ -180,7 +240,7 @@ class bytecode_writer {
   /* INTERNAL */
 
   void write_header(bytecode_header &);
-  void write_function(bytecode_prototype &);
+  void write_function(bytecode_prototype &, const bytecode_prototype *parent = nullptr);
 
   void write_byte(uint8_t);
   void write_block(uint8_t *buf, size_t count);
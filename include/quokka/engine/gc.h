@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "smallvector.h"
+
+namespace quokka {
+namespace engine {
+
+  /**
+   * Statistics reported by the cycle collector. Counts are accumulated over the
+   * lifetime of the VM.
+   */
+  struct gc_stats {
+    // Number of completed collection cycles
+    size_t cycles = 0;
+    // Number of objects and upvals freed by the collector
+    size_t collected_objects = 0;
+    size_t collected_upvals = 0;
+    // Number of objects and upvals freed by the last completed cycle
+    size_t last_objects = 0;
+    size_t last_upvals = 0;
+  };
+
+  /**
+   * Incremental state of the cycle collector.
+   *
+   * Objects and upvals are freed by reference counting, which cannot free cycles
+   * (e.g. a table that references itself). The cycle collector is a backup that uses
+   * trial deletion over the object and upval pools (the 'nodes'). The references
+   * each node holds to other nodes are subtracted from their refcounts, and any node
+   * left with uses is referenced from outside of the pools - the registers, the
+   * distinguished env, prototype caches or the host. Everything reachable from those
+   * is live, and the remainder are candidates for collection.
+   *
+   * The VM may run between steps, so the candidates are verified before they are freed.
+   * A set of candidates is only freed if every use of every candidate is accounted for
+   * by references from within the set itself, which means nothing else can reach it.
+   */
+  struct gc_state {
+    enum class gc_phase : uint8_t { IDLE, COUNT, SCAN, MARK, SELECT, SWEEP };
+
+    // Per-node marks
+    enum gc_mark : uint8_t { UNMARKED = 0, LIVE, CANDIDATE };
+
+    gc_phase phase = gc_phase::IDLE;
+    // Progress through the nodes for the current phase
+    size_t cursor = 0;
+    // Size of the pools at the start of the cycle. Nodes after these are not considered.
+    size_t num_objects = 0;
+    size_t num_upvals = 0;
+    // Units of work performed for each allocation. 0 disables automatic collection.
+    size_t budget = 0;
+
+    // Trial reference counts and marks, indexed by node.
+    small_vector<int, 8, 64> refs;
+    small_vector<gc_mark, 8, 64> marks;
+    // Nodes waiting to be traced, and nodes selected for collection.
+    small_vector<size_t, 8, 64> worklist;
+    small_vector<size_t, 8, 64> candidates;
+
+    gc_stats stats;
+  };
+}  // namespace engine
+}  // namespace quokka
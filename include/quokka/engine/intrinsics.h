@@ -0,0 +1,30 @@
+#pragma once
+
+#include "vm.h"
+
+namespace quokka {
+namespace engine {
+
+  /**
+   * Standard intrinsics (see lua_intrinsic), for hosts that want common functions of the Lua
+   * standard library to be run inline by the VM. Each follows the behaviour of the function of
+   * the same name in Lua 5.3, except that invalid arguments result in nil rather than an error.
+   */
+  namespace intrinsics {
+    bool floor(const lua_value &x, const lua_value &, lua_value &result);
+    bool ceil(const lua_value &x, const lua_value &, lua_value &result);
+    bool abs(const lua_value &x, const lua_value &, lua_value &result);
+    bool sqrt(const lua_value &x, const lua_value &, lua_value &result);
+    bool min(const lua_value &x, const lua_value &y, lua_value &result);
+    bool max(const lua_value &x, const lua_value &y, lua_value &result);
+    bool len(const lua_value &s, const lua_value &, lua_value &result);
+
+    /**
+     * Define the intrinsics in the global env of a VM, as math.floor, math.ceil, math.abs,
+     * math.sqrt, math.min, math.max and string.len. The math and string tables are created if
+     * they don't exist.
+     */
+    void define_all(quokka_vm &vm);
+  }  // namespace intrinsics
+}  // namespace engine
+}  // namespace quokka
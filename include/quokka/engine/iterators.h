@@ -0,0 +1,26 @@
+#pragma once
+
+#include "vm.h"
+
+namespace quokka {
+namespace engine {
+
+  /**
+   * Standard iterators (see lua_iterator), for generic for loops over tables and typed arrays.
+   * These follow next and ipairs in Lua 5.3 (without metamethods), except that invalid
+   * arguments end the iteration rather than raising an error. Typed arrays are iterated as a
+   * sequence, from 1 to #array.
+   */
+  namespace iterators {
+    bool next(const lua_value &t, lua_value &k, lua_value &v);
+    bool inext(const lua_value &t, lua_value &i, lua_value &v);
+
+    /**
+     * Define next, pairs and ipairs in the global env of a VM. pairs(t) returns next, t, nil
+     * and ipairs(t) returns an iterator over t[1], t[2], .. up to the first nil, so that loops
+     * over either are run in place by the VM.
+     */
+    void define_all(quokka_vm &vm);
+  }  // namespace iterators
+}  // namespace engine
+}  // namespace quokka
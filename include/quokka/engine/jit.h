@@ -0,0 +1,83 @@
+#pragma once
+
+#ifdef QUOKKA_JIT
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "QUOKKA_JIT is only supported on x86-64 Linux hosts"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "smallvector.h"
+
+/**
+ * The number of times a prototype must be called, or loop, before it is compiled.
+ */
+#ifndef QUOKKA_JIT_THRESHOLD
+#define QUOKKA_JIT_THRESHOLD 64
+#endif
+
+namespace quokka {
+namespace engine {
+
+  class quokka_vm;
+  struct bytecode_prototype;
+
+  /**
+   * A jit_function is the machine code compiled for a bytecode prototype by quokka_jit.
+   *
+   * The machine code can be entered at any instruction of the prototype, and runs the frame
+   * until it reaches an instruction that it doesn't compile (such as a call or return), at
+   * which point it exits, returning the index of that instruction so that the interpreter
+   * can carry on from there.
+   */
+  struct jit_function {
+    using entry_t = uint32_t (*)(quokka_vm *vm, const uint8_t *entry);
+
+    uint8_t *code = nullptr;
+    size_t code_size = 0;
+    // Offset into the code of each instruction
+    small_vector<uint32_t, 32> entries;
+
+    jit_function() {}
+    jit_function(const jit_function &) = delete;
+    jit_function &operator=(const jit_function &) = delete;
+    ~jit_function();
+
+    /**
+     * Run the machine code of the current frame, starting at an instruction.
+     * @param vm The VM, which must be executing a frame of the compiled prototype
+     * @param pc The index of the instruction to start from
+     * @return The index of the instruction to resume interpretation from
+     */
+    size_t run(quokka_vm &vm, size_t pc) const {
+      return ((entry_t)code)(&vm, code + entries[pc]);
+    }
+  };
+
+  /**
+   * quokka_jit is a baseline template JIT for x86-64 Linux hosts, enabled by defining QUOKKA_JIT.
+   *
+   * Prototypes are compiled once they pass QUOKKA_JIT_THRESHOLD calls or loop iterations.
+   * Each instruction is compiled by stitching a machine code template that calls a handler
+   * specialised for the instruction's operands (e.g. register or constant), followed by the
+   * control flow of the instruction as direct jumps. This removes the fetch, decode and
+   * dispatch of the interpreter. Handlers have fast paths for integer arithmetic, numeric
+   * for loops and table access, and call into the runtime for everything else.
+   *
+   * Calls, returns, closures and the other instructions that manage frames are left to the
+   * interpreter, which remains the fallback for portable and embedded builds.
+   */
+  class quokka_jit {
+   public:
+    /**
+     * Compile a prototype, storing the result in the prototype.
+     * @return true if the prototype was compiled
+     */
+    static bool compile(bytecode_prototype &proto);
+  };
+}  // namespace engine
+}  // namespace quokka
+
+#endif
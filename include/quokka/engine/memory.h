@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+
+namespace quokka {
+namespace engine {
+
+  /**
+   * Error raised when an allocation would take a VM over its memory limit (see
+   * quokka_vm::set_memory_limit()).
+   */
+  class lua_memory_error : public std::bad_alloc {
+   public:
+    const char *what() const noexcept override {
+      return "quokka: memory limit exceeded";
+    }
+  };
+
+  /**
+   * A budget of heap memory, which the heap buffers of the engine (those of small_vector,
+   * and so strings and tables, the segments of the register stack and the buffers of typed
+   * arrays) are charged to while it is the current budget of the thread.
+   *
+   * Each buffer remembers the budget it was charged to, so that it is credited when it is
+   * freed, even if that happens outside of the VM (e.g. a string popped by the host). A budget
+   * that is released by its VM while buffers are still charged to it is deleted when the last
+   * of them is freed.
+   */
+  struct memory_budget {
+    // Bytes charged, including the header of each buffer
+    size_t used = 0;
+    // The most bytes charged at once
+    size_t peak = 0;
+    // The most bytes that may be charged, SIZE_MAX for no limit
+    size_t limit = SIZE_MAX;
+    // Set once the budget has been released by its VM
+    bool released = false;
+
+    /**
+     * Release a budget from its VM, deleting it if nothing is charged to it.
+     */
+    struct release {
+      void operator()(memory_budget *b) const;
+    };
+  };
+
+  namespace memory {
+    /**
+     * Allocate a heap buffer, charged to the current budget (if any).
+     * @throws lua_memory_error if the buffer would take the budget over its limit
+     * @throws std::bad_alloc if the system is out of memory
+     */
+    void *alloc(size_t bytes);
+
+    /**
+     * Free a buffer from alloc(), crediting the budget it was charged to. nullptr is ignored.
+     */
+    void free(void *p);
+
+    /**
+     * Get the current budget of this thread, or nullptr if allocations aren't charged.
+     */
+    memory_budget *current();
+
+    /**
+     * Make a budget current for the life of the scope, restoring the previous one after.
+     * Scopes nest, so that a VM can be entered from a native function of another.
+     */
+    class scope {
+     public:
+      scope(memory_budget *b);
+      ~scope();
+
+      scope(const scope &) = delete;
+      scope &operator=(const scope &) = delete;
+
+     private:
+      memory_budget *_outer;
+    };
+  }  // namespace memory
+}  // namespace engine
+}  // namespace quokka
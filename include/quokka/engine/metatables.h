@@ -0,0 +1,24 @@
+#pragma once
+
+#include "vm.h"
+
+namespace quokka {
+namespace engine {
+
+  /**
+   * Metatables of tables, as in Lua 5.3. The VM supports the __index, __newindex, __call, __eq,
+   * __lt, __le, __len, __concat, __unm and arithmetic and bitwise metamethods (but not __gc,
+   * __mode, __metatable or __tostring). Values other than tables have no metatable.
+   *
+   * A metamethod that is missing where Lua would raise an error leaves the instruction to do
+   * what it does without one (usually nothing).
+   */
+  namespace metatables {
+    /**
+     * Define setmetatable, getmetatable, rawget, rawset, rawequal and rawlen in the global env of
+     * a VM.
+     */
+    void define_all(quokka_vm &vm);
+  }  // namespace metatables
+}  // namespace engine
+}  // namespace quokka
@@ -78,8 +78,15 @@ enum class opcode {
 
   OP_VARARG, /*	A B	R(A), R(A+1), ..., R(A+B-2) = vararg		*/
 
-  OP_EXTRAARG /*	Ax	extra (larger) argument for previous opcode
+  OP_EXTRAARG, /*	Ax	extra (larger) argument for previous opcode
                */
+
+  /* Quickened opcodes. These never appear in bytecode files, and are written over
+     instructions by the VM while running, to specialise them for their operands. */
+
+  OP_FORLOOP_INT, /*	A sBx	OP_FORLOOP, where R(A), R(A+1) and R(A+2) are integers */
+  OP_FORLOOP_FLT, /*	A sBx	OP_FORLOOP, where R(A), R(A+1) and R(A+2) are floats */
+  OP_CALL_INTRINSIC /*	A B C	OP_CALL, where R(A) is an intrinsic (see lua_intrinsic) */
 };
 
 /*
@@ -129,6 +136,51 @@ inline uint32_t get_Ax(lua_instruction instruction) {
   return (instruction >> 6) & 0x3FFFFFF;
 }
 
+// Decode a size hint of OP_NEWTABLE, which is a 'floating point byte' (eeeeexxx), as the
+// value (1xxx) * 2^(eeeee - 1), or xxx if eeeee is 0
+inline size_t fb2int(unsigned int x) {
+  return x < 8 ? x : ((size_t)(x & 7) + 8) << ((x >> 3) - 1);
+}
+
+inline void set_opcode(lua_instruction &instruction, opcode op) {
+  instruction = (instruction & ~(lua_instruction)0b111111) | (lua_instruction)op;
+}
+
+// Get the opcode of a quickened opcode as it appears in bytecode
+inline opcode unquicken(opcode op) {
+  switch (op) {
+    case opcode::OP_FORLOOP_INT:
+    case opcode::OP_FORLOOP_FLT:
+      return opcode::OP_FORLOOP;
+    case opcode::OP_CALL_INTRINSIC:
+      return opcode::OP_CALL;
+    default:
+      return op;
+  }
+}
+
+// Get an instruction as it appears in bytecode, reverting any quickening
+inline lua_instruction unquicken(lua_instruction instruction) {
+  set_opcode(instruction, unquicken(get_opcode(instruction)));
+  return instruction;
+}
+
+// The number of opcodes, including quickened opcodes
+constexpr size_t NUM_OPCODES = (size_t)opcode::OP_CALL_INTRINSIC + 1;
+
+// Get the name of an opcode, without the OP_ prefix (e.g. "MOVE")
+inline const char *name(opcode op) {
+  static const char *names[NUM_OPCODES] = {
+    "MOVE", "LOADK", "LOADKX", "LOADBOOL", "LOADNIL", "GETUPVAL", "GETTABUP", "GETTABLE",
+    "SETTABUP", "SETUPVAL", "SETTABLE", "NEWTABLE", "SELF", "ADD", "SUB", "MUL", "MOD", "POW",
+    "DIV", "IDIV", "BAND", "BOR", "BXOR", "SHL", "SHR", "UNM", "BNOT", "NOT", "LEN", "CONCAT",
+    "JMP", "EQ", "LT", "LE", "TEST", "TESTSET", "CALL", "TAILCALL", "RETURN", "FORLOOP",
+    "FORPREP", "TFORCALL", "TFORLOOP", "SETLIST", "CLOSURE", "VARARG", "EXTRAARG",
+    "FORLOOP_INT", "FORLOOP_FLT", "CALL_INTRINSIC"
+  };
+  return (size_t)op < NUM_OPCODES ? names[(size_t)op] : "?";
+}
+
 }
 
 } // namespace engine
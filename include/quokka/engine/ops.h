@@ -0,0 +1,333 @@
+#pragma once
+
+#include "vm.h"
+
+#include <math.h>
+#include <type_traits>
+
+namespace quokka {
+namespace engine {
+
+  /* Arithmetic operators, as used by vm_ops::arith() */
+  struct op_add {
+    static constexpr lua_metamethod event = lua_metamethod::ADD;
+    static lua_integer i(lua_integer a, lua_integer b) { return a + b; }
+    static lua_number n(lua_number a, lua_number b) { return a + b; }
+  };
+  struct op_sub {
+    static constexpr lua_metamethod event = lua_metamethod::SUB;
+    static lua_integer i(lua_integer a, lua_integer b) { return a - b; }
+    static lua_number n(lua_number a, lua_number b) { return a - b; }
+  };
+  struct op_mul {
+    static constexpr lua_metamethod event = lua_metamethod::MUL;
+    static lua_integer i(lua_integer a, lua_integer b) { return a * b; }
+    static lua_number n(lua_number a, lua_number b) { return a * b; }
+  };
+  struct op_mod {
+    static constexpr lua_metamethod event = lua_metamethod::MOD;
+    static lua_integer i(lua_integer a, lua_integer b) { return a % b; }
+    static lua_number n(lua_number a, lua_number b) { return fmod(a, b); }
+  };
+  struct op_idiv {
+    static constexpr lua_metamethod event = lua_metamethod::IDIV;
+    static lua_integer i(lua_integer a, lua_integer b) { return a / b; }
+    static lua_number n(lua_number a, lua_number b) { return (lua_integer)(a / b); }
+  };
+  // Bitwise operators are only defined for integers
+  struct op_band {
+    static constexpr lua_metamethod event = lua_metamethod::BAND;
+    static lua_integer i(lua_integer a, lua_integer b) { return a & b; }
+  };
+  struct op_bor {
+    static constexpr lua_metamethod event = lua_metamethod::BOR;
+    static lua_integer i(lua_integer a, lua_integer b) { return a | b; }
+  };
+  struct op_bxor {
+    static constexpr lua_metamethod event = lua_metamethod::BXOR;
+    static lua_integer i(lua_integer a, lua_integer b) { return a ^ b; }
+  };
+  struct op_shl {
+    static constexpr lua_metamethod event = lua_metamethod::SHL;
+    static lua_integer i(lua_integer a, lua_integer b) { return a << b; }
+  };
+  struct op_shr {
+    static constexpr lua_metamethod event = lua_metamethod::SHR;
+    static lua_integer i(lua_integer a, lua_integer b) { return a >> b; }
+  };
+
+  /**
+   * vm_ops implements instructions of the current frame of a VM, outside of the interpreter.
+   * It is used by compiled code (the JIT and AOT compiled prototypes), which run the
+   * instructions they compile through vm_ops, and exit to the interpreter for the rest.
+   *
+   * Registers are indexed relative to the base of the frame. Operands that may be a register
+   * or a constant (RK) are passed as values, so that constants can be given directly.
+   * Instructions that branch return true if the branch is taken.
+   */
+  struct vm_ops {
+    static lua_value &R(quokka_vm &vm, size_t i) {
+      return vm._registers[vm._base + i];
+    }
+
+    static bytecode_prototype &proto(quokka_vm &vm) {
+      return *lua_func(vm._cl_ref).proto;
+    }
+
+    static lua_value *upval(quokka_vm &vm, size_t i) {
+      lua_upval &upv = *lua_func(vm._cl_ref).upval_views[i];
+      return is<size_t>(upv) ? &vm._registers[std::get<size_t>(upv)] : &std::get<lua_value>(upv);
+    }
+
+    // Write a number to a register, in place if the register already holds the same type
+    template <typename T>
+    static void set_number(quokka_vm &vm, size_t i, T v) {
+      size_t idx = vm._base + i;
+      if (idx < vm._registers.size() && is<T>(vm._registers[idx]))
+        std::get<T>(vm._registers[idx]) = v;
+      else
+        vm._registers.emplace(idx, v);
+    }
+
+    static void move(quokka_vm &vm, size_t a, size_t b) {
+      vm.set_register(vm._base + a, R(vm, b));
+    }
+
+    static void loadk(quokka_vm &vm, size_t a, const lua_value &k) {
+      if (is<lua_integer>(k))
+        set_number(vm, a, std::get<lua_integer>(k));
+      else if (is<lua_number>(k))
+        set_number(vm, a, std::get<lua_number>(k));
+      else
+        vm._registers.emplace(vm._base + a, k);
+    }
+
+    static void loadbool(quokka_vm &vm, size_t a, bool b) {
+      vm._registers.emplace(vm._base + a, b);
+    }
+
+    static void loadnil(quokka_vm &vm, size_t a, size_t b) {
+      for (size_t i = 0; i <= b; i++)
+        vm._registers.emplace(vm._base + a + i);
+    }
+
+    static void getupval(quokka_vm &vm, size_t a, size_t b) {
+      vm.set_register(vm._base + a, *upval(vm, b));
+    }
+
+    // Write the value found for a key of a table to R(A). If the table has no value for the key,
+    // the lookup continues to its __index metamethod, unless its metatable is known to lack one.
+    static void index(quokka_vm &vm, size_t a, const lua_value &tv, const lua_value &k, const lua_value *v, inline_cache *ic) {
+      if ((v == nullptr || is<lua_nil>(*v)) && !table(object(tv)).lacks_metamethod(lua_metamethod::INDEX))
+        vm.index_meta(tv, k, vm._base + a, ic);
+      else
+        vm.set_register_get(vm._base + a, v);
+    }
+
+    // Set a key of a table, unless its metatable may have __newindex
+    static void newindex(quokka_vm &vm, const lua_value &tv, const lua_value &k, const lua_value &v, inline_cache *ic) {
+      lua_object &o = *object(tv);
+      if (is<lua_array>(o)) {
+        std::get<lua_array>(o).set(k, v);
+      } else {
+        lua_table &t = std::get<lua_table>(o);
+        if (!t.lacks_metamethod(lua_metamethod::NEWINDEX))
+          vm.newindex_meta(tv, k, v, ic);
+        else if (ic != nullptr)
+          t.set(k, v, *ic);
+        else
+          t.set(k, v);
+      }
+    }
+
+    static void gettabup(quokka_vm &vm, size_t a, size_t b, const lua_value &c) {
+      const lua_value &tv = *upval(vm, b);
+      index(vm, a, tv, c, table(object(tv)).find(c), nullptr);
+    }
+
+    static void gettable(quokka_vm &vm, size_t a, size_t b, const lua_value &c) {
+      const lua_value &tv = R(vm, b);
+      lua_object &o = *object(tv);
+      if (is<lua_array>(o))
+        vm._registers.emplace(vm._base + a, std::get<lua_array>(o).get(c));
+      else
+        index(vm, a, tv, c, std::get<lua_table>(o).find(c), nullptr);
+    }
+
+    /* Table accesses with a constant key, using the inline cache of the instruction */
+
+    static void gettabup(quokka_vm &vm, size_t a, size_t b, const lua_value &c, inline_cache &ic) {
+      const lua_value &tv = *upval(vm, b);
+      index(vm, a, tv, c, table(object(tv)).find(c, ic), &ic);
+    }
+
+    static void gettable(quokka_vm &vm, size_t a, size_t b, const lua_value &c, inline_cache &ic) {
+      const lua_value &tv = R(vm, b);
+      lua_object &o = *object(tv);
+      if (is<lua_array>(o))
+        vm._registers.emplace(vm._base + a, std::get<lua_array>(o).get(c));
+      else
+        index(vm, a, tv, c, std::get<lua_table>(o).find(c, ic), &ic);
+    }
+
+    static void settabup(quokka_vm &vm, size_t a, const lua_value &b, const lua_value &c, inline_cache &ic) {
+      newindex(vm, *upval(vm, a), b, c, &ic);
+    }
+
+    static void settable(quokka_vm &vm, size_t a, const lua_value &b, const lua_value &c, inline_cache &ic) {
+      newindex(vm, R(vm, a), b, c, &ic);
+    }
+
+    static void self(quokka_vm &vm, size_t a, size_t b, const lua_value &c, inline_cache &ic) {
+      vm.set_register(vm._base + a + 1, R(vm, b));
+      const lua_value &tv = R(vm, a + 1);
+      index(vm, a, tv, c, table(object(tv)).find(c, ic), &ic);
+    }
+
+    static void settabup(quokka_vm &vm, size_t a, const lua_value &b, const lua_value &c) {
+      newindex(vm, *upval(vm, a), b, c, nullptr);
+    }
+
+    static void setupval(quokka_vm &vm, size_t a, size_t b) {
+      *upval(vm, b) = R(vm, a);
+    }
+
+    static void settable(quokka_vm &vm, size_t a, const lua_value &b, const lua_value &c) {
+      newindex(vm, R(vm, a), b, c, nullptr);
+    }
+
+    static void newtable(quokka_vm &vm, size_t a, unsigned int b, unsigned int c) {
+      object_view objref = vm.alloc_object();
+      // Presize from the number of array (B) and hash (C) entries in the constructor
+      lua_table &t = objref->emplace<lua_table>();
+      t.reserve(opcode_util::fb2int(b) + opcode_util::fb2int(c));
+      if constexpr (engine_traits::shapes)
+        t.shape = &vm._shapes;
+      vm._registers.emplace(vm._base + a, objref);
+    }
+
+    static void self(quokka_vm &vm, size_t a, size_t b, const lua_value &c) {
+      vm.set_register(vm._base + a + 1, R(vm, b));
+      const lua_value &tv = R(vm, a + 1);
+      index(vm, a, tv, c, table(object(tv)).find(c), nullptr);
+    }
+
+    template <typename OP>
+    static void arith(quokka_vm &vm, size_t a, const lua_value &nb, const lua_value &nc) {
+      if (is<lua_integer>(nb) && is<lua_integer>(nc)) {
+        set_number(vm, a, OP::i(std::get<lua_integer>(nb), std::get<lua_integer>(nc)));
+        return;
+      }
+      if constexpr (has_float<OP>::value) {
+        lua_number lnb, lnc;
+        if (tonumber(nb, lnb) && tonumber(nc, lnc)) {
+          set_number(vm, a, OP::n(lnb, lnc));
+          return;
+        }
+      }
+      vm.arith_meta(OP::event, nb, nc, vm._base + a);
+    }
+
+    static void unm(quokka_vm &vm, size_t a, size_t b) {
+      const lua_value &n = R(vm, b);
+      lua_number ln;
+      if (is<lua_integer>(n))
+        set_number(vm, a, -std::get<lua_integer>(n));
+      else if (tonumber(n, ln))
+        set_number(vm, a, -ln);
+      else
+        vm.arith_meta(lua_metamethod::UNM, n, n, vm._base + a);
+    }
+
+    static void bnot(quokka_vm &vm, size_t a, size_t b) {
+      const lua_value &n = R(vm, b);
+      lua_integer li;
+      if (tointeger(n, li))
+        set_number(vm, a, ~li);
+      else
+        vm.arith_meta(lua_metamethod::BNOT, n, n, vm._base + a);
+    }
+
+    static void op_not(quokka_vm &vm, size_t a, size_t b) {
+      vm._registers.emplace(vm._base + a, falsey(R(vm, b)));
+    }
+
+    /* Comparisons (OP_EQ, OP_LT and OP_LE), which use metamethods for tables */
+
+    static bool eq(quokka_vm &vm, const lua_value &a, const lua_value &b) {
+      if (a == b)
+        return true;
+      return is<object_view>(a) && is<object_view>(b) && vm.compare_meta(lua_metamethod::EQ, a, b);
+    }
+
+    static bool lt(quokka_vm &vm, const lua_value &a, const lua_value &b) {
+      if (is<object_view>(a) || is<object_view>(b))
+        return vm.compare_meta(lua_metamethod::LT, a, b);
+      return a < b;
+    }
+
+    static bool le(quokka_vm &vm, const lua_value &a, const lua_value &b) {
+      if (is<object_view>(a) || is<object_view>(b))
+        return vm.compare_meta(lua_metamethod::LE, a, b);
+      return a <= b;
+    }
+
+    // Close upvals >= R(A - 1), as in OP_JMP
+    static void close(quokka_vm &vm, size_t a) {
+      vm.close_upvals(vm._base + a - 1);
+    }
+
+    static bool test(quokka_vm &vm, size_t a, bool c) {
+      const lua_value &ta = R(vm, a);
+      return c ? falsey(ta) : !falsey(ta);
+    }
+
+    static bool testset(quokka_vm &vm, size_t a, size_t b, bool c) {
+      const lua_value &tb = R(vm, b);
+      if (c ? falsey(tb) : !falsey(tb))
+        return true;
+      vm.set_register(vm._base + a, tb);
+      return false;
+    }
+
+    static bool forloop(quokka_vm &vm, size_t a) {
+      lua_value &ra = R(vm, a);
+      if (is<lua_integer>(ra)) {
+        lua_integer step = std::get<lua_integer>(R(vm, a + 2));
+        lua_integer idx = std::get<lua_integer>(ra) + step;
+        lua_integer limit = std::get<lua_integer>(R(vm, a + 1));
+        if ((step > 0) ? (idx <= limit) : (limit <= idx)) {
+          std::get<lua_integer>(ra) = idx;
+          set_number(vm, a + 3, idx);
+          return true;
+        }
+      } else {
+        lua_number step = std::get<lua_number>(R(vm, a + 2));
+        lua_number idx = std::get<lua_number>(ra) + step;
+        lua_number limit = std::get<lua_number>(R(vm, a + 1));
+        if ((step > 0) ? (idx <= limit) : (limit <= idx)) {
+          std::get<lua_number>(ra) = idx;
+          set_number(vm, a + 3, idx);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    static bool tforloop(quokka_vm &vm, size_t a) {
+      lua_value &tv1 = R(vm, a + 1);
+      if (is_assigned(tv1)) {
+        vm.set_register(vm._base + a, tv1);
+        return true;
+      }
+      return false;
+    }
+
+   private:
+    template <typename OP, typename = void>
+    struct has_float : std::false_type {};
+    template <typename OP>
+    struct has_float<OP, std::void_t<decltype(OP::n)>> : std::true_type {};
+  };
+}  // namespace engine
+}  // namespace quokka
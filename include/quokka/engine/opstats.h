@@ -0,0 +1,67 @@
+#pragma once
+
+// Timing opcodes implies counting them
+#if defined(QUOKKA_OPCODE_CYCLES) && !defined(QUOKKA_OPCODE_STATS)
+#define QUOKKA_OPCODE_STATS
+#endif
+
+#ifdef QUOKKA_OPCODE_STATS
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "opcodes.h"
+
+#ifdef QUOKKA_OPCODE_CYCLES
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+namespace quokka {
+namespace engine {
+
+  /**
+   * Statistics of the instructions run by the interpreter, by opcode. Built with
+   * -DQUOKKA_OPCODE_STATS, the VM counts each instruction it runs, and with -DQUOKKA_OPCODE_CYCLES
+   * it also reads the cycle counter (TSC) before each, charging the cycles since the one before
+   * to it. Otherwise the instrumentation is compiled out of the interpreter.
+   *
+   * Quickened opcodes (e.g. OP_FORLOOP_INT) are counted separately from the opcode they
+   * specialise. The cycles of an instruction include any natives it calls, but not the
+   * instructions of Lua functions it calls (e.g. metamethods), which are counted themselves.
+   * Instructions run by compiled code (QUOKKA_JIT, QUOKKA_AOT) aren't counted, and their cycles
+   * are counted as compiled_cycles.
+   */
+  struct opcode_stats {
+    uint64_t executed[opcode_util::NUM_OPCODES] = {};
+    uint64_t cycles[opcode_util::NUM_OPCODES] = {};
+    uint64_t compiled_cycles = 0;
+  };
+
+  /**
+   * Statistics of the instructions of a prototype, run by any VM (see opcode_stats).
+   */
+  struct prototype_stats {
+    uint64_t executed = 0;
+    uint64_t cycles = 0;
+  };
+
+#ifdef QUOKKA_OPCODE_CYCLES
+  /**
+   * Read the cycle counter: the TSC on x86, or a steady clock elsewhere.
+   */
+  inline uint64_t opcode_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+  }
+#endif
+}  // namespace engine
+}  // namespace quokka
+
+#endif
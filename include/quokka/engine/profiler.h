@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+
+namespace quokka {
+namespace engine {
+
+  class quokka_vm;
+
+  /**
+   * A sampling profiler of the Lua functions run by a VM (see quokka_vm::set_profiler()).
+   *
+   * Samples are requested by tick(), which only sets a flag, so it can be called from a signal
+   * handler, an interrupt or another thread, such as the timer of start_timer(). The VM takes the
+   * sample at its next call or loop iteration, recording its chain of call frames, which are
+   * aggregated by stack. write_folded() writes the stacks in the folded format of flame graph
+   * tools (e.g. flamegraph.pl), one stack per line, with the number of samples of the stack.
+   *
+   * As function names are debug information, which is discarded, frames are named by where their
+   * function is defined: the chunk's source and the line of the function (e.g. "fib.lua:12"),
+   * or the line alone if the bytecode is stripped (e.g. "fn:12"), and "main" for the main chunk.
+   * In LINE mode, frames are also given the line they are running, if the chunk was read with
+   * line information (see bytecode_reader::set_line_info()), or the index of the instruction
+   * otherwise (e.g. "fib.lua:12:14" or "fn:12:pc3"). Native functions with a frame are named
+   * "[native]".
+   *
+   * Loops run by compiled code (QUOKKA_JIT, QUOKKA_AOT) only take a sample when they call
+   * a function or exit to the interpreter.
+   */
+  class lua_profiler {
+   public:
+    enum class mode { FUNCTION, LINE };
+
+    lua_profiler(mode m = mode::FUNCTION) : _mode(m) {}
+    ~lua_profiler();
+
+    lua_profiler(const lua_profiler &) = delete;
+    lua_profiler &operator=(const lua_profiler &) = delete;
+
+    /**
+     * Request a sample, which the VM takes at its next call or loop iteration.
+     * This is async-signal-safe, and may be called from any thread.
+     */
+    void tick() {
+      _pending.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Tick the profiler every interval of CPU time used by the process, with setitimer() and
+     * SIGPROF. Only one profiler at a time can use the timer.
+     * @return false if the timer isn't supported (on hosts without POSIX timers), or is in use
+     */
+    bool start_timer(unsigned int interval_us = 1000);
+
+    /**
+     * Stop the timer of start_timer().
+     */
+    void stop_timer();
+
+    /**
+     * Write the sampled stacks, in the folded format of flame graph tools.
+     */
+    void write_folded(std::ostream &out) const;
+
+    /**
+     * Get the number of samples taken.
+     */
+    uint64_t samples() const {
+      return _samples;
+    }
+
+    /**
+     * Discard the samples taken.
+     */
+    void clear();
+
+   private:
+    friend class quokka_vm;
+
+    bool pending() const {
+      return _pending.load(std::memory_order_relaxed);
+    }
+
+    std::atomic<bool> _pending{false};
+    mode _mode;
+    uint64_t _samples = 0;
+    // Samples by folded stack, and the stack being built by the VM
+    std::unordered_map<std::string, uint64_t> _stacks;
+    std::string _stack;
+  };
+}  // namespace engine
+}  // namespace quokka
@@ -7,7 +7,17 @@
 namespace quokka {
 namespace engine {
 
-  /* Refcount Object  */
+  /**
+   * Refcount Object
+   * 
+   * A refcount holds a variant that is unassigned (freed) when its uses reach zero. 
+   * 
+   * A refcount may also be deferred, in which case it is not freed when its uses reach
+   * zero, but is instead marked as pending. Deferred refcounts may be referenced without
+   * being used (such as from VM registers, see refcount_indexed_view), so a pending
+   * refcount is only freed by release(), once its owner has checked that nothing still
+   * borrows it.
+   */
   template <typename T, typename Enable=void>
   class refcount;
 
@@ -21,19 +31,58 @@ namespace engine {
     constexpr const std::variant<T...> &value() const { return *this; }
     constexpr std::variant<T...> &value() { return *this; }
 
-    constexpr bool is_free() const { return _refcount == 0; }
-    constexpr bool is_assigned() const { return _refcount > 0; }
+    constexpr bool is_free() const { return _refcount == 0 && !_pending; }
+    constexpr bool is_assigned() const { return _refcount > 0 || _pending; }
+    constexpr int uses() const { return _refcount; }
+
+    constexpr bool is_deferred() const { return _deferred; }
+    constexpr bool is_pending() const { return _pending; }
+    constexpr bool is_borrowed() const { return _borrowed; }
 
     inline void use() { _refcount++; }
     inline void unuse() {
       if (_refcount > 0) {
         _refcount--;
-        if (_refcount == 0)
-          unassign(*this);
+        if (_refcount == 0) {
+          if (_deferred)
+            _pending = true;
+          else
+            unassign(*this);
+        }
+      }
+    }
+
+    /**
+     * Set whether this refcount is deferred. This should only be set when it is allocated.
+     */
+    inline void defer(bool deferred) { _deferred = deferred; }
+
+    /**
+     * Mark a pending refcount as still being borrowed, so it survives the next release().
+     */
+    inline void mark_borrowed() { _borrowed = _pending; }
+
+    /**
+     * Release a pending refcount, freeing it if it is not in use or borrowed.
+     * @return true if the refcount was freed.
+     */
+    inline bool release() {
+      if (_borrowed) {
+        _borrowed = false;
+        return false;
+      }
+      _pending = false;
+      if (_refcount == 0) {
+        unassign(*this);
+        return true;
       }
+      return false;
     }
    private:
     int _refcount = 0;
+    bool _deferred = false;
+    bool _pending = false;
+    bool _borrowed = false;
   };
 }
 }
\ No newline at end of file
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+#include <utility>
+
+#include "smallvector.h"
+
+namespace quokka {
+namespace engine {
+
+/**
+ * A segmented_stack is a vector made up of fixed-size segments. The first segment is stored
+ * inline (like the stack storage of a small_vector), and further segments are allocated on the
+ * heap as the stack grows.
+ *
+ * Unlike small_vector, growing a segmented_stack never moves its elements. References to
+ * elements remain valid for as long as the elements exist, no matter how many elements are
+ * added after them. Segments are kept when the stack shrinks, so that a stack that repeatedly
+ * grows and shrinks across a segment boundary (such as during recursion) doesn't thrash.
+ *
+ * Elements are indexed as in a flat vector. SEGMENT_SIZE must be a power of two, so that an
+ * index is split into a segment and an offset with a shift and a mask.
+ *
+ * @param T The storage type of the stack
+ * @param SEGMENT_SIZE The number of elements in each segment
+ */
+template <typename T, size_t SEGMENT_SIZE>
+class segmented_stack {
+  static_assert((SEGMENT_SIZE & (SEGMENT_SIZE - 1)) == 0, "SEGMENT_SIZE must be a power of two");
+
+ public:
+  segmented_stack() {
+    _segments.emplace_back((T *)_inline);
+    _table = &_segments[0];
+  }
+
+  // The segment table refers to the inline segment, so the stack can't be copied or moved.
+  segmented_stack(const segmented_stack &) = delete;
+  segmented_stack &operator=(const segmented_stack &) = delete;
+
+  ~segmented_stack() {
+    clear();
+    for (size_t i = 1; i < _segments.size(); i++)
+      memory::free(_segments[i]);
+  }
+
+  /**
+   * Get a value at an index of the stack.
+   * Note that this does not perform bounds-checking.
+   */
+  T& operator[](size_t pos) const {
+    return _table[pos / SEGMENT_SIZE][pos % SEGMENT_SIZE];
+  }
+
+  /**
+   * Get the last value of the stack.
+   */
+  T& last() const {
+    return (*this)[_size - 1];
+  }
+
+  /**
+   * Get the size of the stack
+   */
+  size_t size() const {
+    return _size;
+  }
+
+  /**
+   * Get the number of elements the stack can hold without allocating a new segment.
+   */
+  size_t capacity() const {
+    return _segments.size() * SEGMENT_SIZE;
+  }
+
+  /**
+   * Get the most elements the stack has been reserved for (or held) at once.
+   */
+  size_t high_water() const {
+    return _high_water;
+  }
+
+  /**
+   * Get the size of the stack's heap allocations in bytes: the segments after the inline one,
+   * and the segment table once it spills.
+   */
+  size_t heap_bytes() const {
+    return (_segments.size() - 1) * SEGMENT_SIZE * sizeof(T) + _segments.heap_bytes();
+  }
+
+  /**
+   * Allocate segments until the stack can hold a certain number of elements. Existing
+   * elements are not moved.
+   */
+  void reserve(size_t size) {
+    if (size > _high_water)
+      _high_water = size;
+    while (capacity() < size) {
+      _segments.emplace_back((T *)memory::alloc(sizeof(T) * SEGMENT_SIZE));
+      _table = &_segments[0];
+    }
+  }
+
+  /**
+   * Chop this stack to a certain size, destructing all elements after the chopped size.
+   */
+  void chop(size_t top) {
+    for (size_t i = top; i < _size; i++)
+      (*this)[i].~T();
+    if (top < _size)
+      _size = top;
+  }
+
+  /**
+   * Clear this stack's elements
+   */
+  void clear() {
+    chop(0);
+  }
+
+  /**
+   * Emplace an element into this stack, at a certain index.
+   * This will grow the stack if necessary, and destruct any element already present
+   * at the index. If the index is past the end of the stack, the elements in between
+   * are default constructed.
+   * Forwards arguments to the constructor of the type T.
+   */
+  template<class... Args>
+  T& emplace(size_t pos, Args&&... args) {
+    if (pos < _size) {
+      (*this)[pos].~T();
+    } else {
+      reserve(pos + 1);
+      for (; _size < pos; _size++)
+        new(&(*this)[_size]) T();
+    }
+
+    T* place = &(*this)[pos];
+    new(place) T(std::forward<Args>(args)...);
+
+    if (pos >= _size)
+      _size = pos + 1;
+
+    return *place;
+  }
+
+  /**
+   * Emplace an element into the end of this stack.
+   * This will grow the stack if necessary.
+   * Forwards arguments to the constructor of type T.
+   */
+  template<class... Args>
+  T& emplace_back(Args&&... args) {
+    return emplace(_size, std::forward<Args>(args)...);
+  }
+
+ private:
+  alignas(alignof(T)) char _inline[SEGMENT_SIZE * sizeof(T)];
+  small_vector<T *, 8> _segments;
+  // Raw segment table, cached from _segments so that indexing doesn't go through raw_buffer()
+  T **_table;
+  size_t _size = 0;
+  size_t _high_water = 0;
+};
+}  // namespace engine
+}  // namespace quokka
@@ -4,6 +4,8 @@
 #include <utility>
 #include <stdlib.h>
 
+#include "memory.h"
+
 namespace quokka {
 namespace engine {
 
@@ -82,7 +84,7 @@ class small_vector_base : public small_vector_impl {
   void clear_elements() {
     clear();
     if (_heapvec != nullptr)
-      free(_heapvec);
+      memory::free(_heapvec);
   }
 };
 
@@ -95,10 +97,13 @@ class small_vector_base : public small_vector_impl {
  * 
  * @param T The storage type of the vector
  * @param STACK_SIZE The maximum size of the vector on the stack
- * @param GROW_BY The size to grow the vector by when new elements are added
+ * @param GROW_BY The size to grow the vector by when new elements are added, or 0 to double
+ *                its capacity
  */
 template <typename T, size_t STACK_SIZE, size_t GROW_BY=STACK_SIZE>
 class small_vector : public small_vector_base<T> {
+  static_assert(GROW_BY > 0 || STACK_SIZE > 0, "A vector that doubles its capacity must have a STACK_SIZE");
+
  public:
   small_vector() { }
 
@@ -108,6 +113,22 @@ class small_vector : public small_vector_base<T> {
       emplace_back(other[i]);
   }
 
+  small_vector(small_vector &&other) noexcept {
+    if (other.is_stack()) {
+      for (size_t i = 0; i < other.size(); i++)
+        emplace_back(std::move(other[i]));
+      other.clear();
+    } else {
+      // Steal the heap buffer
+      this->_heapvec = other._heapvec;
+      this->_size = other._size;
+      _alloced_size = other._alloced_size;
+      other._heapvec = nullptr;
+      other._size = 0;
+      other._alloced_size = STACK_SIZE;
+    }
+  }
+
   ~small_vector() {
     this->clear_elements();
   }
@@ -132,7 +153,7 @@ class small_vector : public small_vector_base<T> {
       (raw_buffer()[pos]).~T();
     } else {
       while (pos >= _alloced_size)
-        grow(this->_size + GROW_BY);
+        grow(GROW_BY > 0 ? this->_size + GROW_BY : _alloced_size * 2);
     }
     
     T* place = &raw_buffer()[pos];
@@ -160,12 +181,21 @@ class small_vector : public small_vector_base<T> {
     return this->_heapvec;
   }
 
+  /**
+   * Get the size of this vector's heap buffer in bytes, or 0 if it is on the stack.
+   */
+  size_t heap_bytes() const {
+    return this->_heapvec != nullptr ? _alloced_size * sizeof(T) : 0;
+  }
+
  protected:
   void grow(size_t next_size) override {
     if (next_size > STACK_SIZE && next_size > _alloced_size) {
-      T* new_buf = (T*)malloc(sizeof(T) * next_size);
+      T* new_buf = (T*)memory::alloc(sizeof(T) * next_size);
+      // Elements are moved rather than copied. Elements may hold views into this
+      // vector, and copying them would use() elements that are yet to be moved.
       for (size_t i = 0; i < this->_size; i++)
-        new(&new_buf[i]) T(raw_buffer()[i]);
+        new(&new_buf[i]) T(std::move(raw_buffer()[i]));
       
       size_t os = this->_size;
       this->clear_elements();
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The default limits of shapes (see lua_shape), which can also be set without choosing traits.
+ */
+#ifndef QUOKKA_SHAPE_MAX_KEYS
+#define QUOKKA_SHAPE_MAX_KEYS 64
+#endif
+#ifndef QUOKKA_MAX_SHAPES
+#define QUOKKA_MAX_SHAPES 1024
+#endif
+
+namespace quokka {
+namespace engine {
+
+  /**
+   * Engine traits are the compile-time choices of the engine's layout: the types of Lua
+   * integers and floats, the inline capacity of its containers (the number of elements stored
+   * in the container itself, before it moves to the heap), how its containers grow, and the
+   * optional features compiled in.
+   *
+   * A build uses one set of traits, engine_traits, chosen by defining one of:
+   *  - QUOKKA_PROFILE_EMBEDDED, for microcontrollers with tens of kilobytes of RAM (embedded_traits)
+   *  - QUOKKA_PROFILE_SERVER, for hosts with plenty of memory (server_traits)
+   *  - QUOKKA_TRAITS_HEADER, as a header (e.g. -DQUOKKA_TRAITS_HEADER='"my_traits.h"') that
+   *    declares a struct of custom traits, usually derived from one of the others, and defines
+   *    QUOKKA_TRAITS as its name
+   *
+   * or default_traits otherwise. Every file that includes the engine must be built with the same
+   * traits. Bytecode is converted to the integer and float types when it is loaded.
+   */
+  struct default_traits {
+    using integer = int;
+    using number = double;
+
+    // Characters stored in a lua_string
+    static constexpr size_t string_inline = 16;
+    // Entries stored in a lua_table
+    static constexpr size_t table_inline = 8;
+    // Registers in each segment of the register stack (a power of two), the first of which is
+    // stored in the VM
+    static constexpr size_t register_segment = 64;
+    // Call frames, objects and upvals stored in the VM
+    static constexpr size_t call_inline = 16;
+    static constexpr size_t object_inline = 8;
+    static constexpr size_t upval_inline = 2;
+    static constexpr size_t upval_grow = 4;
+
+    // If true, containers double in size when they grow. Otherwise, they grow by their inline
+    // capacity (or upval_grow), which wastes less memory but copies more.
+    static constexpr bool geometric_growth = false;
+
+    // Shapes of tables, and the inline caches of table accesses that use them (see lua_shape)
+    static constexpr bool shapes = true;
+    static constexpr size_t max_shape_keys = QUOKKA_SHAPE_MAX_KEYS;
+    static constexpr size_t max_shapes = QUOKKA_MAX_SHAPES;
+  };
+
+  /**
+   * Traits for microcontrollers: 32-bit integers and single precision floats (as most FPUs of
+   * microcontrollers only support single precision), small inline capacities and no shapes,
+   * so that a VM and its tables take as little RAM as possible.
+   */
+  struct embedded_traits : default_traits {
+    using integer = int32_t;
+    using number = float;
+
+    static constexpr size_t string_inline = 8;
+    static constexpr size_t table_inline = 2;
+    static constexpr size_t register_segment = 16;
+    static constexpr size_t call_inline = 4;
+    static constexpr size_t object_inline = 2;
+    static constexpr size_t upval_inline = 2;
+    static constexpr size_t upval_grow = 2;
+
+    static constexpr bool shapes = false;
+  };
+
+  /**
+   * Traits for servers: 64-bit integers as in Lua 5.3, deeper stacks before allocating,
+   * geometric growth, and more shapes.
+   */
+  struct server_traits : default_traits {
+    using integer = int64_t;
+    using number = double;
+
+    static constexpr size_t register_segment = 256;
+    static constexpr size_t call_inline = 64;
+
+    static constexpr bool geometric_growth = true;
+
+    static constexpr size_t max_shape_keys = 128;
+    static constexpr size_t max_shapes = 16384;
+  };
+}  // namespace engine
+}  // namespace quokka
+
+#ifdef QUOKKA_TRAITS_HEADER
+#include QUOKKA_TRAITS_HEADER
+#endif
+
+namespace quokka {
+namespace engine {
+
+#if defined(QUOKKA_TRAITS)
+  using engine_traits = QUOKKA_TRAITS;
+#elif defined(QUOKKA_PROFILE_EMBEDDED)
+  using engine_traits = embedded_traits;
+#elif defined(QUOKKA_PROFILE_SERVER)
+  using engine_traits = server_traits;
+#else
+  using engine_traits = default_traits;
+#endif
+
+  /**
+   * The GROW_BY of a small_vector of the engine with an inline capacity of n (see
+   * default_traits::geometric_growth).
+   */
+  constexpr size_t engine_grow(size_t n) {
+    return engine_traits::geometric_growth ? 0 : n;
+  }
+}  // namespace engine
+}  // namespace quokka
@@ -2,16 +2,18 @@
 
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 #include "view.h"
 #include "smallstring.h"
+#include "traits.h"
 
 namespace quokka {
 namespace engine {
   using lua_instruction = size_t;
-  using lua_integer     = int;
-  using lua_number      = double;
-  using lua_string      = small_string<16>;
+  using lua_integer     = engine_traits::integer;
+  using lua_number      = engine_traits::number;
+  using lua_string      = small_string<engine_traits::string_inline, engine_grow(engine_traits::string_inline)>;
   using lua_nil         = std::monostate;
 
   /**
@@ -76,13 +78,140 @@ namespace engine {
     small_vector<upval_view, 4> upval_views;
   };
 
+  /**
+   * An intrinsic is a native function that the VM can run inline, without a call frame, when
+   * it is called from Lua with at most two arguments and a single result (e.g. math.floor(x)).
+   * Missing arguments are nil.
+   * @return false if the intrinsic doesn't accept the arguments, in which case the result is nil.
+   */
+  using lua_intrinsic = bool (*)(const lua_value &a, const lua_value &b, lua_value &result);
+
+  /**
+   * The arguments of a fast native (see lua_fast_native), as a contiguous span of values.
+   */
+  struct lua_args {
+    const lua_value *values;
+    int count;
+
+    inline int size() const { return count; }
+
+    /**
+     * Get an argument, indexed from 0. Arguments past the end are nil.
+     */
+    inline const lua_value &operator[](int i) const {
+      static const lua_value nil;
+      return i < count ? values[i] : nil;
+    }
+  };
+
+  /**
+   * A fast native is a native function with at most one result, which the VM calls without a
+   * call frame. Arguments are passed in place, and the result is written straight to the
+   * register that the caller expects it in. Fast natives must not push to or pop from the stack.
+   * @return The number of results (0 or 1). If 1, the result is in `result`.
+   */
+  using lua_fast_native = int (*)(quokka_vm &vm, lua_args args, lua_value &result);
+
+  /**
+   * An iterator is a native function for generic for loops (e.g. next), which the VM calls in
+   * place of the loop's call, without a call frame. It is given the state and control variable
+   * of the loop, and advances the control variable to the next key, setting its value.
+   * @return false at the end of the iteration, in which case the control variable is nil.
+   */
+  using lua_iterator = bool (*)(const lua_value &state, lua_value &control, lua_value &value);
+
   /**
    * lua_native_closure is the implementation of a closure (function) implemented in C++ (native).
-   * It is simply a function reference, either a C function or C++ function / lambda.
+   * It is either a plain function pointer with a context pointer, which is passed back to it on
+   * each call, or a std::function (e.g. a lambda with captures).
+   * 
+   * Function pointers are preferred, as they are called directly, without the type erasure
+   * (and possible heap allocation) of std::function. See bind.h for binding C++ functions.
    */
   struct lua_native_closure {
     using func_t = std::function<int(quokka_vm &)>;
+    using ptr_t = int (*)(quokka_vm &, void *ctx);
+    ptr_t ptr = nullptr;
+    void *ctx = nullptr;
+    // Used instead of ptr or func if set (see lua_fast_native)
+    lua_fast_native fast = nullptr;
+    // Used if ptr and fast are nullptr
     func_t func;
+    // The inline implementation of the function, if it is an intrinsic (see lua_intrinsic)
+    lua_intrinsic intrinsic = nullptr;
+    // The implementation of the function in for loops, if it is an iterator (see lua_iterator)
+    lua_iterator iterator = nullptr;
+  };
+
+  /**
+   * A lua_shape (hidden class) describes the keys of a table whose keys are all strings, in the
+   * order they were added. Tables that add the same keys in the same order share a shape, so the
+   * index (slot) of a key in the entries of a table is known from its shape. This allows table
+   * accesses with a constant key to cache the slot of the key per instruction (see inline_cache),
+   * rather than searching the entries and comparing strings.
+   * 
+   * The shapes of a VM form a tree, from its root (empty) shape, with a transition for each key
+   * added to a table of the parent shape. Shapes are kept for the life of the VM. To bound their
+   * memory, tables with more than engine_traits::max_shape_keys keys have no shape, and nor do new
+   * key orders once the VM has engine_traits::max_shapes shapes.
+   */
+  struct lua_shape {
+    // Unique over all VMs and never reused, so that a cache can't match a shape of another VM
+    uint32_t id;
+    // The number of keys
+    size_t size;
+    // The last key added
+    lua_string key;
+
+    /**
+     * Create a root (empty) shape.
+     */
+    lua_shape();
+    lua_shape(const lua_shape &) = delete;
+    lua_shape &operator=(const lua_shape &) = delete;
+
+    /**
+     * Get the shape of a table of this shape with a key added, creating it if there isn't one.
+     * @return The shape, or nullptr if the table should no longer have a shape.
+     */
+    const lua_shape *add(const lua_string &k) const;
+
+   private:
+    lua_shape(const lua_shape *root, size_t size, const lua_string &k);
+
+    const lua_shape *_root;
+    // The number of shapes in the tree, if this is the root
+    mutable size_t _count = 1;
+    mutable small_vector<std::unique_ptr<lua_shape>, 2> _transitions;
+  };
+
+  /**
+   * The inline cache of a table access with a constant key: the slot of the key in tables of the
+   * shape last seen by the instruction (see lua_shape).
+   */
+  struct inline_cache {
+    // The slot of a key that tables of the shape don't have
+    static constexpr uint32_t ABSENT = UINT32_MAX;
+
+    // ID of the shape, or 0 if none
+    uint32_t shape = 0;
+    uint32_t slot = 0;
+    /**
+     * The caches of an access that misses the table and continues to the __index table of its
+     * metatable (e.g. a method call on an object): the slot of __index in the metatable, then
+     * of the key in the __index table. Allocated on the first such access.
+     */
+    std::unique_ptr<inline_cache[]> chain;
+  };
+
+  /**
+   * The events of metamethods, e.g. INDEX for __index. Each is a bit of
+   * lua_table::absent_metamethods.
+   */
+  enum class lua_metamethod : uint8_t {
+    INDEX, NEWINDEX, CALL, EQ, LT, LE, LEN, CONCAT, UNM, BNOT,
+    ADD, SUB, MUL, DIV, MOD, POW, IDIV, BAND, BOR, BXOR, SHL, SHR,
+    COUNT
   };
 
   /**
@@ -100,7 +229,35 @@ namespace engine {
 
       node(const lua_value &k, const lua_value &v) : key(k), value(v) {}
     };
-    small_vector<node, 8> entries;
+    small_vector<node, engine_traits::table_inline, engine_grow(engine_traits::table_inline)> entries;
+    /**
+     * The number of leading entries that hold the keys 1, 2, .. sequence, in order. Entries are
+     * never removed, so these are found by index rather than by searching the entries, and
+     * setting key sequence + 1 in a table with no other entries appends it without searching.
+     */
+    size_t sequence = 0;
+    /**
+     * The shape of the table, if it has one (see lua_shape). Tables created by Lua start with the
+     * root shape of their VM, and lose it if they are given a key that isn't a string. Tables
+     * without a shape (e.g. arrays and dictionaries) are searched, rather than cached.
+     */
+    const lua_shape *shape = nullptr;
+    /**
+     * The metatable of the table (see setmetatable), or nil.
+     */
+    lua_value metatable;
+    /**
+     * The metamethods that this table is known not to have when it is used as a metatable, as a
+     * bit per lua_metamethod. A bit is set when a search for the metamethod misses, and all bits
+     * are cleared when the table is set, as the flags of PUC Lua's tables are. Instructions on a
+     * table without a metatable, or whose metatable lacks the metamethod, only test a bit.
+     */
+    mutable uint32_t absent_metamethods = 0;
+
+    /**
+     * Reserve space for a number of entries, e.g. from the size hints of a table constructor.
+     */
+    inline void reserve(size_t n) { entries.reserve(n); }
 
     inline lua_value get(const char *str) {
       return get(lua_string{str});
@@ -114,6 +271,20 @@ namespace engine {
      */
     lua_value get(const lua_value &k) const;
 
+    /**
+     * Find the value of an entry in the table by key, without copying it.
+     * 
+     * @param k The key of the entry
+     * @return A pointer to the value of the entry, or nullptr if there is no such entry.
+     */
+    const lua_value *find(const lua_value &k) const;
+
+    /**
+     * Find the value of an entry in the table by a constant key, using the inline cache of the
+     * instruction that accesses it. The cache is updated on a miss.
+     */
+    const lua_value *find(const lua_value &k, inline_cache &ic) const;
+
     inline void set(const char *strk, const char *strv) { set(lua_string{strk}, lua_string{strv}); }
     inline void set(const lua_value &k, const char *strv) { set(k, lua_string{strv}); }
     inline void set(const char *strk, const lua_value &v) { set(lua_string{strk}, v); }
@@ -125,9 +296,148 @@ namespace engine {
      * @param v The value of the entry
      */
     void set(const lua_value &k, const lua_value &v);
+
+    /**
+     * Set a value in the table by a constant key, using the inline cache of the instruction that
+     * sets it (see find()).
+     */
+    void set(const lua_value &k, const lua_value &v, inline_cache &ic);
+
+    /**
+     * Find the entry after an entry, for iterating the table. Entries with a nil value are
+     * skipped, as their keys have been removed from the table.
+     * 
+     * The last entry found is remembered, so that each step of an iteration is O(1) rather than
+     * a search for the previous key.
+     * 
+     * @param k The key of the entry, or nil to find the first entry
+     * @return The index of the next entry, or entries.size() if there are no more entries (or
+     *         there is no entry with the key k).
+     */
+    size_t next(const lua_value &k) const;
+
+    /**
+     * Find a metamethod of this table, as a metatable. The search is skipped if the metamethod
+     * is known to be absent (see absent_metamethods).
+     * 
+     * @param e The event of the metamethod
+     * @param ic The inline cache of the instruction that uses the metamethod, if any
+     * @return The metamethod, or nullptr if the table doesn't have it.
+     */
+    const lua_value *find_metamethod(lua_metamethod e, inline_cache *ic = nullptr) const;
+
+    /**
+     * Whether the table has no metatable, or its metatable is known to lack a metamethod.
+     */
+    inline bool lacks_metamethod(lua_metamethod e) const;
+
+   private:
+    // Index of the entry with a key, or entries.size() if there is no such entry
+    size_t index_of(const lua_value &k) const;
+
+    // Index of the entry last found by next()
+    mutable size_t _cursor = 0;
+  };
+
+  /**
+   * A lua_array is a fixed-length array of numbers, stored as a plain buffer of elements
+   * (float64, int32 or uint8) rather than as table entries. Scripts index it like a table,
+   * from 1 to #array. Float64 elements are read as numbers, and other elements as integers.
+   * 
+   * Reading an index out of range gives nil, and writing an index out of range or a value that
+   * isn't a number does nothing, as an array can't grow.
+   * 
+   * The buffer is either owned by the array, or is a buffer of the host, which must outlive the
+   * array. The latter allows the host to pass data (e.g. sensor frames) to scripts without copying.
+   */
+  struct lua_array {
+    enum class element_type : uint8_t { FLOAT64, INT32, UINT8 };
+
+    element_type type;
+    void *data;
+    size_t length;
+
+    /**
+     * Create an array that owns its buffer, with all elements set to 0.
+     */
+    lua_array(element_type type, size_t length);
+
+    /**
+     * Create an array over a buffer of the host, without copying it.
+     */
+    lua_array(element_type type, void *data, size_t length);
+
+    lua_array(const lua_array &other);
+    lua_array(lua_array &&other) noexcept;
+    lua_array &operator=(const lua_array &other);
+    lua_array &operator=(lua_array &&other) noexcept;
+    ~lua_array();
+
+    /**
+     * Get the size of the buffer in bytes if the array owns it, or 0 if it is a buffer of the host.
+     */
+    size_t owned_bytes() const;
+
+    /**
+     * Get an element of the array by key (indexed from 1).
+     * @return The element, or nil if the key isn't an index of the array.
+     */
+    inline lua_value get(const lua_value &k) const {
+      size_t i;
+      if (!index(k, i))
+        return lua_value();
+      switch (type) {
+        case element_type::FLOAT64: return (lua_number)static_cast<const double *>(data)[i];
+        case element_type::INT32: return (lua_integer)static_cast<const int32_t *>(data)[i];
+        default: return (lua_integer)static_cast<const uint8_t *>(data)[i];
+      }
+    }
+
+    /**
+     * Set an element of the array by key (indexed from 1). Integer elements are truncated to
+     * the element type.
+     */
+    inline void set(const lua_value &k, const lua_value &v) {
+      size_t i;
+      if (!index(k, i) || !(is<lua_integer>(v) || is<lua_number>(v)))
+        return;
+      switch (type) {
+        case element_type::FLOAT64:
+          static_cast<double *>(data)[i] = is<lua_number>(v) ? std::get<lua_number>(v) : (lua_number)std::get<lua_integer>(v);
+          break;
+        case element_type::INT32:
+          static_cast<int32_t *>(data)[i] = (int32_t)(is<lua_integer>(v) ? std::get<lua_integer>(v) : (lua_integer)std::get<lua_number>(v));
+          break;
+        default:
+          static_cast<uint8_t *>(data)[i] = (uint8_t)(is<lua_integer>(v) ? std::get<lua_integer>(v) : (lua_integer)std::get<lua_number>(v));
+          break;
+      }
+    }
+
+   private:
+    // Convert a key to a (0-based) index into the buffer
+    inline bool index(const lua_value &k, size_t &out) const {
+      if (is<lua_integer>(k)) {
+        lua_integer i = std::get<lua_integer>(k);
+        if (i < 1 || (size_t)i > length)
+          return false;
+        out = (size_t)i - 1;
+        return true;
+      } else if (is<lua_number>(k)) {
+        // Floats with an integral value are also indices, as with table keys
+        lua_number n = std::get<lua_number>(k);
+        if (!(n >= 1 && n <= (lua_number)length) || n != (lua_number)(size_t)n)
+          return false;
+        out = (size_t)n - 1;
+        return true;
+      }
+      return false;
+    }
+
+    bool _owned;
   };
 
-  using object_variant_t = std::variant<lua_nil, lua_table, lua_closure, lua_native_closure>;
+  using object_variant_t = std::variant<lua_nil, lua_table, lua_closure, lua_native_closure, lua_array>;
 
   /**
    * Lua objects are datatypes that are described by more than just their value. Unlike
@@ -209,7 +519,7 @@ namespace engine {
     return s;
   }
 
-  inline object_view object(const lua_value &val) {
+  inline const object_view &object(const lua_value &val) {
     return std::get<object_view>(val);
   }
 
@@ -270,7 +580,7 @@ namespace engine {
     return b <= a;
   }
 
-  inline lua_table &table(object_view v) {
+  inline lua_table &table(const object_view &v) {
     return std::get<lua_table>(*v);
   }
 
@@ -278,7 +588,21 @@ namespace engine {
     return table(object(v));
   }
 
-  inline lua_closure &lua_func(object_view v) {
+  inline bool lua_table::lacks_metamethod(lua_metamethod e) const {
+    return is<lua_nil>(metatable) || (table(object(metatable)).absent_metamethods & (1u << (unsigned)e));
+  }
+
+  /**
+   * Find the metamethod of a value for an event, if the value is a table with a metatable.
+   * @return The metamethod, or nullptr if the value doesn't have it.
+   */
+  const lua_value *find_metamethod(const lua_value &v, lua_metamethod e, inline_cache *ic = nullptr);
+
+  inline bool is_function(const lua_value &v) {
+    return is<object_view>(v) && (is<lua_closure>(*object(v)) || is<lua_native_closure>(*object(v)));
+  }
+
+  inline lua_closure &lua_func(const object_view &v) {
     return std::get<lua_closure>(*v);
   }
 
@@ -286,7 +610,7 @@ namespace engine {
     return lua_func(object(v));
   }
 
-  inline lua_native_closure &native_func(object_view v) {
+  inline lua_native_closure &native_func(const object_view &v) {
     return std::get<lua_native_closure>(*v);
   }
 
@@ -299,7 +623,8 @@ namespace engine {
       [&](lua_nil) -> lua_tag_type { return lua_tag_type::NIL; },
       [&](lua_table) -> lua_tag_type { return lua_tag_type::TABLE; },
       [&](lua_closure) -> lua_tag_type { return lua_tag_type::FUNC; },
-      [&](lua_native_closure) -> lua_tag_type { return lua_tag_type::FUNC; }
+      [&](lua_native_closure) -> lua_tag_type { return lua_tag_type::FUNC; },
+      [&](const lua_array &) -> lua_tag_type { return lua_tag_type::USER_DATA; }
     }, o.value());
   }
 
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "vm.h"
+
+namespace quokka {
+namespace engine {
+
+  /**
+   * Bulk numeric functions over typed arrays (see lua_array), for scripts that would otherwise
+   * loop over arrays element by element. Float64 arrays are processed with SIMD instructions
+   * where available (SSE2, or AVX2 and FMA if the CPU supports them, chosen at runtime on
+   * x86-64), and a scalar loop otherwise. Other element types always use the scalar loop.
+   *
+   * Functions that write an array take the destination first, which may be one of the sources.
+   * They process as many elements as the shortest of their arrays, and return the destination.
+   *
+   *   vec.new(n)                 A float64 array of n zeros
+   *   vec.add(dst, a, b)         dst = a + b
+   *   vec.mul(dst, a, b)         dst = a * b
+   *   vec.fma(dst, a, b, c)      dst = a * b + c (fused with AVX2)
+   *   vec.scale(dst, a, s)       dst = a * s
+   *   vec.clamp(dst, a, lo, hi)  dst = min(max(a, lo), hi)
+   *   vec.dot(a, b)              The sum of a * b
+   *   vec.sum(a)                 The sum of a
+   *   vec.min(a), vec.max(a)     The smallest / largest element of a, or nil if a is empty
+   *
+   * The order in which sums are accumulated depends on the instructions used, so results may
+   * differ in the last bits between machines.
+   */
+  namespace vec {
+    /**
+     * Define the vec library in the global env of a VM.
+     */
+    void define(quokka_vm &vm);
+  }  // namespace vec
+}  // namespace engine
+}  // namespace quokka
@@ -29,9 +29,13 @@ namespace engine {
       return (_vec == other._vec && _idx == other._idx);
     }
 
-    bool is_valid() {
+    bool is_valid() const {
       return _vec != nullptr;
     }
+
+    constexpr size_t index() const {
+      return _idx;
+    }
    protected:
     V *_vec = nullptr;
     size_t _idx;
@@ -40,7 +44,20 @@ namespace engine {
   template <typename T>
   using small_vector_view = indexed_view<T, small_vector_base<T>>;
 
-  /* Refcount View */
+  /**
+   * Tag for constructing a borrowed refcount view, see refcount_indexed_view.
+   */
+  struct borrow_t {
+    explicit borrow_t() = default;
+  };
+  inline constexpr borrow_t borrowed{};
+
+  /**
+   * Refcount View
+   * 
+   * A view that uses the refcount it points to for as long as it exists. A view may also
+   * be borrowed from a deferred refcount, in which case it does not use it.
+   */
   template <typename T, typename V>
   class refcount_indexed_view : public indexed_view<T, V> {
    public:
@@ -57,15 +74,35 @@ namespace engine {
 
     refcount_indexed_view(const refcount_indexed_view &other) 
         : refcount_indexed_view(other._vec, other._idx) { }
-    refcount_indexed_view(refcount_indexed_view &&other)
-        : refcount_indexed_view(other._vec, other._idx) { }
+    /**
+     * Borrow a view. If the refcount is deferred, the borrowed view does not use it, 
+     * otherwise the borrowed view is a regular copy.
+     * 
+     * Borrowed views must only be stored where the owner of the deferred refcount will
+     * find them before releasing it (for the VM, this is the registers).
+     */
+    refcount_indexed_view(const refcount_indexed_view &other, borrow_t)
+        : indexed_view<T, V>(other._vec, other._idx) {
+      if (is_valid()) {
+        _counted = !get()->is_deferred();
+        if (_counted)
+          get()->use();
+      }
+    }
+
+    refcount_indexed_view(refcount_indexed_view &&other) noexcept
+        : indexed_view<T, V>(other._vec, other._idx), _counted(other._counted) {
+      // Steal the use from the other view
+      other._vec = nullptr;
+    }
 
     constexpr refcount_indexed_view &operator=(const refcount_indexed_view &other) {
-      if (is_valid())
+      if (is_valid() && _counted)
         get()->unuse();
       
       this->_vec = other._vec;
       this->_idx = other._idx;
+      _counted = true;
 
       if (is_valid())
         get()->use();
@@ -74,9 +111,16 @@ namespace engine {
     }
 
     ~refcount_indexed_view() {
-      if (is_valid())
+      if (is_valid() && _counted)
         get()->unuse();
     }
+
+    constexpr bool is_counted() const {
+      return _counted;
+    }
+
+   private:
+    bool _counted = true;
   };
 
   template <typename T>
@@ -2,9 +2,17 @@
 
 #include "bytecode.h"
 #include "smallvector.h"
+#include "segmented_stack.h"
 #include "opcodes.h"
+#include "gc.h"
+#include "memory.h"
+#include "profiler.h"
 
 #include <functional>
+#include <memory>
+#ifdef QUOKKA_OPCODE_STATS
+#include <iosfwd>
+#endif
 
 namespace quokka {
 namespace engine {
@@ -37,6 +45,38 @@ namespace engine {
     unsigned callstatus = 0;
   };
 
+  /**
+   * A snapshot of the heap of a VM, see quokka_vm::inspect_heap().
+   */
+  struct heap_stats {
+    // Live objects, by kind. Natives include intrinsics and iterators.
+    size_t tables = 0;
+    size_t closures = 0;
+    size_t natives = 0;
+    size_t arrays = 0;
+    // Slots of the object pool, live or free
+    size_t object_slots = 0;
+    // Live upvals, and those of them that are open (still refer to a register)
+    size_t upvals = 0;
+    size_t open_upvals = 0;
+    // Registers in use, the most reserved at once, and the capacity of the register stack
+    size_t registers = 0;
+    size_t register_high_water = 0;
+    size_t register_capacity = 0;
+    // Call frames in use
+    size_t call_depth = 0;
+    // Bytes of the containers that have spilled from their inline storage to the heap: the
+    // entries of tables, strings, the upvals of closures, and the pools and stacks of the VM
+    size_t spill_bytes = 0;
+    // Strings held by registers, tables and upvals, and their characters (inline or spilled)
+    size_t strings = 0;
+    size_t string_bytes = 0;
+    // Bytes of the buffers owned by typed arrays
+    size_t array_bytes = 0;
+    // Bytes of the prototypes loaded into the VM: their code, constants and inline caches
+    size_t prototype_bytes = 0;
+  };
+
   /**
    * The Quokka VM is the runtime of the Quokka Lua Engine. It is responsible
    * for interpreting bytecode instructions, and storing all data related to the
@@ -56,6 +96,11 @@ namespace engine {
     quokka_vm(bytecode_chunk &bc) : quokka_vm() {
       load(bc);
     }
+
+    /**
+     * Destroy the VM, dropping the references between its objects before they are freed.
+     */
+    ~quokka_vm();
     
     /**
      * Load some bytecode into the VM. This should only be done if using the default
@@ -75,10 +120,53 @@ namespace engine {
      * Any required arguments should be pushed onto the stack using push().
      * After the function is called, its return values can be retrieved using pop().
      * 
+     * If the call runs out of memory (see set_memory_limit()), it is abandoned: the frames it
+     * pushed are unwound, the function and its arguments are popped, no results are pushed,
+     * and false is returned, after which the VM can be used as before.
+     * 
+     * @param nargs The number of arguments to the function. Default 0
+     * @param nreturn The number of return values from the function. Default 0
+     * @return true if the call completed, false if it ran out of memory
+     */
+    bool call(size_t nargs = 0, int nreturn = 0);
+
+    /**
+     * Call a function on the stack as a scoped call. This behaves identically to call(),
+     * except that objects and upvals allocated during the call are bump-allocated from the
+     * top of their pools (an arena), instead of reusing free slots anywhere in the pool.
+     * 
+     * When the call returns, the arena is released in one step, chopping every trailing
+     * free slot from the pools. Objects that escaped the call (i.e. through return values,
+     * globals or upvals) are still referenced, and so remain in the pool as regular objects.
+     * 
+     * This is useful for request-scoped scripts that allocate many short-lived tables or
+     * closures, as the pools do not grow with the garbage of each call.
+     * 
      * @param nargs The number of arguments to the function. Default 0
      * @param nreturn The number of return values from the function. Default 0
+     * @return true if the call completed, false if it ran out of memory
+     */
+    bool call_scoped(size_t nargs = 0, int nreturn = 0);
+
+    /**
+     * Call a function once for each row of a batch of arguments. This is equivalent to pushing
+     * the function and arguments, calling and popping the results for each row, but the function
+     * and arguments are written straight into one register window that is reused for every row,
+     * and deferred reference counts are only reconciled once at the end of the batch.
+     * 
+     * Arguments and results are columnar: argument i of a row is inputs[i][row], and result i
+     * of a row is written to outputs[i][row].
+     * 
+     * @param fn The function to call
+     * @param inputs The argument columns, each with nrows values
+     * @param nargs The number of arguments (columns in inputs)
+     * @param outputs The result columns, each with space for nrows values
+     * @param nresults The number of results (columns in outputs)
+     * @param nrows The number of rows, i.e. calls to fn
+     * @return true if every row completed, false if a row ran out of memory, in which case the
+     *         outputs of the rows before it have been written, and the rest are left as they were
      */
-    void call(size_t nargs = 0, int nreturn = 0);
+    bool call_batch(const lua_value &fn, const lua_value *const *inputs, size_t nargs, lua_value *const *outputs, size_t nresults, size_t nrows);
 
     /**
      * Gets an argument given to a native function.
@@ -117,7 +205,7 @@ namespace engine {
      * 
      * @return The value at the top of the stack.
      */
-    lua_value &pop();
+    lua_value pop();
 
     /**
      * Pop a number of arguments from the stack, disregarding their value, primarily
@@ -140,6 +228,15 @@ namespace engine {
      */
     object_view alloc_native_function(lua_native_closure::func_t f);
 
+    /**
+     * Allocate a native function from a function pointer. This is cheaper to store and call
+     * than a std::function.
+     * 
+     * @param f The native function
+     * @param ctx The context of the function, which is passed to it on each call
+     */
+    object_view alloc_native_function(lua_native_closure::ptr_t f, void *ctx = nullptr);
+
     /**
      * Define a native function, placed into the global env. This is a shortcut
      * for env().set(key, alloc_native_function(f)).
@@ -152,28 +249,303 @@ namespace engine {
     inline void define_native_function(const char *key, lua_native_closure::func_t f) {
       define_native_function(lua_string{key}, f);
     }
+
+    void define_native_function(const lua_value &key, lua_native_closure::ptr_t f, void *ctx = nullptr);
+
+    inline void define_native_function(const char *key, lua_native_closure::ptr_t f, void *ctx = nullptr) {
+      define_native_function(lua_string{key}, f, ctx);
+    }
+
+    /**
+     * Allocate a typed array (see lua_array) that owns its buffer, with all elements set to 0.
+     * @param type The type of the elements
+     * @param length The number of elements
+     */
+    object_view alloc_array(lua_array::element_type type, size_t length);
+
+    /**
+     * Allocate a typed array over a buffer of the host, without copying it. Scripts read and
+     * write the buffer directly, so it must outlive the array.
+     * @param data The buffer
+     * @param length The number of elements in the buffer
+     */
+    object_view alloc_array(double *data, size_t length);
+    object_view alloc_array(int32_t *data, size_t length);
+    object_view alloc_array(uint8_t *data, size_t length);
+
+    /**
+     * Allocate a fast native function (see lua_fast_native), which is called without a call
+     * frame. This suits small functions with at most one result.
+     */
+    object_view alloc_fast_native_function(lua_fast_native f);
+
+    /**
+     * Allocate an intrinsic native function (see lua_intrinsic). Calls from Lua with at most
+     * two arguments and a single result are run inline, for as long as the called value is
+     * still an intrinsic. Other calls are regular native calls.
+     */
+    object_view alloc_intrinsic(lua_intrinsic f);
+
+    /**
+     * Define an intrinsic native function, placed into the global env. This is a shortcut for
+     * env().set(key, alloc_intrinsic(f)).
+     */
+    void define_intrinsic(const lua_value &key, lua_intrinsic f);
+
+    /**
+     * Allocate an iterator native function (see lua_iterator). Generic for loops over the
+     * iterator call it in place, without a call frame. Other calls are regular native calls,
+     * which return the next key and value, or nil at the end of the iteration.
+     */
+    object_view alloc_iterator(lua_iterator f);
+
+    /**
+     * Perform a step of the cycle collector, which frees objects and upvals that are only
+     * kept alive by reference cycles (see gc_state).
+     * 
+     * A step performs roughly `budget` units of work, where a unit is a visit of an object
+     * or upval, or one of its references. The final sweep of a cycle only visits the objects
+     * that are to be freed, and is always completed in a single step.
+     * 
+     * @param budget The amount of work to perform in this step.
+     * @return true if a collection cycle was completed in this step.
+     */
+    bool collect_step(size_t budget);
+
+    /**
+     * Run a full cycle of the cycle collector. If a cycle is already in progress, it is
+     * completed before the full cycle is run.
+     */
+    void collect();
+
+    /**
+     * Set the amount of work the cycle collector performs for each allocation of an object
+     * or upval. See collect_step(). The default budget is 0, which disables automatic
+     * collection, in which case the collector will only run through collect_step() or collect().
+     * 
+     * @param budget The amount of work to perform for each allocation.
+     */
+    void set_gc_budget(size_t budget) {
+      _gc.budget = budget;
+    }
+
+    /**
+     * Get the statistics of the cycle collector, such as the number of objects collected.
+     */
+    const gc_stats &collector_stats() const {
+      return _gc.stats;
+    }
+
+    /**
+     * Limit the heap memory of the VM. Heap buffers allocated while the VM runs (in call(), load(),
+     * push() and the alloc_ and define_ functions) are charged to the VM until they are freed,
+     * including the buffers of tables, strings, typed arrays and the VM's own pools and stacks.
+     * Memory held inline by the VM, and the collector's own bookkeeping, are not counted.
+     * 
+     * An allocation that would exceed the limit throws lua_memory_error, after the VM has
+     * collected cycles to make room. call() catches it, and returns false. The check is a
+     * comparison for each heap allocation, so the limit can be left on in production.
+     * 
+     * @param limit The most bytes the VM may hold on the heap, or 0 (the default) for no limit.
+     */
+    void set_memory_limit(size_t limit) {
+      _memory->limit = limit > 0 ? limit : SIZE_MAX;
+    }
+
+    /**
+     * Get the heap memory charged to the VM (see set_memory_limit()), now and at its peak.
+     */
+    const memory_budget &memory_stats() const {
+      return *_memory;
+    }
+
+    /**
+     * Take a snapshot of the heap of the VM: its live objects by kind, upvals, register stack,
+     * and the bytes of its spilled containers, strings and prototypes (see heap_stats).
+     * 
+     * The snapshot walks the object and upval pools and the entries of each table, without
+     * allocating, so its cost is linear in the size of the heap. The VM isn't synchronized, so a
+     * metrics thread should take snapshots while the VM is idle (e.g. between calls).
+     */
+    heap_stats inspect_heap() const;
+
+    /**
+     * Attach a sampling profiler to the VM, or detach it with nullptr (see lua_profiler). The
+     * profiler must outlive its use by the VM. While no sample is pending, the cost is a test
+     * at each call and loop iteration.
+     */
+    void set_profiler(lua_profiler *profiler) {
+      _profiler = profiler;
+    }
+
+#ifdef QUOKKA_OPCODE_STATS
+    /**
+     * Get the statistics of the instructions run by the VM, by opcode (see opcode_stats).
+     */
+    const opcode_stats &instruction_stats() const {
+      return _opstats;
+    }
+
+    /**
+     * Reset the instruction statistics of the VM, and of the prototypes of the chunks loaded
+     * into it.
+     */
+    void reset_instruction_stats();
+
+    /**
+     * Write a report of the instruction statistics: the opcodes run, most frequent first, and
+     * the instructions run in each prototype of the chunks loaded into the VM.
+     */
+    void write_instruction_report(std::ostream &out) const;
+#endif
+
+    /**
+     * Enable or disable deferred reference counting for objects allocated from now on.
+     * 
+     * By default, every write of an object into a register uses the object, and every
+     * overwrite of a register unuses the object it held. With deferred reference counting,
+     * registers borrow objects instead, and objects that run out of uses are kept as
+     * pending until the next reconcile(), which frees any pending object that is no longer
+     * held by a register. This removes the refcount traffic of moving objects between
+     * registers and tables in tight loops, at the expense of freeing objects later.
+     * 
+     * The VM reconciles when a call from the host returns, and when the object pool would
+     * otherwise have to grow.
+     * 
+     * @param deferred true to enable deferred reference counting.
+     */
+    void set_deferred_refcount(bool deferred) {
+      _deferred_refcount = deferred;
+    }
+
+    /**
+     * Free pending objects (see set_deferred_refcount()) that are no longer held by a register.
+     * @return The number of objects freed.
+     */
+    size_t reconcile();
     
    private:
+    // Instructions run by compiled code, see ops.h
+    friend struct vm_ops;
     using call_ref = small_vector_view<lua_call>;
-    using reg_ref = small_vector_view<lua_value>;
 
     // Return true if C function
     bool precall(size_t func_stack_idx, int nreturn);
     void execute();
     // Return false if multi results (variable number)
     bool postcall(size_t first_result_idx, int nreturn);
+    // Abandon a call that raised an error, popping its frames, function and arguments
+    void unwind(size_t func_stack_idx, size_t num_frames);
+    // Record the call frames as a sample of the profiler
+    void sample_stack();
 
+    // Open upvals, referring to a stack level (register index). These are kept sorted
+    // by level, so closing and finding upvals only visits those above the level.
+    struct open_upval {
+      size_t level;
+      size_t idx;
+    };
+    bool is_open_upval(const open_upval &ou) const;
     void close_upvals(size_t level);
+    // Find the open upval for a stack level, or open a new one
+    upval_view find_upval(size_t level);
+
+    // Call a fast native in a register, writing its result in place of the function as
+    // postcall() does.
+    void call_fast_native(lua_fast_native f, size_t func_idx, size_t nargs, int nreturn);
+
+    // Push the call frame of a Lua closure with fixed parameters in a register, with its nargs
+    // arguments on top of the stack. Return false if the value isn't such a closure.
+    bool call_lua(size_t func_idx, unsigned int nargs, int nreturn);
+
+    // Call the value in a register inline if it is an intrinsic, writing the result in its place.
+    // Return false if the value isn't an intrinsic.
+    bool call_intrinsic(size_t func_idx, unsigned int nargs);
+
+    // Run the call of a generic for loop (OP_TFORCALL) inline if the loop's function is an
+    // iterator. Return false if it isn't an iterator.
+    bool call_iterator(size_t ra, unsigned int nresults);
+
+    // Metamethods, see metatables.cpp. These are the slow paths of instructions, taken for tables
+    // with a metatable (that may have the metamethod), and for operands of the wrong type.
+    // Results are written to a register. Without a metamethod, an instruction does what it does
+    // on a table without a metatable, or nothing.
+
+    // Call a metamethod with two or three arguments above the current frame, returning its
+    // first result
+    lua_value call_metamethod(const lua_value &f, const lua_value &a, const lua_value &b, const lua_value *c = nullptr);
+    // t[k] for a table t that has no value for k, following __index
+    void index_meta(lua_value t, const lua_value &k, size_t result_idx, inline_cache *ic = nullptr);
+    // t[k] = v for a table t, following __newindex if t has no value for k
+    void newindex_meta(lua_value t, const lua_value &k, const lua_value &v, inline_cache *ic = nullptr);
+    void arith_meta(lua_metamethod e, const lua_value &a, const lua_value &b, size_t result_idx);
+    bool compare_meta(lua_metamethod e, const lua_value &a, const lua_value &b);
+    // R(ra) = R(first) .. ... .. R(last), if any of them is an object. Return false otherwise.
+    bool concat_meta(size_t ra, size_t first, size_t last);
+    // Replace a table being called with its __call metamethod, shifting the arguments up to pass
+    // the table first. Return false if the value has no __call.
+    bool call_meta(size_t func_idx);
+
+    // Write a value to a register. Deferred objects are borrowed, rather than used.
+    void set_register(size_t idx, const lua_value &v);
+    // Write the value of a table entry to a register without copying it (nil if there is no entry)
+    void set_register_get(size_t idx, const lua_table &t, const lua_value &k);
+    // Write the value of a table entry that has been found to a register (nil if v is nullptr)
+    void set_register_get(size_t idx, const lua_value *v);
+
+    // Cycle collector phases, see gc.cpp
+    size_t gc_count(size_t budget);
+    size_t gc_scan(size_t budget);
+    size_t gc_mark(size_t budget);
+    size_t gc_select(size_t budget);
+    size_t gc_sweep();
+
+    // Allocate an object, trying the slots of the hints first (e.g. the slots of freed closures)
+    object_view alloc_object(const size_t *hints, size_t num_hints);
+
+    // Closures made by OP_CLOSURE (see closure_pool). lclosure_cache() finds a closure of the
+    // prototype that captures the same upvals, or returns an invalid view.
     object_view lclosure_cache(bytecode_prototype &proto, size_t func_base, object_view parent_cl);
     object_view lclosure_new(bytecode_prototype &proto, size_t func_base, object_view parent_cl);
+    bool lclosure_matches(const lua_object &o, const bytecode_prototype &proto, size_t func_base, const lua_closure &parent) const;
+
+    // Memory charged to the VM (see set_memory_limit()). This is destroyed last, after the
+    // buffers of the VM, and outlives it while buffers that escaped it are still charged to it.
+    std::unique_ptr<memory_budget, memory_budget::release> _memory{new memory_budget()};
 
-    small_vector<lua_value, 48> _registers;
-    small_vector<lua_call, 16> _callinfo;
+    // Register stack. This is segmented, so that growing the stack (e.g. for a deep
+    // recursion) never moves the values of the frames below.
+    segmented_stack<lua_value, engine_traits::register_segment> _registers;
+    small_vector<lua_call, engine_traits::call_inline, engine_grow(engine_traits::call_inline)> _callinfo;
     // Upval storage - used for variables that transcend the normal scope. 
     // e.g. local variables in ownership by an anonymous function
-    small_vector<lua_upval, 2, 4> _upvals;
+    small_vector<lua_upval, engine_traits::upval_inline, engine_grow(engine_traits::upval_grow)> _upvals;
+    // Indices of the open upvals in _upvals, sorted by level (highest last)
+    small_vector<open_upval, 8> _open_upvals;
+    // Root of the shapes of tables created by Lua (see lua_shape). This outlives _objects.
+    lua_shape _shapes;
     // Store for objects
-    small_vector<lua_object, 8> _objects;
+    small_vector<lua_object, engine_traits::object_inline, engine_grow(engine_traits::object_inline)> _objects;
+    // Closures of constant prototypes (see closure_pool::constant), held for the life of the VM
+    small_vector<object_view, 8> _constant_closures;
+    // Root prototypes of the chunks loaded into the VM, for inspect_heap()
+    small_vector<bytecode_prototype *, 2> _chunks;
+
+    // Start of the arena in the object and upval pools, used by call_scoped().
+    // Free slots below these marks are not reused while a scoped call is active.
+    size_t _object_arena = 0;
+    size_t _upval_arena = 0;
+
+    // Cycle collector
+    gc_state _gc;
+
+    // Deferred reference counting, see set_deferred_refcount()
+    bool _deferred_refcount = false;
+    // Size of the object pool at which the next reconcile occurs when allocating
+    size_t _reconcile_threshold = 0;
+
+    // Sampling profiler, see set_profiler()
+    lua_profiler *_profiler = nullptr;
 
     /**
      * In Lua, all loaded files have a single upvalue - the _ENV (environment).
@@ -199,6 +571,29 @@ namespace engine {
     call_ref _ci_ref;
     object_view _cl_ref;
     size_t _base;
+
+#ifdef QUOKKA_OPCODE_STATS
+    opcode_stats _opstats;
+#endif
+#ifdef QUOKKA_OPCODE_CYCLES
+    // The opcode of the last instruction (or NUM_OPCODES for compiled code), the prototype it
+    // ran in (nullptr if the cycles since aren't charged), and the cycle count when it started
+    size_t _op_last = 0;
+    bytecode_prototype *_op_last_proto = nullptr;
+    uint64_t _op_last_clock = 0;
+
+    // Charge the cycles since the last instruction to it
+    void charge_cycles(uint64_t now) {
+      if (_op_last_proto == nullptr)
+        return;
+      uint64_t cycles = now - _op_last_clock;
+      if (_op_last < opcode_util::NUM_OPCODES)
+        _opstats.cycles[_op_last] += cycles;
+      else
+        _opstats.compiled_cycles += cycles;
+      _op_last_proto->stats.cycles += cycles;
+    }
+#endif
   };
 }
 }
\ No newline at end of file
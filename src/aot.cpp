@@ -0,0 +1,264 @@
+#include "quokka/engine/aot.h"
+#include "quokka/engine/bytecode.h"
+#include "quokka/engine/opcodes.h"
+
+#include <math.h>
+#include <stdio.h>
+
+using namespace quokka::engine;
+
+// Prototypes of a chunk in depth-first order, the order in which they are compiled and attached
+template <typename VT>
+static void collect_protos(bytecode_prototype &proto, VT &out) {
+  out.emplace_back(&proto);
+  for (int i = 0; i < proto.num_protos; i++)
+    collect_protos(*proto.protos[i], out);
+}
+
+uint32_t quokka::engine::aot_checksum(const bytecode_prototype &proto) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < proto.num_instructions; i++) {
+    // Quickened instructions are hashed as they are in bytecode, so that code can be attached
+    // to a chunk that has already run
+    lua_instruction inst = opcode_util::unquicken(proto.instructions[i]);
+    for (size_t b = 0; b < sizeof(lua_instruction); b++) {
+      hash ^= (inst >> (b * 8)) & 0xFF;
+      hash *= 16777619u;
+    }
+  }
+  return hash;
+}
+
+#ifdef QUOKKA_AOT
+bool quokka::engine::aot_attach(bytecode_chunk &chunk, const aot_function *functions, const uint32_t *checksums, size_t count) {
+  small_vector<bytecode_prototype *, 16> protos;
+  collect_protos(chunk.root_func, protos);
+  if (protos.size() != count)
+    return false;
+  for (size_t i = 0; i < count; i++)
+    if (aot_checksum(*protos[i]) != checksums[i])
+      return false;
+  for (size_t i = 0; i < count; i++)
+    protos[i]->aot = functions[i];
+  return true;
+}
+#endif
+
+/* COMPILER */
+
+#ifdef WITH_AOT_COMPILER
+aot_compiler::aot_compiler(std::ostream &stream, const char *name) : _stream(stream), _name(name) {}
+
+void aot_compiler::write_chunk(bytecode_chunk &chunk) {
+  _protos.clear();
+  collect_protos(chunk.root_func, _protos);
+
+  _stream << "// Generated by the Quokka AOT compiler (aot_compiler). Do not edit.\n"
+          << "// Compile with QUOKKA_AOT defined, and attach to the chunk with " << _name << "_attach().\n"
+          << "#include \"quokka/engine/ops.h\"\n"
+          << "#include \"quokka/engine/aot.h\"\n\n"
+          << "using namespace quokka::engine;\n\n"
+          << "namespace {\n";
+  for (size_t i = 0; i < _protos.size(); i++)
+    write_function(*_protos[i], i);
+  _stream << "}  // namespace\n\n";
+
+  _stream << "bool " << _name << "_attach(bytecode_chunk &chunk) {\n"
+          << "  static const aot_function functions[] = {\n";
+  for (size_t i = 0; i < _protos.size(); i++)
+    _stream << "    " << _name << "_proto_" << i << ",\n";
+  _stream << "  };\n"
+          << "  static const uint32_t checksums[] = {\n";
+  for (size_t i = 0; i < _protos.size(); i++)
+    _stream << "    " << aot_checksum(*_protos[i]) << "u,\n";
+  _stream << "  };\n"
+          << "  return aot_attach(chunk, functions, checksums, " << _protos.size() << ");\n"
+          << "}\n";
+}
+
+void aot_compiler::write_function(bytecode_prototype &proto, size_t id) {
+  int n = proto.num_instructions;
+  _stream << "\n"
+          << "size_t " << _name << "_proto_" << id << "(quokka_vm &vm, size_t pc) {\n"
+          << "  bytecode_prototype &proto = vm_ops::proto(vm);\n"
+          << "  (void)proto;\n"
+          << "  switch (pc) {\n";
+  for (int i = 0; i < n; i++)
+    _stream << "    case " << i << ": goto L" << i << ";\n";
+  _stream << "    default: return pc;\n"
+          << "  }\n";
+  for (int i = 0; i < n; i++)
+    write_instruction(proto, i);
+  // The last instruction of a prototype is always a return, which exits above
+  _stream << "  return " << (n - 1) << ";\n"
+          << "}\n";
+}
+
+void aot_compiler::write_instruction(bytecode_prototype &proto, size_t pc) {
+  lua_instruction i = opcode_util::unquicken(proto.instructions[pc]);
+  opcode op = opcode_util::get_opcode(i);
+  unsigned int a = opcode_util::get_A(i), b = opcode_util::get_B(i), c = opcode_util::get_C(i);
+  int n = proto.num_instructions;
+
+  _stream << " L" << pc << ":  // " << opcode_util::name(op) << "\n";
+
+  // Jump to an instruction, or exit to the interpreter if the target is out of the prototype
+  auto jump = [&](int64_t target) {
+    if (target < 0 || target >= n)
+      _stream << "return " << pc << ";\n";
+    else
+      _stream << "goto L" << target << ";\n";
+  };
+  // The (decoded) register of an operand
+  auto reg = [](unsigned int v) { return (unsigned int)opcode_util::val(v); };
+  // The inline cache argument of a table access, if its key is a constant (see inline_cache)
+  auto cache = [&](unsigned int key) {
+    if (opcode_util::is_const(key))
+      _stream << ", proto.cache(" << pc << ")";
+  };
+
+  switch (op) {
+    case opcode::OP_MOVE:
+      _stream << "  vm_ops::move(vm, " << a << ", " << reg(b) << ");\n";
+      break;
+    case opcode::OP_LOADK:
+      _stream << "  vm_ops::loadk(vm, " << a << ", ";
+      write_constant(proto, opcode_util::get_Bx(i));
+      _stream << ");\n";
+      break;
+    case opcode::OP_LOADBOOL:
+      _stream << "  vm_ops::loadbool(vm, " << a << ", " << (b > 0 ? "true" : "false") << ");\n";
+      if (c > 0) {
+        _stream << "  ";
+        jump(pc + 2);
+      }
+      break;
+    case opcode::OP_LOADNIL:
+      _stream << "  vm_ops::loadnil(vm, " << a << ", " << b << ");\n";
+      break;
+    case opcode::OP_GETUPVAL:
+      _stream << "  vm_ops::getupval(vm, " << a << ", " << b << ");\n";
+      break;
+    case opcode::OP_GETTABUP:
+      _stream << "  vm_ops::gettabup(vm, " << a << ", " << b << ", ";
+      write_rk(proto, c);
+      cache(c);
+      _stream << ");\n";
+      break;
+    case opcode::OP_GETTABLE:
+      _stream << "  vm_ops::gettable(vm, " << a << ", " << reg(b) << ", ";
+      write_rk(proto, c);
+      cache(c);
+      _stream << ");\n";
+      break;
+    case opcode::OP_SETTABUP:
+    case opcode::OP_SETTABLE:
+      _stream << "  vm_ops::" << (op == opcode::OP_SETTABUP ? "settabup" : "settable") << "(vm, " << a << ", ";
+      write_rk(proto, b);
+      _stream << ", ";
+      write_rk(proto, c);
+      cache(b);
+      _stream << ");\n";
+      break;
+    case opcode::OP_SETUPVAL:
+      _stream << "  vm_ops::setupval(vm, " << a << ", " << b << ");\n";
+      break;
+    case opcode::OP_NEWTABLE:
+      _stream << "  vm_ops::newtable(vm, " << a << ", " << b << ", " << c << ");\n";
+      break;
+    case opcode::OP_SELF:
+      _stream << "  vm_ops::self(vm, " << a << ", " << reg(b) << ", ";
+      write_rk(proto, c);
+      cache(c);
+      _stream << ");\n";
+      break;
+    case opcode::OP_ADD: case opcode::OP_SUB: case opcode::OP_MUL: case opcode::OP_MOD:
+    case opcode::OP_IDIV: case opcode::OP_BAND: case opcode::OP_BOR: case opcode::OP_BXOR:
+    case opcode::OP_SHL: case opcode::OP_SHR: {
+      const char *name;
+      switch (op) {
+        case opcode::OP_ADD: name = "op_add"; break;
+        case opcode::OP_SUB: name = "op_sub"; break;
+        case opcode::OP_MUL: name = "op_mul"; break;
+        case opcode::OP_MOD: name = "op_mod"; break;
+        case opcode::OP_IDIV: name = "op_idiv"; break;
+        case opcode::OP_BAND: name = "op_band"; break;
+        case opcode::OP_BOR: name = "op_bor"; break;
+        case opcode::OP_BXOR: name = "op_bxor"; break;
+        case opcode::OP_SHL: name = "op_shl"; break;
+        default: name = "op_shr"; break;
+      }
+      _stream << "  vm_ops::arith<" << name << ">(vm, " << a << ", ";
+      write_rk(proto, b);
+      _stream << ", ";
+      write_rk(proto, c);
+      _stream << ");\n";
+      break;
+    }
+    case opcode::OP_UNM:
+      _stream << "  vm_ops::unm(vm, " << a << ", " << reg(b) << ");\n";
+      break;
+    case opcode::OP_BNOT:
+      _stream << "  vm_ops::bnot(vm, " << a << ", " << reg(b) << ");\n";
+      break;
+    case opcode::OP_NOT:
+      _stream << "  vm_ops::op_not(vm, " << a << ", " << reg(b) << ");\n";
+      break;
+    case opcode::OP_JMP:
+      if (a != 0)
+        _stream << "  vm_ops::close(vm, " << a << ");\n";
+      _stream << "  ";
+      jump(pc + 1 + opcode_util::get_sBx(i));
+      break;
+    case opcode::OP_EQ: case opcode::OP_LT: case opcode::OP_LE:
+      _stream << "  if (vm_ops::" << (op == opcode::OP_EQ ? "eq" : op == opcode::OP_LT ? "lt" : "le") << "(vm, ";
+      write_rk(proto, b);
+      _stream << ", ";
+      write_rk(proto, c);
+      _stream << ") != " << (a != 0 ? "true" : "false") << ") ";
+      jump(pc + 2);
+      break;
+    case opcode::OP_TEST:
+      _stream << "  if (vm_ops::test(vm, " << a << ", " << (c > 0 ? "true" : "false") << ")) ";
+      jump(pc + 2);
+      break;
+    case opcode::OP_TESTSET:
+      _stream << "  if (vm_ops::testset(vm, " << a << ", " << reg(b) << ", " << (c > 0 ? "true" : "false") << ")) ";
+      jump(pc + 2);
+      break;
+    case opcode::OP_FORLOOP:
+    case opcode::OP_TFORLOOP:
+      _stream << "  if (vm_ops::" << (op == opcode::OP_FORLOOP ? "forloop" : "tforloop") << "(vm, " << a << ")) ";
+      jump(pc + 1 + opcode_util::get_sBx(i));
+      break;
+    default:
+      // Left to the interpreter: calls, returns, closures, varargs, etc.
+      _stream << "  return " << pc << ";\n";
+      break;
+  }
+}
+
+void aot_compiler::write_rk(bytecode_prototype &proto, unsigned int v) {
+  if (opcode_util::is_const(v))
+    write_constant(proto, opcode_util::val(v));
+  else
+    _stream << "vm_ops::R(vm, " << (unsigned int)opcode_util::val(v) << ")";
+}
+
+void aot_compiler::write_constant(bytecode_prototype &proto, size_t idx) {
+  const lua_value &k = proto.constants[idx];
+  // Numbers are written as literals, so that the C++ compiler can specialise on them
+  if (is<lua_integer>(k)) {
+    _stream << "lua_value((lua_integer)" << (long long)std::get<lua_integer>(k) << ")";
+  } else if (is<lua_number>(k) && isfinite(std::get<lua_number>(k))) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%a", (double)std::get<lua_number>(k));
+    _stream << "lua_value((lua_number)" << buf << ")";
+  } else if (is<bool>(k)) {
+    _stream << "lua_value(" << (std::get<bool>(k) ? "true" : "false") << ")";
+  } else {
+    _stream << "proto.constants[" << idx << "]";
+  }
+}
+#endif
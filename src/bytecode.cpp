@@ -1,4 +1,5 @@
 #include "quokka/engine/bytecode.h"
+#include "quokka/engine/opcodes.h"
 
 using namespace quokka::engine;
 
@@ -134,8 +135,11 @@ void bytecode_reader::read_header(bytecode_header &data) {
   data.lnumber = read_lua_number(data.arch);
 }
 
-void bytecode_reader::read_function(bytecode_architecture arch, bytecode_prototype &func) {
+void bytecode_reader::read_function(bytecode_architecture arch, bytecode_prototype &func, const bytecode_prototype *parent) {
   read_lua_string(*this, arch, func.source);
+  // As in lundump.c, functions without a source share the source of the function they're defined in
+  if (func.source.length() == 0 && parent != nullptr)
+    func.source = parent->source;
   func.line_defined = read_native_int(arch);
   func.last_line_defined = read_native_int(arch);
   func.num_params = read_byte();
@@ -175,18 +179,24 @@ void bytecode_reader::read_function(bytecode_architecture arch, bytecode_prototy
   func.num_protos = read_native_int(arch);
   for (int i = 0; i < func.num_protos; i++) {
     bytecode_prototype *f = new bytecode_prototype();
-    read_function(arch, *f);
+    read_function(arch, *f, &func);
     func.protos.emplace_back(f);
   }
 
   /* Read debugging information */
-  /* We ignore the debugging info, but we have to advance the 
-     stream anyway */
+  /* We ignore the debugging info (except for the line info, if asked to
+     keep it), but we have to advance the stream anyway */
 
   small_string<32> tmp_vec;
   int num_opcode_map = read_native_int(arch);
-  for (int i = 0; i < num_opcode_map; i++)
-    read_native_int(arch);
+  bool keep_lines = _line_info && num_opcode_map == func.num_instructions && num_opcode_map > 0;
+  if (keep_lines)
+    func.line_info.reset(new int[num_opcode_map]);
+  for (int i = 0; i < num_opcode_map; i++) {
+    int line = read_native_int(arch);
+    if (keep_lines)
+      func.line_info[i] = line;
+  }
 
   int num_locvar_map = read_native_int(arch);
   for (int i = 0; i < num_locvar_map; i++) {
@@ -312,8 +322,12 @@ void bytecode_writer::write_header(bytecode_header &header) {
   write_lua_number(header.lnumber);
 }
 
-void bytecode_writer::write_function(bytecode_prototype &func) {
-  write_lua_string(*this, func.source);
+void bytecode_writer::write_function(bytecode_prototype &func, const bytecode_prototype *parent) {
+  // As in ldump.c, the source is only written if it differs from the function it's defined in
+  if (parent != nullptr && func.source.length() > 0 && func.source == parent->source)
+    write_byte(0);
+  else
+    write_lua_string(*this, func.source);
 
   write_native_int(func.line_defined);
   write_native_int(func.last_line_defined);
@@ -324,7 +338,7 @@ void bytecode_writer::write_function(bytecode_prototype &func) {
   // Instructions
   write_native_int(func.num_instructions);
   for (int i = 0; i < func.num_instructions; i++)
-    write_lua_instruction(func.instructions[i]);
+    write_lua_instruction(opcode_util::unquicken(func.instructions[i]));
 
   // Constants
   write_native_int(func.num_constants);
@@ -358,7 +372,7 @@ void bytecode_writer::write_function(bytecode_prototype &func) {
   // Protos
   write_native_int(func.num_protos);
   for (int i = 0; i < func.num_protos; i++) {
-    write_function(*func.protos[i]);
+    write_function(*func.protos[i], &func);
   }
 
   // Debugging (shims, to make luac happy)
@@ -0,0 +1,319 @@
+#include "quokka/engine/vm.h"
+
+#include <limits>
+
+using namespace quokka::engine;
+
+using gc_phase = gc_state::gc_phase;
+
+namespace {
+  /**
+   * The object and upval pools, viewed as one graph of nodes for the cycle collector.
+   * Objects are numbered first, followed by upvals (upval i is node num_objects + i).
+   */
+  struct gc_graph {
+    small_vector_base<lua_object> &objects;
+    small_vector_base<lua_upval> &upvals;
+    size_t num_objects;
+    size_t num_upvals;
+
+    size_t size() const { return num_objects + num_upvals; }
+
+    bool is_assigned(size_t node) const {
+      return node < num_objects ? objects[node].is_assigned() : upvals[node - num_objects].is_assigned();
+    }
+
+    int uses(size_t node) const {
+      return node < num_objects ? objects[node].uses() : upvals[node - num_objects].uses();
+    }
+
+    void use(size_t node) {
+      if (node < num_objects) objects[node].use();
+      else upvals[node - num_objects].use();
+    }
+
+    void unuse(size_t node) {
+      if (node < num_objects) objects[node].unuse();
+      else upvals[node - num_objects].unuse();
+    }
+
+    // Drop all references held by the node, without freeing the node itself
+    void clear(size_t node) {
+      if (node < num_objects) unassign(objects[node]);
+      else unassign(upvals[node - num_objects]);
+    }
+
+    /**
+     * Call f(target) for every node referenced by a node.
+     * @return The number of references visited.
+     */
+    template <typename F>
+    size_t each_reference(size_t node, F &&f) const {
+      size_t n = 0;
+      auto value = [&](const lua_value &v) {
+        if (is<object_view>(v)) {
+          const object_view &o = std::get<object_view>(v);
+          if (o.is_valid() && o.index() < num_objects)
+            f(o.index());
+          n++;
+        }
+      };
+
+      if (node < num_objects) {
+        lua_object &o = objects[node];
+        if (is<lua_table>(o)) {
+          lua_table &t = std::get<lua_table>(o);
+          for (size_t i = 0; i < t.entries.size(); i++) {
+            value(t.entries[i].key);
+            value(t.entries[i].value);
+          }
+          value(t.metatable);
+        } else if (is<lua_closure>(o)) {
+          lua_closure &cl = std::get<lua_closure>(o);
+          for (size_t i = 0; i < cl.upval_views.size(); i++) {
+            const upval_view &uv = cl.upval_views[i];
+            if (uv.is_valid() && uv.index() < num_upvals)
+              f(num_objects + uv.index());
+            n++;
+          }
+        }
+        // Native closures are opaque. Anything they capture is seen as an outside reference.
+      } else {
+        lua_upval &uv = upvals[node - num_objects];
+        if (is<lua_value>(uv))
+          value(std::get<lua_value>(uv));
+      }
+      return n;
+    }
+  };
+}
+
+bool quokka_vm::collect_step(size_t budget) {
+  // The collector's bookkeeping isn't charged to the VM, so that it can always run to free memory
+  memory::scope mem(nullptr);
+  size_t work = 0;
+  while (work < budget) {
+    switch (_gc.phase) {
+      case gc_phase::IDLE:
+        _gc.num_objects = _objects.size();
+        _gc.num_upvals = _upvals.size();
+        _gc.refs.clear();
+        _gc.marks.clear();
+        _gc.worklist.clear();
+        _gc.candidates.clear();
+        _gc.refs.reserve(_gc.num_objects + _gc.num_upvals);
+        _gc.marks.reserve(_gc.num_objects + _gc.num_upvals);
+        _gc.cursor = 0;
+        _gc.phase = gc_phase::COUNT;
+        break;
+      case gc_phase::COUNT:
+        work += gc_count(budget - work);
+        break;
+      case gc_phase::SCAN:
+        work += gc_scan(budget - work);
+        break;
+      case gc_phase::MARK:
+        work += gc_mark(budget - work);
+        break;
+      case gc_phase::SELECT:
+        work += gc_select(budget - work);
+        break;
+      case gc_phase::SWEEP:
+        gc_sweep();
+        return true;
+    }
+  }
+  return false;
+}
+
+quokka_vm::~quokka_vm() {
+  // Objects reference each other by index into the pools, so release the registers (which
+  // outlive _objects) and the constant closures first, then clear every node while holding a use
+  // on it, as gc_sweep does for garbage cycles. Otherwise, destroying the pools in order would drop uses on objects
+  // that were already destroyed.
+  _registers.clear();
+  _constant_closures.clear();
+
+  gc_graph g{_objects, _upvals, _objects.size(), _upvals.size()};
+  for (size_t i = 0; i < g.size(); i++) {
+    if (g.is_assigned(i))
+      g.use(i);
+  }
+  for (size_t i = 0; i < g.size(); i++) {
+    if (g.is_assigned(i))
+      g.clear(i);
+  }
+}
+
+void quokka_vm::collect() {
+  if (_gc.phase != gc_phase::IDLE)
+    collect_step(std::numeric_limits<size_t>::max());
+  collect_step(std::numeric_limits<size_t>::max());
+}
+
+// Take a snapshot of the refcount of each node.
+size_t quokka_vm::gc_count(size_t budget) {
+  gc_graph g{_objects, _upvals, _gc.num_objects, _gc.num_upvals};
+  size_t work = 0;
+  for (; _gc.cursor < g.size() && work < budget; _gc.cursor++, work++) {
+    _gc.refs.emplace(_gc.cursor, g.is_assigned(_gc.cursor) ? g.uses(_gc.cursor) : 0);
+    _gc.marks.emplace(_gc.cursor, gc_state::UNMARKED);
+  }
+
+  if (_gc.cursor == g.size()) {
+    _gc.cursor = 0;
+    _gc.phase = gc_phase::SCAN;
+  }
+  return work;
+}
+
+// Subtract the references held by nodes, leaving only the uses from outside of the pools.
+size_t quokka_vm::gc_scan(size_t budget) {
+  gc_graph g{_objects, _upvals, _gc.num_objects, _gc.num_upvals};
+  size_t work = 0;
+  for (; _gc.cursor < g.size() && work < budget; _gc.cursor++) {
+    work += 1 + g.each_reference(_gc.cursor, [&](size_t target) {
+      _gc.refs[target]--;
+    });
+  }
+
+  if (_gc.cursor == g.size()) {
+    _gc.cursor = 0;
+    _gc.phase = gc_phase::MARK;
+  }
+  return work;
+}
+
+// Mark everything reachable from nodes that are used from outside of the pools.
+size_t quokka_vm::gc_mark(size_t budget) {
+  gc_graph g{_objects, _upvals, _gc.num_objects, _gc.num_upvals};
+  size_t work = 0;
+  while (work < budget) {
+    if (_gc.worklist.size() > 0) {
+      size_t node = _gc.worklist.last();
+      _gc.worklist.chop(_gc.worklist.size() - 1);
+      work += 1 + g.each_reference(node, [&](size_t target) {
+        if (_gc.marks[target] != gc_state::LIVE) {
+          _gc.marks[target] = gc_state::LIVE;
+          _gc.worklist.emplace_back(target);
+        }
+      });
+    } else if (_gc.cursor < g.size()) {
+      size_t node = _gc.cursor++;
+      if (_gc.marks[node] != gc_state::LIVE && g.is_assigned(node) && _gc.refs[node] > 0) {
+        _gc.marks[node] = gc_state::LIVE;
+        _gc.worklist.emplace_back(node);
+      }
+      work++;
+    } else {
+      _gc.cursor = 0;
+      _gc.phase = gc_phase::SELECT;
+      break;
+    }
+  }
+  return work;
+}
+
+// Select the nodes that were not reached by marking as candidates for collection.
+size_t quokka_vm::gc_select(size_t budget) {
+  gc_graph g{_objects, _upvals, _gc.num_objects, _gc.num_upvals};
+  size_t work = 0;
+  for (; _gc.cursor < g.size() && work < budget; _gc.cursor++, work++) {
+    if (_gc.marks[_gc.cursor] != gc_state::LIVE && g.is_assigned(_gc.cursor)) {
+      _gc.marks[_gc.cursor] = gc_state::CANDIDATE;
+      _gc.candidates.emplace_back(_gc.cursor);
+    }
+  }
+
+  if (_gc.cursor == g.size()) {
+    _gc.cursor = 0;
+    _gc.phase = gc_phase::SWEEP;
+  }
+  return work;
+}
+
+// Verify and free the candidates. This must be done in a single step, as the VM could
+// otherwise change the references between the candidates.
+size_t quokka_vm::gc_sweep() {
+  gc_graph g{_objects, _upvals, _gc.num_objects, _gc.num_upvals};
+  size_t work = 0;
+
+  // Count the references to each candidate from the other candidates
+  for (size_t i = 0; i < _gc.candidates.size(); i++) {
+    size_t c = _gc.candidates[i];
+    if (!g.is_assigned(c))
+      _gc.marks[c] = gc_state::UNMARKED;  // Freed since it was selected
+    _gc.refs[c] = 0;
+  }
+  for (size_t i = 0; i < _gc.candidates.size(); i++) {
+    size_t c = _gc.candidates[i];
+    if (_gc.marks[c] == gc_state::CANDIDATE) {
+      work += 1 + g.each_reference(c, [&](size_t target) {
+        if (_gc.marks[target] == gc_state::CANDIDATE)
+          _gc.refs[target]++;
+      });
+    }
+  }
+
+  // Any candidate with uses that aren't accounted for by other candidates is referenced
+  // from elsewhere, so it is live along with everything it references. Deferred objects
+  // may also be borrowed by the registers without being used.
+  for (size_t i = 0; i < _registers.size(); i++) {
+    if (is<object_view>(_registers[i])) {
+      const object_view &o = object(_registers[i]);
+      if (o.is_valid() && o.index() < g.num_objects && _gc.marks[o.index()] == gc_state::CANDIDATE) {
+        _gc.marks[o.index()] = gc_state::LIVE;
+        _gc.worklist.emplace_back(o.index());
+      }
+    }
+  }
+  for (size_t i = 0; i < _gc.candidates.size(); i++) {
+    size_t c = _gc.candidates[i];
+    if (_gc.marks[c] == gc_state::CANDIDATE && g.uses(c) != _gc.refs[c]) {
+      _gc.marks[c] = gc_state::LIVE;
+      _gc.worklist.emplace_back(c);
+    }
+  }
+  while (_gc.worklist.size() > 0) {
+    size_t node = _gc.worklist.last();
+    _gc.worklist.chop(_gc.worklist.size() - 1);
+    work += 1 + g.each_reference(node, [&](size_t target) {
+      if (_gc.marks[target] == gc_state::CANDIDATE) {
+        _gc.marks[target] = gc_state::LIVE;
+        _gc.worklist.emplace_back(target);
+      }
+    });
+  }
+
+  // The remaining candidates are only referenced by each other. Hold a use on each of them
+  // while their references are dropped, so that they aren't freed halfway through.
+  for (size_t i = 0; i < _gc.candidates.size(); i++) {
+    if (_gc.marks[_gc.candidates[i]] == gc_state::CANDIDATE)
+      g.use(_gc.candidates[i]);
+  }
+  for (size_t i = 0; i < _gc.candidates.size(); i++) {
+    if (_gc.marks[_gc.candidates[i]] == gc_state::CANDIDATE)
+      g.clear(_gc.candidates[i]);
+  }
+
+  size_t objects = 0, upvals = 0;
+  for (size_t i = 0; i < _gc.candidates.size(); i++) {
+    size_t c = _gc.candidates[i];
+    if (_gc.marks[c] == gc_state::CANDIDATE) {
+      g.unuse(c);
+      if (c < g.num_objects && _objects[c].is_pending())
+        _objects[c].release();
+      if (!g.is_assigned(c))
+        (c < g.num_objects ? objects : upvals)++;
+    }
+  }
+
+  _gc.stats.cycles++;
+  _gc.stats.last_objects = objects;
+  _gc.stats.last_upvals = upvals;
+  _gc.stats.collected_objects += objects;
+  _gc.stats.collected_upvals += upvals;
+  _gc.candidates.clear();
+  _gc.phase = gc_phase::IDLE;
+  return work;
+}
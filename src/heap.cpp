@@ -0,0 +1,86 @@
+#include "quokka/engine/vm.h"
+
+using namespace quokka::engine;
+
+namespace {
+  void count_value(heap_stats &s, const lua_value &v) {
+    if (is<lua_string>(v)) {
+      const lua_string &str = std::get<lua_string>(v);
+      s.strings++;
+      s.string_bytes += str.length();
+      s.spill_bytes += str.heap_bytes();
+    }
+  }
+
+  // Prototypes are owned by their chunk, so they are counted once for each chunk loaded,
+  // however many closures the VM has made of them.
+  size_t prototype_bytes(const bytecode_prototype &p) {
+    size_t n = sizeof(bytecode_prototype) + p.source.heap_bytes() + p.instructions.heap_bytes()
+      + p.constants.heap_bytes() + p.upvalues.heap_bytes() + p.protos.heap_bytes();
+    for (size_t i = 0; i < p.constants.size(); i++) {
+      if (is<lua_string>(p.constants[i]))
+        n += std::get<lua_string>(p.constants[i]).heap_bytes();
+    }
+    if (p.line_info != nullptr)
+      n += p.instructions.size() * sizeof(int);
+    if (p.caches != nullptr)
+      n += (engine_traits::shapes ? p.instructions.size() : 1) * sizeof(inline_cache);
+    for (size_t i = 0; i < p.protos.size(); i++)
+      n += sizeof(std::shared_ptr<bytecode_prototype>) + prototype_bytes(*p.protos[i]);
+    return n;
+  }
+}  // namespace
+
+heap_stats quokka_vm::inspect_heap() const {
+  heap_stats s;
+
+  s.object_slots = _objects.size();
+  for (size_t i = 0; i < _objects.size(); i++) {
+    const lua_object &o = _objects[i];
+    if (!o.is_assigned())
+      continue;
+    if (is<lua_table>(o)) {
+      const lua_table &t = std::get<lua_table>(o);
+      s.tables++;
+      s.spill_bytes += t.entries.heap_bytes();
+      for (size_t j = 0; j < t.entries.size(); j++) {
+        count_value(s, t.entries[j].key);
+        count_value(s, t.entries[j].value);
+      }
+    } else if (is<lua_closure>(o)) {
+      s.closures++;
+      s.spill_bytes += std::get<lua_closure>(o).upval_views.heap_bytes();
+    } else if (is<lua_native_closure>(o)) {
+      s.natives++;
+    } else if (is<lua_array>(o)) {
+      s.arrays++;
+      s.array_bytes += std::get<lua_array>(o).owned_bytes();
+    }
+  }
+
+  for (size_t i = 0; i < _upvals.size(); i++) {
+    const lua_upval &uv = _upvals[i];
+    if (!uv.is_assigned())
+      continue;
+    s.upvals++;
+    if (is<size_t>(uv))
+      s.open_upvals++;
+    else if (is<lua_value>(uv))
+      count_value(s, std::get<lua_value>(uv));
+  }
+
+  s.registers = _registers.size();
+  s.register_high_water = _registers.high_water();
+  s.register_capacity = _registers.capacity();
+  for (size_t i = 0; i < _registers.size(); i++)
+    count_value(s, _registers[i]);
+  s.call_depth = _callinfo.size();
+
+  s.spill_bytes += _registers.heap_bytes() + _callinfo.heap_bytes() + _upvals.heap_bytes()
+    + _open_upvals.heap_bytes() + _objects.heap_bytes() + _constant_closures.heap_bytes()
+    + _chunks.heap_bytes();
+
+  for (size_t i = 0; i < _chunks.size(); i++)
+    s.prototype_bytes += prototype_bytes(*_chunks[i]);
+  return s;
+}
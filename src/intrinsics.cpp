@@ -0,0 +1,105 @@
+#include "quokka/engine/intrinsics.h"
+
+#include <limits>
+#include <math.h>
+
+using namespace quokka::engine;
+
+// Convert a float to an integer if it is representable as one, as math.floor and math.ceil do
+static lua_value float_to_value(lua_number n) {
+  if (n >= (lua_number)std::numeric_limits<lua_integer>::min() && n <= (lua_number)std::numeric_limits<lua_integer>::max())
+    return (lua_integer)n;
+  return n;
+}
+
+bool intrinsics::floor(const lua_value &x, const lua_value &, lua_value &result) {
+  if (is<lua_integer>(x))
+    result = x;
+  else if (is<lua_number>(x))
+    result = float_to_value(::floor(std::get<lua_number>(x)));
+  else
+    return false;
+  return true;
+}
+
+bool intrinsics::ceil(const lua_value &x, const lua_value &, lua_value &result) {
+  if (is<lua_integer>(x))
+    result = x;
+  else if (is<lua_number>(x))
+    result = float_to_value(::ceil(std::get<lua_number>(x)));
+  else
+    return false;
+  return true;
+}
+
+bool intrinsics::abs(const lua_value &x, const lua_value &, lua_value &result) {
+  if (is<lua_integer>(x)) {
+    lua_integer i = std::get<lua_integer>(x);
+    result = i < 0 ? -i : i;
+  } else if (is<lua_number>(x)) {
+    result = ::fabs(std::get<lua_number>(x));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool intrinsics::sqrt(const lua_value &x, const lua_value &, lua_value &result) {
+  lua_number n;
+  if (!tonumber(x, n))
+    return false;
+  result = ::sqrt(n);
+  return true;
+}
+
+bool intrinsics::min(const lua_value &x, const lua_value &y, lua_value &result) {
+  if (!is_numeric(x) || !is_numeric(y))
+    return false;
+  result = y < x ? y : x;
+  return true;
+}
+
+bool intrinsics::max(const lua_value &x, const lua_value &y, lua_value &result) {
+  if (!is_numeric(x) || !is_numeric(y))
+    return false;
+  result = x < y ? y : x;
+  return true;
+}
+
+bool intrinsics::len(const lua_value &s, const lua_value &, lua_value &result) {
+  if (!is<lua_string>(s))
+    return false;
+  result = (lua_integer)std::get<lua_string>(s).length();
+  return true;
+}
+
+// The table at env[key], creating it if there isn't one
+static object_view library(quokka_vm &vm, const char *key) {
+  lua_value lib = vm.env().get(key);
+  if (is<object_view>(lib) && is<lua_table>(*std::get<object_view>(lib)))
+    return std::get<object_view>(lib);
+  object_view o = vm.alloc_object();
+  o->emplace<lua_table>();
+  vm.env().set(key, o);
+  return o;
+}
+
+// Allocating an object may move the other objects of the VM, so the intrinsic is allocated
+// before the table is looked up.
+static void define(quokka_vm &vm, const object_view &lib, const char *key, lua_intrinsic f) {
+  object_view func = vm.alloc_intrinsic(f);
+  table(lib).set(key, func);
+}
+
+void intrinsics::define_all(quokka_vm &vm) {
+  object_view math = library(vm, "math");
+  define(vm, math, "floor", intrinsics::floor);
+  define(vm, math, "ceil", intrinsics::ceil);
+  define(vm, math, "abs", intrinsics::abs);
+  define(vm, math, "sqrt", intrinsics::sqrt);
+  define(vm, math, "min", intrinsics::min);
+  define(vm, math, "max", intrinsics::max);
+
+  object_view string = library(vm, "string");
+  define(vm, string, "len", intrinsics::len);
+}
@@ -0,0 +1,74 @@
+#include "quokka/engine/iterators.h"
+
+using namespace quokka::engine;
+
+bool iterators::next(const lua_value &t, lua_value &k, lua_value &v) {
+  if (is<object_view>(t)) {
+    const lua_object &o = *std::get<object_view>(t);
+    if (is<lua_table>(o)) {
+      const lua_table &tbl = std::get<lua_table>(o);
+      size_t i = tbl.next(k);
+      if (i < tbl.entries.size()) {
+        k = tbl.entries[i].key;
+        v = tbl.entries[i].value;
+        return true;
+      }
+    } else if (is<lua_array>(o)) {
+      // Arrays have no holes, so the keys are those of inext()
+      if (is<lua_nil>(k))
+        k = (lua_integer)0;
+      return inext(t, k, v);
+    }
+  }
+  k = lua_value();
+  return false;
+}
+
+bool iterators::inext(const lua_value &t, lua_value &i, lua_value &v) {
+  if (is<object_view>(t) && is<lua_integer>(i)) {
+    lua_integer next = std::get<lua_integer>(i) + 1;
+    const lua_object &o = *std::get<object_view>(t);
+    if (is<lua_table>(o)) {
+      const lua_value *found = std::get<lua_table>(o).find(next);
+      if (found != nullptr && !is<lua_nil>(*found)) {
+        i = next;
+        v = *found;
+        return true;
+      }
+    } else if (is<lua_array>(o)) {
+      v = std::get<lua_array>(o).get(next);
+      if (!is<lua_nil>(v)) {
+        i = next;
+        return true;
+      }
+    }
+  }
+  i = lua_value();
+  return false;
+}
+
+void iterators::define_all(quokka_vm &vm) {
+  // pairs() and ipairs() hold their iterator, so that they return it even if the global is
+  // reassigned. Each allocation may move the other objects, so they are set after allocating.
+  object_view next = vm.alloc_iterator(iterators::next);
+  object_view inext = vm.alloc_iterator(iterators::inext);
+
+  object_view pairs = vm.alloc_native_function([next](quokka_vm &v) {
+    lua_value t = v.num_arguments() > 0 ? v.argument(0) : lua_value();
+    v.push(next);
+    v.push(t);
+    v.push(lua_value());
+    return 3;
+  });
+  object_view ipairs = vm.alloc_native_function([inext](quokka_vm &v) {
+    lua_value t = v.num_arguments() > 0 ? v.argument(0) : lua_value();
+    v.push(inext);
+    v.push(t);
+    v.push((lua_integer)0);
+    return 3;
+  });
+
+  vm.env().set("next", next);
+  vm.env().set("pairs", pairs);
+  vm.env().set("ipairs", ipairs);
+}
@@ -0,0 +1,494 @@
+#ifdef QUOKKA_JIT
+
+#include "quokka/engine/ops.h"
+#include "quokka/engine/opcodes.h"
+#include "quokka/engine/jit.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+using namespace quokka::engine;
+
+namespace {
+  // Results of a handler
+  enum : int {
+    // Continue to the next instruction
+    JIT_CONTINUE = 0,
+    // Take the branch of the instruction (skip the next instruction, or jump)
+    JIT_BRANCH = 1,
+    // Exit to the interpreter, which will run the instruction again
+    JIT_BAIL = 2
+  };
+
+  using handler_t = int (*)(quokka_vm *vm, uint64_t a, uint64_t b, uint64_t c);
+
+  /**
+   * A minimal x86-64 assembler, supporting only what is required to stitch the templates
+   * together.
+   */
+  struct x64_asm {
+    enum reg : uint8_t { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSI = 6, RDI = 7 };
+    enum cond : uint8_t { E = 0x4, NE = 0x5, G = 0xF };
+
+    uint8_t *buf;
+    size_t len = 0;
+
+    void byte(uint8_t b) { buf[len++] = b; }
+    void u32(uint32_t v) { memcpy(buf + len, &v, 4); len += 4; }
+    void u64(uint64_t v) { memcpy(buf + len, &v, 8); len += 8; }
+
+    // mov r64, imm
+    void mov_imm(reg r, uint64_t v) {
+      if (v <= 0xFFFFFFFF) {
+        // mov r32, imm32 (zero extends)
+        byte(0xB8 + r); u32((uint32_t)v);
+      } else {
+        byte(0x48); byte(0xB8 + r); u64(v);
+      }
+    }
+    // mov rdi, rbx
+    void mov_rdi_rbx() { byte(0x48); byte(0x89); byte(0xDF); }
+    // mov rax, f; call rax
+    void call(const void *f) { mov_imm(RAX, (uint64_t)f); byte(0xFF); byte(0xD0); }
+    // test eax, eax
+    void test_eax() { byte(0x85); byte(0xC0); }
+    // cmp eax, imm8
+    void cmp_eax(uint8_t v) { byte(0x83); byte(0xF8); byte(v); }
+    // jcc rel32, returning the location of the displacement to be patched
+    size_t jcc(cond c) { byte(0x0F); byte(0x80 | c); u32(0); return len - 4; }
+    // jmp rel32, returning the location of the displacement to be patched
+    size_t jmp() { byte(0xE9); u32(0); return len - 4; }
+
+    void patch(size_t at, size_t target) {
+      int32_t rel = (int32_t)((int64_t)target - (int64_t)(at + 4));
+      memcpy(buf + at, &rel, 4);
+    }
+  };
+
+  struct cmp_eq { static bool f(quokka_vm &vm, const lua_value &a, const lua_value &b) { return vm_ops::eq(vm, a, b); } };
+  struct cmp_lt { static bool f(quokka_vm &vm, const lua_value &a, const lua_value &b) { return vm_ops::lt(vm, a, b); } };
+  struct cmp_le { static bool f(quokka_vm &vm, const lua_value &a, const lua_value &b) { return vm_ops::le(vm, a, b); } };
+
+  /**
+   * Handlers for each compiled instruction, implemented by vm_ops. Operands that may be a
+   * register or a constant (RK) are resolved when compiling, and passed either as a register
+   * index, or a pointer to the constant, as given by the K template parameters.
+   */
+  struct jit_ops {
+    template <bool K>
+    static const lua_value &RK(quokka_vm &vm, uint64_t v) {
+      if constexpr (K)
+        return *(const lua_value *)v;
+      else
+        return vm_ops::R(vm, v);
+    }
+
+    // Run a handler, exiting to the interpreter if it throws. The interpreter will run the
+    // instruction again, and raise the error itself.
+    template <int (*F)(quokka_vm &, uint64_t, uint64_t, uint64_t)>
+    static int guard(quokka_vm *vm, uint64_t a, uint64_t b, uint64_t c) {
+      try {
+        return F(*vm, a, b, c);
+      } catch (...) {
+        return JIT_BAIL;
+      }
+    }
+
+    static int move(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t) {
+      vm_ops::move(vm, a, b);
+      return JIT_CONTINUE;
+    }
+
+    static int loadk(quokka_vm &vm, uint64_t a, uint64_t k, uint64_t) {
+      vm_ops::loadk(vm, a, *(const lua_value *)k);
+      return JIT_CONTINUE;
+    }
+
+    static int loadbool(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      vm_ops::loadbool(vm, a, b > 0);
+      return c > 0 ? JIT_BRANCH : JIT_CONTINUE;
+    }
+
+    static int loadnil(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t) {
+      vm_ops::loadnil(vm, a, b);
+      return JIT_CONTINUE;
+    }
+
+    static int getupval(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t) {
+      vm_ops::getupval(vm, a, b);
+      return JIT_CONTINUE;
+    }
+
+    // Table accesses with a constant key use the inline cache of their instruction, so they are
+    // given the index of the instruction (pc) in place of the key, which is decoded again here.
+    template <bool B>
+    static const lua_value &key(bytecode_prototype &p, uint64_t pc) {
+      lua_instruction i = p.instructions[pc];
+      return p.constants[opcode_util::val(B ? opcode_util::get_B(i) : opcode_util::get_C(i))];
+    }
+
+    static int gettabup(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      vm_ops::gettabup(vm, a, b, vm_ops::R(vm, c));
+      return JIT_CONTINUE;
+    }
+
+    static int gettabup_ic(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t pc) {
+      bytecode_prototype &p = vm_ops::proto(vm);
+      vm_ops::gettabup(vm, a, b, key<false>(p, pc), p.cache(pc));
+      return JIT_CONTINUE;
+    }
+
+    static int gettable(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      vm_ops::gettable(vm, a, b, vm_ops::R(vm, c));
+      return JIT_CONTINUE;
+    }
+
+    static int gettable_ic(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t pc) {
+      bytecode_prototype &p = vm_ops::proto(vm);
+      vm_ops::gettable(vm, a, b, key<false>(p, pc), p.cache(pc));
+      return JIT_CONTINUE;
+    }
+
+    template <bool KC>
+    static int settabup(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      vm_ops::settabup(vm, a, vm_ops::R(vm, b), RK<KC>(vm, c));
+      return JIT_CONTINUE;
+    }
+
+    template <bool KC>
+    static int settabup_ic(quokka_vm &vm, uint64_t a, uint64_t pc, uint64_t c) {
+      bytecode_prototype &p = vm_ops::proto(vm);
+      vm_ops::settabup(vm, a, key<true>(p, pc), RK<KC>(vm, c), p.cache(pc));
+      return JIT_CONTINUE;
+    }
+
+    static int setupval(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t) {
+      vm_ops::setupval(vm, a, b);
+      return JIT_CONTINUE;
+    }
+
+    template <bool KC>
+    static int settable(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      vm_ops::settable(vm, a, vm_ops::R(vm, b), RK<KC>(vm, c));
+      return JIT_CONTINUE;
+    }
+
+    template <bool KC>
+    static int settable_ic(quokka_vm &vm, uint64_t a, uint64_t pc, uint64_t c) {
+      bytecode_prototype &p = vm_ops::proto(vm);
+      vm_ops::settable(vm, a, key<true>(p, pc), RK<KC>(vm, c), p.cache(pc));
+      return JIT_CONTINUE;
+    }
+
+    static int newtable(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      vm_ops::newtable(vm, a, (unsigned int)b, (unsigned int)c);
+      return JIT_CONTINUE;
+    }
+
+    static int self(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      vm_ops::self(vm, a, b, vm_ops::R(vm, c));
+      return JIT_CONTINUE;
+    }
+
+    static int self_ic(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t pc) {
+      bytecode_prototype &p = vm_ops::proto(vm);
+      vm_ops::self(vm, a, b, key<false>(p, pc), p.cache(pc));
+      return JIT_CONTINUE;
+    }
+
+    template <typename OP, bool KB, bool KC>
+    static int arith(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      vm_ops::arith<OP>(vm, a, RK<KB>(vm, b), RK<KC>(vm, c));
+      return JIT_CONTINUE;
+    }
+
+    static int unm(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t) {
+      vm_ops::unm(vm, a, b);
+      return JIT_CONTINUE;
+    }
+
+    static int bnot(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t) {
+      vm_ops::bnot(vm, a, b);
+      return JIT_CONTINUE;
+    }
+
+    static int op_not(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t) {
+      vm_ops::op_not(vm, a, b);
+      return JIT_CONTINUE;
+    }
+
+    static int close(quokka_vm &vm, uint64_t a, uint64_t, uint64_t) {
+      vm_ops::close(vm, a);
+      return JIT_CONTINUE;
+    }
+
+    template <typename CMP, bool KB, bool KC>
+    static int compare(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      return CMP::f(vm, RK<KB>(vm, b), RK<KC>(vm, c)) != (a != 0) ? JIT_BRANCH : JIT_CONTINUE;
+    }
+
+    static int test(quokka_vm &vm, uint64_t a, uint64_t, uint64_t c) {
+      return vm_ops::test(vm, a, c > 0) ? JIT_BRANCH : JIT_CONTINUE;
+    }
+
+    static int testset(quokka_vm &vm, uint64_t a, uint64_t b, uint64_t c) {
+      return vm_ops::testset(vm, a, b, c > 0) ? JIT_BRANCH : JIT_CONTINUE;
+    }
+
+    static int forloop(quokka_vm &vm, uint64_t a, uint64_t, uint64_t) {
+      return vm_ops::forloop(vm, a) ? JIT_BRANCH : JIT_CONTINUE;
+    }
+
+    static int tforloop(quokka_vm &vm, uint64_t a, uint64_t, uint64_t) {
+      return vm_ops::tforloop(vm, a) ? JIT_BRANCH : JIT_CONTINUE;
+    }
+  };
+
+  template <int (*F)(quokka_vm &, uint64_t, uint64_t, uint64_t)>
+  constexpr handler_t guarded() {
+    return &jit_ops::guard<F>;
+  }
+
+  template <typename OP>
+  handler_t arith_handler(bool kb, bool kc) {
+    static const handler_t handlers[4] = {
+      guarded<&jit_ops::arith<OP, false, false>>(), guarded<&jit_ops::arith<OP, false, true>>(),
+      guarded<&jit_ops::arith<OP, true, false>>(), guarded<&jit_ops::arith<OP, true, true>>()
+    };
+    return handlers[kb * 2 + kc];
+  }
+
+  template <typename CMP>
+  handler_t compare_handler(bool kb, bool kc) {
+    static const handler_t handlers[4] = {
+      guarded<&jit_ops::compare<CMP, false, false>>(), guarded<&jit_ops::compare<CMP, false, true>>(),
+      guarded<&jit_ops::compare<CMP, true, false>>(), guarded<&jit_ops::compare<CMP, true, true>>()
+    };
+    return handlers[kb * 2 + kc];
+  }
+
+  /**
+   * The compiled form of an instruction: a handler and its operands, and the control flow
+   * that follows it.
+   */
+  struct jit_template {
+    enum kind_t {
+      // Exit to the interpreter
+      EXIT,
+      // Call the handler, and continue to the next instruction
+      STEP,
+      // Call the handler, and jump to the target if it branches
+      BRANCH,
+      // Call the handler (if any), and always jump to the target
+      JUMP
+    } kind = EXIT;
+    handler_t handler = nullptr;
+    uint64_t a = 0, b = 0, c = 0;
+    // Index of the target instruction of BRANCH and JUMP
+    int64_t target = 0;
+  };
+
+  jit_template select(bytecode_prototype &proto, size_t pc) {
+    lua_instruction i = proto.instructions[pc];
+    uint8_t a = opcode_util::get_A(i);
+    unsigned int b = opcode_util::get_B(i), c = opcode_util::get_C(i);
+    bool kb = opcode_util::is_const(b), kc = opcode_util::is_const(c);
+    // Resolve an RK operand to a constant pointer or register index
+    auto rk = [&](unsigned int v) -> uint64_t {
+      return opcode_util::is_const(v) ? (uint64_t)&proto.constants[opcode_util::val(v)] : opcode_util::val(v);
+    };
+
+    jit_template t;
+    t.a = a; t.b = rk(b); t.c = rk(c);
+    auto step = [&](handler_t h) { t.kind = jit_template::STEP; t.handler = h; };
+    auto branch = [&](handler_t h, int64_t target) {
+      t.kind = jit_template::BRANCH; t.handler = h; t.target = target;
+    };
+
+    // Quickened instructions are compiled as they are in bytecode, as they may be specialised
+    // again after compiling (e.g. OP_FORLOOP_INT, when a loop is next run with floats)
+    switch (opcode_util::unquicken(opcode_util::get_opcode(i))) {
+      case opcode::OP_MOVE: step(guarded<&jit_ops::move>()); break;
+      case opcode::OP_LOADK:
+        step(guarded<&jit_ops::loadk>());
+        t.b = (uint64_t)&proto.constants[opcode_util::get_Bx(i)];
+        break;
+      case opcode::OP_LOADBOOL:
+        branch(guarded<&jit_ops::loadbool>(), pc + 2);
+        t.b = b; t.c = c;
+        break;
+      case opcode::OP_LOADNIL: step(guarded<&jit_ops::loadnil>()); t.b = b; break;
+      case opcode::OP_GETUPVAL: step(guarded<&jit_ops::getupval>()); t.b = b; break;
+      case opcode::OP_GETTABUP:
+        step(kc ? guarded<&jit_ops::gettabup_ic>() : guarded<&jit_ops::gettabup>());
+        t.b = b;
+        if (kc) t.c = pc;
+        break;
+      case opcode::OP_GETTABLE:
+        step(kc ? guarded<&jit_ops::gettable_ic>() : guarded<&jit_ops::gettable>());
+        if (kc) t.c = pc;
+        break;
+      case opcode::OP_SETTABUP: {
+        static const handler_t h[4] = {
+          guarded<&jit_ops::settabup<false>>(), guarded<&jit_ops::settabup<true>>(),
+          guarded<&jit_ops::settabup_ic<false>>(), guarded<&jit_ops::settabup_ic<true>>()
+        };
+        step(h[kb * 2 + kc]);
+        if (kb) t.b = pc;
+        break;
+      }
+      case opcode::OP_SETUPVAL: step(guarded<&jit_ops::setupval>()); t.b = b; break;
+      case opcode::OP_SETTABLE: {
+        static const handler_t h[4] = {
+          guarded<&jit_ops::settable<false>>(), guarded<&jit_ops::settable<true>>(),
+          guarded<&jit_ops::settable_ic<false>>(), guarded<&jit_ops::settable_ic<true>>()
+        };
+        step(h[kb * 2 + kc]);
+        if (kb) t.b = pc;
+        break;
+      }
+      case opcode::OP_NEWTABLE: step(guarded<&jit_ops::newtable>()); t.b = b; t.c = c; break;
+      case opcode::OP_SELF:
+        step(kc ? guarded<&jit_ops::self_ic>() : guarded<&jit_ops::self>());
+        if (kc) t.c = pc;
+        break;
+      case opcode::OP_ADD: step(arith_handler<op_add>(kb, kc)); break;
+      case opcode::OP_SUB: step(arith_handler<op_sub>(kb, kc)); break;
+      case opcode::OP_MUL: step(arith_handler<op_mul>(kb, kc)); break;
+      case opcode::OP_MOD: step(arith_handler<op_mod>(kb, kc)); break;
+      case opcode::OP_IDIV: step(arith_handler<op_idiv>(kb, kc)); break;
+      case opcode::OP_BAND: step(arith_handler<op_band>(kb, kc)); break;
+      case opcode::OP_BOR: step(arith_handler<op_bor>(kb, kc)); break;
+      case opcode::OP_BXOR: step(arith_handler<op_bxor>(kb, kc)); break;
+      case opcode::OP_SHL: step(arith_handler<op_shl>(kb, kc)); break;
+      case opcode::OP_SHR: step(arith_handler<op_shr>(kb, kc)); break;
+      case opcode::OP_UNM: step(guarded<&jit_ops::unm>()); break;
+      case opcode::OP_BNOT: step(guarded<&jit_ops::bnot>()); break;
+      case opcode::OP_NOT: step(guarded<&jit_ops::op_not>()); break;
+      case opcode::OP_JMP:
+        t.kind = jit_template::JUMP;
+        t.handler = a != 0 ? guarded<&jit_ops::close>() : nullptr;
+        t.target = pc + 1 + opcode_util::get_sBx(i);
+        break;
+      case opcode::OP_EQ: branch(compare_handler<cmp_eq>(kb, kc), pc + 2); break;
+      case opcode::OP_LT: branch(compare_handler<cmp_lt>(kb, kc), pc + 2); break;
+      case opcode::OP_LE: branch(compare_handler<cmp_le>(kb, kc), pc + 2); break;
+      case opcode::OP_TEST: branch(guarded<&jit_ops::test>(), pc + 2); t.c = c; break;
+      case opcode::OP_TESTSET: branch(guarded<&jit_ops::testset>(), pc + 2); t.b = b; t.c = c; break;
+      case opcode::OP_FORLOOP:
+        branch(guarded<&jit_ops::forloop>(), pc + 1 + opcode_util::get_sBx(i));
+        break;
+      case opcode::OP_TFORLOOP:
+        branch(guarded<&jit_ops::tforloop>(), pc + 1 + opcode_util::get_sBx(i));
+        break;
+      default:
+        // Left to the interpreter: calls, returns, closures, varargs, etc.
+        break;
+    }
+    return t;
+  }
+}
+
+jit_function::~jit_function() {
+  if (code != nullptr)
+    munmap(code, code_size);
+}
+
+bool quokka_jit::compile(bytecode_prototype &proto) {
+  using x = x64_asm;
+  size_t n = proto.instructions.size();
+  if (n == 0)
+    return false;
+
+  // Upper bounds of the size of the prologue, each instruction, and each exit stub
+  size_t size = 16 + n * (64 + 8);
+  void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    return false;
+
+  std::shared_ptr<jit_function> fn = std::make_shared<jit_function>();
+  fn->code = (uint8_t *)mem;
+  fn->code_size = size;
+  fn->entries.reserve(n);
+
+  x64_asm as{fn->code};
+  // Prologue: uint32_t (quokka_vm *vm [rdi], const uint8_t *entry [rsi])
+  // The VM is kept in rbx (callee saved) for the handlers.
+  as.byte(0x53);                                  // push rbx
+  as.byte(0x48); as.byte(0x89); as.byte(0xFB);    // mov rbx, rdi
+  as.byte(0xFF); as.byte(0xE6);                   // jmp rsi
+
+  struct fixup { size_t at; size_t target; bool exit; };
+  small_vector<fixup, 32> fixups;
+  auto jump_to = [&](size_t at, int64_t target) {
+    // Jumps out of the prototype can't happen with valid bytecode, but leave them to the interpreter
+    if (target < 0 || (size_t)target >= n)
+      fixups.emplace_back(fixup{ at, 0, true });
+    else
+      fixups.emplace_back(fixup{ at, (size_t)target, false });
+  };
+
+  for (size_t pc = 0; pc < n; pc++) {
+    fn->entries.emplace_back((uint32_t)as.len);
+    jit_template t = select(proto, pc);
+
+    if (t.kind == jit_template::EXIT) {
+      fixups.emplace_back(fixup{ as.jmp(), pc, true });
+      continue;
+    }
+
+    if (t.handler != nullptr) {
+      as.mov_rdi_rbx();
+      as.mov_imm(x::RSI, t.a);
+      as.mov_imm(x::RDX, t.b);
+      as.mov_imm(x::RCX, t.c);
+      as.call((const void *)t.handler);
+    }
+
+    switch (t.kind) {
+      case jit_template::STEP:
+        as.test_eax();
+        fixups.emplace_back(fixup{ as.jcc(x::NE), pc, true });
+        break;
+      case jit_template::BRANCH:
+        as.cmp_eax(JIT_BRANCH);
+        fixups.emplace_back(fixup{ as.jcc(x::G), pc, true });
+        jump_to(as.jcc(x::E), t.target);
+        break;
+      case jit_template::JUMP:
+        if (t.handler != nullptr) {
+          as.test_eax();
+          fixups.emplace_back(fixup{ as.jcc(x::NE), pc, true });
+        }
+        jump_to(as.jmp(), t.target);
+        break;
+      default:
+        break;
+    }
+  }
+  // Running off the end of the prototype can't happen with valid bytecode
+  fixups.emplace_back(fixup{ as.jmp(), n - 1, true });
+
+  // Exit stubs, returning the index of the instruction for the interpreter to resume from
+  small_vector<uint32_t, 32> stubs;
+  stubs.reserve(n);
+  for (size_t pc = 0; pc < n; pc++) {
+    stubs.emplace_back((uint32_t)as.len);
+    as.mov_imm(x::RAX, pc);
+    as.byte(0x5B);  // pop rbx
+    as.byte(0xC3);  // ret
+  }
+
+  for (size_t i = 0; i < fixups.size(); i++) {
+    const fixup &f = fixups[i];
+    as.patch(f.at, f.exit ? stubs[f.target] : fn->entries[f.target]);
+  }
+
+  if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0)
+    return false;
+
+  proto.jit = fn;
+  return true;
+}
+
+#endif
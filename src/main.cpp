@@ -2,28 +2,80 @@
 
 using namespace quokka::engine;
 
+#include <ctype.h>
 #include <fstream>
 #include <iostream>
+#include <string>
 #include <time.h>
 
-int main() {
+static double clock_seconds() {
+  return (double)(clock()) / (double)(CLOCKS_PER_SEC);
+}
+
+int main(int argc, char **argv) {
   std::cout << "sizeof(vm) " << sizeof(quokka_vm) << std::endl;
   std::cout << "sizeof(lua_value) " << sizeof(lua_value) << std::endl;
   std::cout << "sizeof(lua_object) " << sizeof(lua_object) << std::endl;
   std::cout << "sizeof(lua_upval) " << sizeof(lua_upval) << std::endl;
 
-  std::ifstream bytecode_in("luac.out");
+  // Usage: quokka [bytecode file] [--deferred] [--heap] [--aot output.cpp]
+  //               [--profile stacks.folded] [--profile-lines stacks.folded]
+  const char *bytecode_file = "luac.out";
+  const char *aot_file = nullptr;
+  const char *profile_file = nullptr;
+  bool deferred = false, heap = false, profile_lines = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--deferred")
+      deferred = true;
+    else if (std::string(argv[i]) == "--heap")
+      heap = true;
+    else if (std::string(argv[i]) == "--aot" && i + 1 < argc)
+      aot_file = argv[++i];
+    else if (std::string(argv[i]) == "--profile" && i + 1 < argc)
+      profile_file = argv[++i];
+    else if (std::string(argv[i]) == "--profile-lines" && i + 1 < argc) {
+      profile_file = argv[++i];
+      profile_lines = true;
+    } else
+      bytecode_file = argv[i];
+  }
+
+  std::ifstream bytecode_in(bytecode_file);
   bytecode_reader reader(bytecode_in);
+  reader.set_line_info(profile_lines);
 
   bytecode_chunk chunk = reader.read_chunk();
+
+  if (aot_file != nullptr) {
+#ifdef WITH_AOT_COMPILER
+    // The chunk is named after the output file, e.g. fib.cpp defines fib_attach()
+    std::string name = aot_file;
+    name = name.substr(name.find_last_of('/') + 1);
+    name = name.substr(0, name.find('.'));
+    for (char &c : name)
+      if (!isalnum(c)) c = '_';
+
+    std::ofstream aot_out(aot_file);
+    aot_compiler(aot_out, name.c_str()).write_chunk(chunk);
+    return 0;
+#else
+    std::cerr << "quokka must be built with WITH_AOT_COMPILER to use --aot" << std::endl;
+    return 1;
+#endif
+  }
   quokka_vm v(chunk);
+  v.set_deferred_refcount(deferred);
 
-  v.define_native_function("print", [](quokka_vm &v) {
+  intrinsics::define_all(v);
+  iterators::define_all(v);
+  metatables::define_all(v);
+  vec::define(v);
+  v.define_native_function("print", [](quokka_vm &v, void *) {
     std::cout << tostring(v.argument(0)).c_str() << std::endl;
     return 0;
   });
 
-  v.define_native_function("native_type", [](quokka_vm &vm) {
+  v.define_native_function("native_type", [](quokka_vm &vm, void *) {
     std::visit([&vm](auto &&t) {
       using T = typename std::decay<decltype(t)>::type;
       vm.push(typeid(T).name());
@@ -32,14 +84,41 @@ int main() {
     return 1;
   });
   
+  object_view clock_func = alloc_bound_function<clock_seconds>(v);
   object_view os = v.alloc_object();
-  os->emplace<lua_table>().set("clock", v.alloc_native_function([](quokka_vm &v) {
-    v.push( (double)(clock()) / (double)(CLOCKS_PER_SEC) );
-    return 1;
-  }));
+  os->emplace<lua_table>().set("clock", clock_func);
   v.env().set("os", os);
 
+  lua_profiler profiler(profile_lines ? lua_profiler::mode::LINE : lua_profiler::mode::FUNCTION);
+  if (profile_file != nullptr) {
+    v.set_profiler(&profiler);
+    if (!profiler.start_timer())
+      std::cerr << "the profiler timer isn't supported on this host" << std::endl;
+  }
+
   v.call();
 
+  if (profile_file != nullptr) {
+    profiler.stop_timer();
+    std::ofstream profile_out(profile_file);
+    profiler.write_folded(profile_out);
+    std::cerr << "profile: " << profiler.samples() << " samples" << std::endl;
+  }
+
+  if (heap) {
+    heap_stats h = v.inspect_heap();
+    std::cout << "objects: " << h.tables << " tables, " << h.closures << " closures, " << h.natives
+      << " natives, " << h.arrays << " arrays (" << h.object_slots << " slots)" << std::endl;
+    std::cout << "upvals: " << h.upvals << " (" << h.open_upvals << " open)" << std::endl;
+    std::cout << "registers: " << h.registers << " (high water " << h.register_high_water
+      << ", capacity " << h.register_capacity << ")" << std::endl;
+    std::cout << "strings: " << h.strings << " (" << h.string_bytes << " bytes)" << std::endl;
+    std::cout << "bytes: " << h.spill_bytes << " spilled, " << h.array_bytes << " arrays, "
+      << h.prototype_bytes << " prototypes, " << v.memory_stats().used << " heap" << std::endl;
+  }
+#ifdef QUOKKA_OPCODE_STATS
+  v.write_instruction_report(std::cerr);
+#endif
+
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "quokka/engine/memory.h"
+
+#include <stdlib.h>
+
+using namespace quokka::engine;
+
+namespace {
+  // Stored before each buffer, so that it can be credited to the budget it was charged to
+  struct alignas(alignof(max_align_t)) buffer_header {
+    memory_budget *budget;
+    size_t bytes;
+  };
+
+  thread_local memory_budget *current_budget = nullptr;
+}  // namespace
+
+void memory_budget::release::operator()(memory_budget *b) const {
+  if (b->used == 0)
+    delete b;
+  else
+    b->released = true;
+}
+
+void *memory::alloc(size_t bytes) {
+  memory_budget *b = current_budget;
+  bytes += sizeof(buffer_header);
+  if (b != nullptr && b->used + bytes > b->limit)
+    throw lua_memory_error();
+
+  buffer_header *h = (buffer_header *)malloc(bytes);
+  if (h == nullptr)
+    throw std::bad_alloc();
+  h->budget = b;
+  h->bytes = bytes;
+  if (b != nullptr) {
+    b->used += bytes;
+    if (b->used > b->peak)
+      b->peak = b->used;
+  }
+  return h + 1;
+}
+
+void memory::free(void *p) {
+  if (p == nullptr)
+    return;
+  buffer_header *h = (buffer_header *)p - 1;
+  memory_budget *b = h->budget;
+  if (b != nullptr) {
+    b->used -= h->bytes;
+    if (b->released && b->used == 0)
+      delete b;
+  }
+  ::free(h);
+}
+
+memory_budget *memory::current() {
+  return current_budget;
+}
+
+memory::scope::scope(memory_budget *b) : _outer(current_budget) {
+  current_budget = b;
+}
+
+memory::scope::~scope() {
+  current_budget = _outer;
+}
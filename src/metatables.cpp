@@ -0,0 +1,251 @@
+#include "quokka/engine/metatables.h"
+
+#include <algorithm>
+
+using namespace quokka::engine;
+
+// The longest chain of __index or __newindex tables that is followed, as MAXTAGLOOP in Lua
+#ifndef QUOKKA_MAX_META_CHAIN
+#define QUOKKA_MAX_META_CHAIN 2000
+#endif
+
+lua_value quokka_vm::call_metamethod(const lua_value &f, const lua_value &a, const lua_value &b, const lua_value *c) {
+  // Metamethods are called from the middle of an instruction, so the call is made above the
+  // registers of the current frame, and the state of the instruction is restored after it.
+  size_t top = _registers.size();
+  size_t func_idx = std::max(top, _base + lua_func(_cl_ref).proto->max_stack_size);
+  set_register(func_idx, f);
+  set_register(func_idx + 1, a);
+  set_register(func_idx + 2, b);
+  if (c != nullptr)
+    set_register(func_idx + 3, *c);
+
+  lua_instruction instruction = _instruction;
+  opcode code = _code;
+  uint8_t arg_a = _arg_a;
+  unsigned int arg_b = _arg_b, arg_c = _arg_c;
+  size_t ra = _ra, base = _base;
+  call_ref ci = _ci_ref;
+  object_view cl = _cl_ref;
+
+  if (!precall(func_idx, 1))
+    execute();
+  lua_value result = _registers[func_idx];
+
+  _instruction = instruction;
+  _code = code;
+  _arg_a = arg_a;
+  _arg_b = arg_b;
+  _arg_c = arg_c;
+  _ra = ra;
+  _base = base;
+  _ci_ref = ci;
+  _cl_ref = cl;
+  _registers.chop(top);
+  return result;
+}
+
+void quokka_vm::index_meta(lua_value t, const lua_value &k, size_t result_idx, inline_cache *ic) {
+  // The first step of the chain (e.g. from an object to its class) is cached by the instruction
+  inline_cache *meta_ic = nullptr, *key_ic = nullptr;
+  if (ic != nullptr) {
+    if (ic->chain == nullptr)
+      ic->chain.reset(new inline_cache[2]);
+    meta_ic = &ic->chain[0];
+    key_ic = &ic->chain[1];
+  }
+
+  for (int depth = 0; depth < QUOKKA_MAX_META_CHAIN; depth++) {
+    const lua_value *h = find_metamethod(t, lua_metamethod::INDEX, meta_ic);
+    if (h == nullptr || !is<object_view>(*h))
+      break;
+    if (is_function(*h)) {
+      lua_value f = *h;
+      lua_value result = call_metamethod(f, t, k);
+      set_register(result_idx, result);
+      return;
+    }
+
+    // Hold the next table before releasing this one, which may be its only reference
+    lua_value next = *h;
+    t = std::move(next);
+    lua_object &o = *object(t);
+    if (is<lua_array>(o)) {
+      _registers.emplace(result_idx, std::get<lua_array>(o).get(k));
+      return;
+    }
+    lua_table &tt = std::get<lua_table>(o);
+    const lua_value *v = key_ic != nullptr ? tt.find(k, *key_ic) : tt.find(k);
+    if (v != nullptr && !is<lua_nil>(*v)) {
+      set_register_get(result_idx, v);
+      return;
+    }
+    meta_ic = key_ic = nullptr;
+  }
+  _registers.emplace(result_idx);  // nil
+}
+
+void quokka_vm::newindex_meta(lua_value t, const lua_value &k, const lua_value &v, inline_cache *ic) {
+  for (int depth = 0; depth < QUOKKA_MAX_META_CHAIN; depth++) {
+    lua_object &o = *object(t);
+    if (is<lua_array>(o)) {
+      std::get<lua_array>(o).set(k, v);
+      return;
+    }
+    lua_table &tt = std::get<lua_table>(o);
+    // The metamethod is searched for first, so that its absence is known for the next set,
+    // even if the table has the key
+    const lua_value *h = tt.lacks_metamethod(lua_metamethod::NEWINDEX) ? nullptr : find_metamethod(t, lua_metamethod::NEWINDEX);
+    const lua_value *raw = h != nullptr ? tt.find(k) : nullptr;
+    if (h == nullptr || !is<object_view>(*h) || (raw != nullptr && !is<lua_nil>(*raw))) {
+      if (ic != nullptr)
+        tt.set(k, v, *ic);
+      else
+        tt.set(k, v);
+      return;
+    }
+    if (is_function(*h)) {
+      lua_value f = *h;
+      call_metamethod(f, t, k, &v);
+      return;
+    }
+
+    lua_value next = *h;
+    t = std::move(next);
+    ic = nullptr;
+  }
+}
+
+void quokka_vm::arith_meta(lua_metamethod e, const lua_value &a, const lua_value &b, size_t result_idx) {
+  const lua_value *h = find_metamethod(a, e);
+  if (h == nullptr)
+    h = find_metamethod(b, e);
+  if (h == nullptr)
+    return;
+  lua_value f = *h;
+  lua_value result = call_metamethod(f, a, b);
+  set_register(result_idx, result);
+}
+
+bool quokka_vm::compare_meta(lua_metamethod e, const lua_value &a, const lua_value &b) {
+  const lua_value *h = find_metamethod(a, e);
+  if (h == nullptr)
+    h = find_metamethod(b, e);
+  if (h != nullptr) {
+    lua_value f = *h;
+    return !falsey(call_metamethod(f, a, b));
+  }
+  if (e == lua_metamethod::LE) {
+    // As in Lua 5.3, a <= b is not (b < a) if there is no __le
+    h = find_metamethod(b, lua_metamethod::LT);
+    if (h == nullptr)
+      h = find_metamethod(a, lua_metamethod::LT);
+    if (h != nullptr) {
+      lua_value f = *h;
+      return falsey(call_metamethod(f, b, a));
+    }
+  }
+  return false;
+}
+
+bool quokka_vm::concat_meta(size_t ra, size_t first, size_t last) {
+  size_t i = first;
+  while (i <= last && !is<object_view>(_registers[i]))
+    i++;
+  if (i > last)
+    return false;
+
+  // Concatenation is right associative, which matters to metamethods
+  lua_value acc = _registers[last];
+  for (i = last; i-- > first;) {
+    const lua_value &l = _registers[i];
+    if (is<object_view>(l) || is<object_view>(acc)) {
+      const lua_value *h = find_metamethod(l, lua_metamethod::CONCAT);
+      if (h == nullptr)
+        h = find_metamethod(acc, lua_metamethod::CONCAT);
+      if (h == nullptr)
+        return true;
+      lua_value f = *h;
+      acc = call_metamethod(f, l, acc);
+    } else {
+      lua_string s = tostring(l);
+      s.concat_str(tostring(acc));
+      acc = s;
+    }
+  }
+  set_register(ra, acc);
+  return true;
+}
+
+bool quokka_vm::call_meta(size_t func_idx) {
+  const lua_value *h = find_metamethod(_registers[func_idx], lua_metamethod::CALL);
+  if (h == nullptr)
+    return false;
+  lua_value f = *h;
+  for (size_t i = _registers.size(); i > func_idx; i--)
+    set_register(i, _registers[i - 1]);
+  set_register(func_idx, f);
+  return true;
+}
+
+namespace {
+  int setmetatable(quokka_vm &, lua_args args, lua_value &result) {
+    const lua_value &t = args[0], &mt = args[1];
+    if (is<object_view>(t) && is<lua_table>(*object(t)) && (is<lua_nil>(mt) || (is<object_view>(mt) && is<lua_table>(*object(mt)))))
+      table(object(t)).metatable = mt;
+    result = t;
+    return 1;
+  }
+
+  int getmetatable(quokka_vm &, lua_args args, lua_value &result) {
+    const lua_value &t = args[0];
+    if (is<object_view>(t) && is<lua_table>(*object(t)))
+      result = table(object(t)).metatable;
+    return 1;
+  }
+
+  int rawget(quokka_vm &, lua_args args, lua_value &result) {
+    const lua_value &t = args[0];
+    if (is<object_view>(t) && is<lua_table>(*object(t)))
+      result = table(object(t)).get(args[1]);
+    return 1;
+  }
+
+  int rawset(quokka_vm &, lua_args args, lua_value &result) {
+    const lua_value &t = args[0];
+    if (is<object_view>(t) && is<lua_table>(*object(t)))
+      table(object(t)).set(args[1], args[2]);
+    result = t;
+    return 1;
+  }
+
+  int rawequal(quokka_vm &, lua_args args, lua_value &result) {
+    result = args[0] == args[1];
+    return 1;
+  }
+
+  int rawlen(quokka_vm &, lua_args args, lua_value &result) {
+    const lua_value &v = args[0];
+    if (is<lua_string>(v))
+      result = (lua_integer)std::get<lua_string>(v).length();
+    else if (is<object_view>(v) && is<lua_table>(*object(v)))
+      result = (lua_integer)table(object(v)).entries.size();
+    return 1;
+  }
+
+  // Allocating an object may move the other objects of the VM, including the env, so the
+  // function is allocated before the env is looked up.
+  void define_function(quokka_vm &vm, const char *key, lua_fast_native f) {
+    object_view func = vm.alloc_fast_native_function(f);
+    vm.env().set(key, func);
+  }
+}  // namespace
+
+void metatables::define_all(quokka_vm &vm) {
+  define_function(vm, "setmetatable", setmetatable);
+  define_function(vm, "getmetatable", getmetatable);
+  define_function(vm, "rawget", rawget);
+  define_function(vm, "rawset", rawset);
+  define_function(vm, "rawequal", rawequal);
+  define_function(vm, "rawlen", rawlen);
+}
@@ -0,0 +1,84 @@
+#include "quokka/engine/vm.h"
+
+#ifdef QUOKKA_OPCODE_STATS
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+using namespace quokka::engine;
+
+namespace {
+  void reset_prototype(bytecode_prototype &p) {
+    p.stats = prototype_stats();
+    for (int i = 0; i < p.num_protos; i++)
+      reset_prototype(*p.protos[i]);
+  }
+
+  // Prototypes are named by where they are defined, as the names of functions are debug
+  // information, which is discarded
+  void write_prototype(std::ostream &out, const bytecode_prototype &p, int depth) {
+    std::string name(depth * 2, ' ');
+    if (depth == 0)
+      name += "main chunk";
+    else
+      name += "function at line " + std::to_string(p.line_defined);
+    out << std::left << std::setw(32) << name << std::right << std::setw(14) << p.stats.executed;
+#ifdef QUOKKA_OPCODE_CYCLES
+    out << std::setw(16) << p.stats.cycles;
+#endif
+    out << "\n";
+    for (int i = 0; i < p.num_protos; i++)
+      write_prototype(out, *p.protos[i], depth + 1);
+  }
+}  // namespace
+
+void quokka_vm::reset_instruction_stats() {
+  _opstats = opcode_stats();
+  for (size_t i = 0; i < _chunks.size(); i++)
+    reset_prototype(*_chunks[i]);
+}
+
+void quokka_vm::write_instruction_report(std::ostream &out) const {
+  size_t order[opcode_util::NUM_OPCODES];
+  uint64_t total = 0;
+  for (size_t i = 0; i < opcode_util::NUM_OPCODES; i++) {
+    order[i] = i;
+    total += _opstats.executed[i];
+  }
+  std::sort(order, order + opcode_util::NUM_OPCODES, [this](size_t a, size_t b) {
+    return _opstats.executed[a] > _opstats.executed[b];
+  });
+
+  out << std::left << std::setw(16) << "opcode" << std::right << std::setw(14) << "executed" << std::setw(8) << "%";
+#ifdef QUOKKA_OPCODE_CYCLES
+  out << std::setw(16) << "cycles" << std::setw(12) << "cycles/op";
+#endif
+  out << "\n";
+  for (size_t i = 0; i < opcode_util::NUM_OPCODES; i++) {
+    size_t op = order[i];
+    uint64_t n = _opstats.executed[op];
+    if (n == 0)
+      break;
+    out << std::left << std::setw(16) << opcode_util::name((opcode)op) << std::right << std::setw(14) << n
+        << std::setw(7) << std::fixed << std::setprecision(1) << (100.0 * n / total) << "%";
+#ifdef QUOKKA_OPCODE_CYCLES
+    out << std::setw(16) << _opstats.cycles[op] << std::setw(12) << (_opstats.cycles[op] / n);
+#endif
+    out << "\n";
+  }
+#ifdef QUOKKA_OPCODE_CYCLES
+  if (_opstats.compiled_cycles > 0)
+    out << std::left << std::setw(38) << "compiled code" << std::right << std::setw(16) << _opstats.compiled_cycles << "\n";
+#endif
+
+  out << "\n" << std::left << std::setw(32) << "prototype" << std::right << std::setw(14) << "executed";
+#ifdef QUOKKA_OPCODE_CYCLES
+  out << std::setw(16) << "cycles";
+#endif
+  out << "\n";
+  for (size_t i = 0; i < _chunks.size(); i++)
+    write_prototype(out, *_chunks[i], 0);
+}
+
+#endif
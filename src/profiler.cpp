@@ -0,0 +1,128 @@
+#include "quokka/engine/profiler.h"
+#include "quokka/engine/vm.h"
+
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#define QUOKKA_PROFILER_TIMER
+#endif
+
+using namespace quokka::engine;
+
+namespace {
+#ifdef QUOKKA_PROFILER_TIMER
+  // The profiler ticked by the timer. Signal handlers can only use lock-free atomics.
+  std::atomic<lua_profiler *> timer_profiler{nullptr};
+
+  void on_timer(int) {
+    lua_profiler *p = timer_profiler.load(std::memory_order_relaxed);
+    if (p != nullptr)
+      p->tick();
+  }
+#endif
+
+  void append_frame(std::string &out, const bytecode_prototype &p, const lua_instruction *pc, bool line) {
+    // The main chunk is the only function defined at line 0. Sources are named "@file" or
+    // "=name" by luac, and are empty if the bytecode is stripped.
+    if (p.line_defined == 0) {
+      out += "main";
+    } else {
+      const char *source = p.source.length() > 0 ? p.source.c_str() : nullptr;
+      if (source != nullptr && (source[0] == '@' || source[0] == '='))
+        source++;
+      out += source != nullptr ? source : "fn";
+      out += ':';
+      out += std::to_string(p.line_defined);
+    }
+
+    if (line) {
+      // The pc of a frame is the instruction after the one it is running
+      size_t i = pc > &p.instructions[0] ? pc - &p.instructions[0] - 1 : 0;
+      out += ':';
+      if (p.line_info != nullptr)
+        out += std::to_string(p.line_info[i]);
+      else
+        out += "pc" + std::to_string(i);
+    }
+  }
+}  // namespace
+
+lua_profiler::~lua_profiler() {
+  stop_timer();
+}
+
+bool lua_profiler::start_timer(unsigned int interval_us) {
+#ifdef QUOKKA_PROFILER_TIMER
+  lua_profiler *none = nullptr;
+  if (!timer_profiler.compare_exchange_strong(none, this))
+    return timer_profiler.load() == this;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_timer;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGPROF, &sa, nullptr);
+
+  struct itimerval timer;
+  timer.it_interval.tv_sec = interval_us / 1000000;
+  timer.it_interval.tv_usec = interval_us % 1000000;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  return true;
+#else
+  (void)interval_us;
+  return false;
+#endif
+}
+
+void lua_profiler::stop_timer() {
+#ifdef QUOKKA_PROFILER_TIMER
+  lua_profiler *self = this;
+  if (!timer_profiler.compare_exchange_strong(self, nullptr))
+    return;
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, nullptr);
+#endif
+}
+
+void lua_profiler::write_folded(std::ostream &out) const {
+  // Sorted, so that the output of a profile doesn't depend on the order of the hash map
+  std::vector<std::pair<std::string, uint64_t>> stacks(_stacks.begin(), _stacks.end());
+  std::sort(stacks.begin(), stacks.end());
+  for (const auto &s : stacks)
+    out << s.first << " " << s.second << "\n";
+}
+
+void lua_profiler::clear() {
+  _stacks.clear();
+  _samples = 0;
+}
+
+void quokka_vm::sample_stack() {
+  lua_profiler &p = *_profiler;
+  p._pending.store(false, std::memory_order_relaxed);
+
+  // The stack is built in a string kept by the profiler, so that a sample only allocates
+  // when the stack is new
+  std::string &stack = p._stack;
+  stack.clear();
+  bool line = p._mode == lua_profiler::mode::LINE;
+  for (size_t i = 0; i < _callinfo.size(); i++) {
+    const lua_call &ci = _callinfo[i];
+    if (i > 0)
+      stack += ';';
+    if (ci.callstatus & CALL_STATUS_LUA)
+      append_frame(stack, *lua_func(_registers[ci.func_idx]).proto, ci.info.lua.pc, line);
+    else
+      stack += "[native]";
+  }
+  p._stacks[stack]++;
+  p._samples++;
+}
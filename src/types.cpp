@@ -1,7 +1,9 @@
 #include "quokka/engine/types.h"
 
+#include <atomic>
 #include <new>
 #include <cstring>
+#include <stdlib.h>
 
 using namespace quokka::engine;
 
@@ -41,18 +43,18 @@ bool ::quokka::engine::tointeger(const lua_value &v, lua_integer &out) {
 }
 
 bool ::quokka::engine::tostring(const lua_value &v, lua_string &out) {
-  char buf[16];
+  char buf[32];
   bool ret = true;
   std::visit(overloaded {
     [&](auto&&) { ret = false; },
     [&](lua_string s) { out.clear(); out.concat_str(s); },
     [&](std::monostate) { out.clear(); out.concat("nil"); },
     [&](lua_integer i) {
-      snprintf(buf, 16, "%d", i);
+      snprintf(buf, sizeof(buf), "%lld", (long long)i);
       out.clear(); out.concat(buf);
     },
     [&](lua_number n) {
-      snprintf(buf, 16, "%f", n);
+      snprintf(buf, sizeof(buf), "%f", (double)n);
       out.clear(); out.concat(buf);
     },
     [&](bool b) {
@@ -60,27 +62,208 @@ bool ::quokka::engine::tostring(const lua_value &v, lua_string &out) {
     },
     [&](object_view v) {
       out.clear();
-      out.concat(is<lua_table>(*v) ? "table: <unknown>" : "function: <unknown>");
+      out.concat(is<lua_table>(*v) ? "table: <unknown>" : is<lua_array>(*v) ? "userdata: <unknown>" : "function: <unknown>");
     }
   }, v);
   return ret;
 }
 
 lua_value lua_table::get(const lua_value &key) const {
-  for (size_t i = 0; i < entries.size(); i++) {
+  const lua_value *v = find(key);
+  return v != nullptr ? *v : lua_value();  // nil
+}
+
+// IDs of shapes. These are shared by all VMs (which may be on different threads), so that an
+// inline cache never matches a shape of another VM. 0 is reserved for an empty cache.
+static std::atomic<uint32_t> next_shape_id{1};
+
+lua_shape::lua_shape() : id(next_shape_id++), size(0), _root(this) {}
+
+lua_shape::lua_shape(const lua_shape *root, size_t n, const lua_string &k) : id(next_shape_id++), size(n), key(k), _root(root) {}
+
+const lua_shape *lua_shape::add(const lua_string &k) const {
+  for (size_t i = 0; i < _transitions.size(); i++) {
+    if (_transitions[i]->key == k)
+      return _transitions[i].get();
+  }
+  if (size >= engine_traits::max_shape_keys || _root->_count >= engine_traits::max_shapes)
+    return nullptr;
+  _root->_count++;
+  return _transitions.emplace_back(new lua_shape(_root, size + 1, k)).get();
+}
+
+size_t lua_table::index_of(const lua_value &key) const {
+  if (is<lua_integer>(key)) {
+    lua_integer i = std::get<lua_integer>(key);
+    if (i >= 1 && (size_t)i <= sequence)
+      return (size_t)i - 1;
+  }
+  // The sequence holds no other keys
+  for (size_t i = sequence; i < entries.size(); i++) {
     if (entries[i].key == key)
-      return entries[i].value;
+      return i;
   }
-  return lua_value();  // nil
+  return entries.size();
+}
+
+const lua_value *lua_table::find(const lua_value &key) const {
+  size_t i = index_of(key);
+  return i < entries.size() ? &entries[i].value : nullptr;
+}
+
+const lua_value *lua_table::find(const lua_value &key, inline_cache &ic) const {
+  if (shape == nullptr)
+    return find(key);
+  if (ic.shape == shape->id)
+    return ic.slot != inline_cache::ABSENT ? &entries[ic.slot].value : nullptr;
+
+  // A shape has a fixed set of keys, so misses are cached as well
+  size_t i = index_of(key);
+  ic.shape = shape->id;
+  ic.slot = i < entries.size() ? (uint32_t)i : inline_cache::ABSENT;
+  return i < entries.size() ? &entries[i].value : nullptr;
 }
 
 void lua_table::set(const lua_value &k, const lua_value &v) {
-  for (size_t i = 0; i < entries.size(); i++) {
-    if (entries[i].key == k) {
-      entries[i].value = v;
-      return;
-    }
+  absent_metamethods = 0;
+  size_t i = index_of(k);
+  if (i < entries.size()) {
+    entries[i].value = v;
+    return;
   }
 
+  if (entries.size() == sequence && is<lua_integer>(k) && std::get<lua_integer>(k) == (lua_integer)sequence + 1)
+    sequence++;
+  if (shape != nullptr)
+    shape = is<lua_string>(k) ? shape->add(std::get<lua_string>(k)) : nullptr;
   entries.emplace_back(k, v);
-}
\ No newline at end of file
+}
+
+void lua_table::set(const lua_value &k, const lua_value &v, inline_cache &ic) {
+  if (shape != nullptr && ic.shape == shape->id && ic.slot != inline_cache::ABSENT) {
+    absent_metamethods = 0;
+    entries[ic.slot].value = v;
+    return;
+  }
+
+  size_t i = index_of(k);
+  if (i == entries.size()) {
+    // Adding a key changes the shape, so there is nothing to cache
+    set(k, v);
+    return;
+  }
+  absent_metamethods = 0;
+  entries[i].value = v;
+  if (shape != nullptr) {
+    ic.shape = shape->id;
+    ic.slot = (uint32_t)i;
+  }
+}
+
+size_t lua_table::next(const lua_value &k) const {
+  size_t i;
+  if (is<lua_nil>(k)) {
+    i = 0;
+  } else if (_cursor < entries.size() && entries[_cursor].key == k) {
+    i = _cursor + 1;
+  } else {
+    // Not the last key found, e.g. during nested iterations of the table
+    i = index_of(k);
+    if (i == entries.size())
+      return i;
+    i++;
+  }
+
+  while (i < entries.size() && is<lua_nil>(entries[i].value))
+    i++;
+  _cursor = i;
+  return i;
+}
+// Names of the metamethods, by lua_metamethod
+static const lua_value metamethod_names[] = {
+  lua_string{"__index"}, lua_string{"__newindex"}, lua_string{"__call"}, lua_string{"__eq"},
+  lua_string{"__lt"}, lua_string{"__le"}, lua_string{"__len"}, lua_string{"__concat"},
+  lua_string{"__unm"}, lua_string{"__bnot"}, lua_string{"__add"}, lua_string{"__sub"},
+  lua_string{"__mul"}, lua_string{"__div"}, lua_string{"__mod"}, lua_string{"__pow"},
+  lua_string{"__idiv"}, lua_string{"__band"}, lua_string{"__bor"}, lua_string{"__bxor"},
+  lua_string{"__shl"}, lua_string{"__shr"}
+};
+static_assert(sizeof(metamethod_names) / sizeof(metamethod_names[0]) == (size_t)lua_metamethod::COUNT);
+
+const lua_value *lua_table::find_metamethod(lua_metamethod e, inline_cache *ic) const {
+  uint32_t bit = 1u << (unsigned)e;
+  if (absent_metamethods & bit)
+    return nullptr;
+  const lua_value &name = metamethod_names[(size_t)e];
+  const lua_value *v = ic != nullptr ? find(name, *ic) : find(name);
+  if (v == nullptr || is<lua_nil>(*v)) {
+    absent_metamethods |= bit;
+    return nullptr;
+  }
+  return v;
+}
+
+const lua_value *::quokka::engine::find_metamethod(const lua_value &v, lua_metamethod e, inline_cache *ic) {
+  if (!is<object_view>(v) || !is<lua_table>(*object(v)))
+    return nullptr;
+  const lua_value &mt = table(object(v)).metatable;
+  return is<lua_nil>(mt) ? nullptr : table(object(mt)).find_metamethod(e, ic);
+}
+
+static size_t element_size(lua_array::element_type type) {
+  switch (type) {
+    case lua_array::element_type::FLOAT64: return sizeof(double);
+    case lua_array::element_type::INT32: return sizeof(int32_t);
+    default: return sizeof(uint8_t);
+  }
+}
+
+lua_array::lua_array(element_type t, size_t len) : type(t), length(len), _owned(true) {
+  size_t bytes = (len > 0 ? len : 1) * element_size(t);
+  data = memory::alloc(bytes);
+  memset(data, 0, bytes);
+}
+
+size_t lua_array::owned_bytes() const {
+  return _owned ? (length > 0 ? length : 1) * element_size(type) : 0;
+}
+
+lua_array::lua_array(element_type t, void *d, size_t len) : type(t), data(d), length(len), _owned(false) {}
+
+lua_array::lua_array(const lua_array &other) : type(other.type), data(other.data), length(other.length), _owned(other._owned) {
+  // Owned buffers are copied, host buffers are shared
+  if (_owned) {
+    data = memory::alloc((length > 0 ? length : 1) * element_size(type));
+    memcpy(data, other.data, length * element_size(type));
+  }
+}
+
+lua_array::lua_array(lua_array &&other) noexcept : type(other.type), data(other.data), length(other.length), _owned(other._owned) {
+  other._owned = false;
+}
+
+lua_array &lua_array::operator=(const lua_array &other) {
+  if (this != &other) {
+    lua_array copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+lua_array &lua_array::operator=(lua_array &&other) noexcept {
+  if (this != &other) {
+    if (_owned)
+      memory::free(data);
+    type = other.type;
+    data = other.data;
+    length = other.length;
+    _owned = other._owned;
+    other._owned = false;
+  }
+  return *this;
+}
+
+lua_array::~lua_array() {
+  if (_owned)
+    memory::free(data);
+}
@@ -0,0 +1,446 @@
+#include "quokka/engine/vec.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define QUOKKA_VEC_X86
+#include <immintrin.h>
+#endif
+
+using namespace quokka::engine;
+
+namespace {
+  // Kernels over float64 buffers. min and max require n > 0.
+  struct kernels {
+    void (*add)(double *d, const double *a, const double *b, size_t n);
+    void (*mul)(double *d, const double *a, const double *b, size_t n);
+    void (*fma)(double *d, const double *a, const double *b, const double *c, size_t n);
+    void (*scale)(double *d, const double *a, double s, size_t n);
+    void (*clamp)(double *d, const double *a, double lo, double hi, size_t n);
+    double (*dot)(const double *a, const double *b, size_t n);
+    double (*sum)(const double *a, size_t n);
+    double (*min)(const double *a, size_t n);
+    double (*max)(const double *a, size_t n);
+  };
+
+  namespace scalar {
+    void add(double *d, const double *a, const double *b, size_t n) {
+      for (size_t i = 0; i < n; i++) d[i] = a[i] + b[i];
+    }
+    void mul(double *d, const double *a, const double *b, size_t n) {
+      for (size_t i = 0; i < n; i++) d[i] = a[i] * b[i];
+    }
+    void fma(double *d, const double *a, const double *b, const double *c, size_t n) {
+      for (size_t i = 0; i < n; i++) d[i] = a[i] * b[i] + c[i];
+    }
+    void scale(double *d, const double *a, double s, size_t n) {
+      for (size_t i = 0; i < n; i++) d[i] = a[i] * s;
+    }
+    void clamp(double *d, const double *a, double lo, double hi, size_t n) {
+      for (size_t i = 0; i < n; i++) d[i] = std::min(std::max(a[i], lo), hi);
+    }
+    double dot(const double *a, const double *b, size_t n) {
+      double r = 0;
+      for (size_t i = 0; i < n; i++) r += a[i] * b[i];
+      return r;
+    }
+    double sum(const double *a, size_t n) {
+      double r = 0;
+      for (size_t i = 0; i < n; i++) r += a[i];
+      return r;
+    }
+    double min(const double *a, size_t n) {
+      double r = a[0];
+      for (size_t i = 1; i < n; i++) r = std::min(r, a[i]);
+      return r;
+    }
+    double max(const double *a, size_t n) {
+      double r = a[0];
+      for (size_t i = 1; i < n; i++) r = std::max(r, a[i]);
+      return r;
+    }
+  }  // namespace scalar
+
+  const kernels scalar_kernels = {
+    scalar::add, scalar::mul, scalar::fma, scalar::scale, scalar::clamp,
+    scalar::dot, scalar::sum, scalar::min, scalar::max
+  };
+
+#ifdef QUOKKA_VEC_X86
+  // SSE2 is part of x86-64, so these are always available. The tails of buffers that don't fill
+  // a register are left to the scalar kernels.
+  namespace sse2 {
+    void add(double *d, const double *a, const double *b, size_t n) {
+      size_t i = 0;
+      for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(d + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+      scalar::add(d + i, a + i, b + i, n - i);
+    }
+    void mul(double *d, const double *a, const double *b, size_t n) {
+      size_t i = 0;
+      for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(d + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+      scalar::mul(d + i, a + i, b + i, n - i);
+    }
+    void fma(double *d, const double *a, const double *b, const double *c, size_t n) {
+      size_t i = 0;
+      for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(d + i, _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)), _mm_loadu_pd(c + i)));
+      scalar::fma(d + i, a + i, b + i, c + i, n - i);
+    }
+    void scale(double *d, const double *a, double s, size_t n) {
+      size_t i = 0;
+      __m128d vs = _mm_set1_pd(s);
+      for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(d + i, _mm_mul_pd(_mm_loadu_pd(a + i), vs));
+      scalar::scale(d + i, a + i, s, n - i);
+    }
+    void clamp(double *d, const double *a, double lo, double hi, size_t n) {
+      size_t i = 0;
+      __m128d vlo = _mm_set1_pd(lo), vhi = _mm_set1_pd(hi);
+      for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(d + i, _mm_min_pd(_mm_max_pd(_mm_loadu_pd(a + i), vlo), vhi));
+      scalar::clamp(d + i, a + i, lo, hi, n - i);
+    }
+    double hsum(__m128d v) {
+      return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+    }
+    double dot(const double *a, const double *b, size_t n) {
+      size_t i = 0;
+      __m128d r0 = _mm_setzero_pd(), r1 = _mm_setzero_pd();
+      for (; i + 4 <= n; i += 4) {
+        r0 = _mm_add_pd(r0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        r1 = _mm_add_pd(r1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+      }
+      return hsum(_mm_add_pd(r0, r1)) + scalar::dot(a + i, b + i, n - i);
+    }
+    double sum(const double *a, size_t n) {
+      size_t i = 0;
+      __m128d r0 = _mm_setzero_pd(), r1 = _mm_setzero_pd();
+      for (; i + 4 <= n; i += 4) {
+        r0 = _mm_add_pd(r0, _mm_loadu_pd(a + i));
+        r1 = _mm_add_pd(r1, _mm_loadu_pd(a + i + 2));
+      }
+      return hsum(_mm_add_pd(r0, r1)) + scalar::sum(a + i, n - i);
+    }
+    double min(const double *a, size_t n) {
+      if (n < 2)
+        return scalar::min(a, n);
+      size_t i = 2;
+      __m128d r = _mm_loadu_pd(a);
+      for (; i + 2 <= n; i += 2)
+        r = _mm_min_pd(r, _mm_loadu_pd(a + i));
+      double m = _mm_cvtsd_f64(_mm_min_sd(r, _mm_unpackhi_pd(r, r)));
+      return i < n ? std::min(m, scalar::min(a + i, n - i)) : m;
+    }
+    double max(const double *a, size_t n) {
+      if (n < 2)
+        return scalar::max(a, n);
+      size_t i = 2;
+      __m128d r = _mm_loadu_pd(a);
+      for (; i + 2 <= n; i += 2)
+        r = _mm_max_pd(r, _mm_loadu_pd(a + i));
+      double m = _mm_cvtsd_f64(_mm_max_sd(r, _mm_unpackhi_pd(r, r)));
+      return i < n ? std::max(m, scalar::max(a + i, n - i)) : m;
+    }
+  }  // namespace sse2
+
+  const kernels sse2_kernels = {
+    sse2::add, sse2::mul, sse2::fma, sse2::scale, sse2::clamp,
+    sse2::dot, sse2::sum, sse2::min, sse2::max
+  };
+
+  // AVX2 and FMA, only used if the CPU supports them (see select_kernels)
+  namespace avx2 {
+#define QUOKKA_VEC_AVX2 __attribute__((target("avx2,fma")))
+    QUOKKA_VEC_AVX2 void add(double *d, const double *a, const double *b, size_t n) {
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(d + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+      sse2::add(d + i, a + i, b + i, n - i);
+    }
+    QUOKKA_VEC_AVX2 void mul(double *d, const double *a, const double *b, size_t n) {
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(d + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+      sse2::mul(d + i, a + i, b + i, n - i);
+    }
+    QUOKKA_VEC_AVX2 void fma(double *d, const double *a, const double *b, const double *c, size_t n) {
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(d + i, _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), _mm256_loadu_pd(c + i)));
+      sse2::fma(d + i, a + i, b + i, c + i, n - i);
+    }
+    QUOKKA_VEC_AVX2 void scale(double *d, const double *a, double s, size_t n) {
+      size_t i = 0;
+      __m256d vs = _mm256_set1_pd(s);
+      for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(d + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), vs));
+      sse2::scale(d + i, a + i, s, n - i);
+    }
+    QUOKKA_VEC_AVX2 void clamp(double *d, const double *a, double lo, double hi, size_t n) {
+      size_t i = 0;
+      __m256d vlo = _mm256_set1_pd(lo), vhi = _mm256_set1_pd(hi);
+      for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(d + i, _mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(a + i), vlo), vhi));
+      sse2::clamp(d + i, a + i, lo, hi, n - i);
+    }
+    QUOKKA_VEC_AVX2 __m128d fold(__m256d v) {
+      return _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    }
+    QUOKKA_VEC_AVX2 double dot(const double *a, const double *b, size_t n) {
+      size_t i = 0;
+      __m256d r0 = _mm256_setzero_pd(), r1 = _mm256_setzero_pd();
+      for (; i + 8 <= n; i += 8) {
+        r0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), r0);
+        r1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), r1);
+      }
+      return sse2::hsum(fold(_mm256_add_pd(r0, r1))) + sse2::dot(a + i, b + i, n - i);
+    }
+    QUOKKA_VEC_AVX2 double sum(const double *a, size_t n) {
+      size_t i = 0;
+      __m256d r0 = _mm256_setzero_pd(), r1 = _mm256_setzero_pd();
+      for (; i + 8 <= n; i += 8) {
+        r0 = _mm256_add_pd(r0, _mm256_loadu_pd(a + i));
+        r1 = _mm256_add_pd(r1, _mm256_loadu_pd(a + i + 4));
+      }
+      return sse2::hsum(fold(_mm256_add_pd(r0, r1))) + sse2::sum(a + i, n - i);
+    }
+    QUOKKA_VEC_AVX2 double min(const double *a, size_t n) {
+      if (n < 4)
+        return sse2::min(a, n);
+      size_t i = 4;
+      __m256d r = _mm256_loadu_pd(a);
+      for (; i + 4 <= n; i += 4)
+        r = _mm256_min_pd(r, _mm256_loadu_pd(a + i));
+      __m128d h = _mm_min_pd(_mm256_castpd256_pd128(r), _mm256_extractf128_pd(r, 1));
+      double m = _mm_cvtsd_f64(_mm_min_sd(h, _mm_unpackhi_pd(h, h)));
+      return i < n ? std::min(m, sse2::min(a + i, n - i)) : m;
+    }
+    QUOKKA_VEC_AVX2 double max(const double *a, size_t n) {
+      if (n < 4)
+        return sse2::max(a, n);
+      size_t i = 4;
+      __m256d r = _mm256_loadu_pd(a);
+      for (; i + 4 <= n; i += 4)
+        r = _mm256_max_pd(r, _mm256_loadu_pd(a + i));
+      __m128d h = _mm_max_pd(_mm256_castpd256_pd128(r), _mm256_extractf128_pd(r, 1));
+      double m = _mm_cvtsd_f64(_mm_max_sd(h, _mm_unpackhi_pd(h, h)));
+      return i < n ? std::max(m, sse2::max(a + i, n - i)) : m;
+    }
+#undef QUOKKA_VEC_AVX2
+  }  // namespace avx2
+
+  const kernels avx2_kernels = {
+    avx2::add, avx2::mul, avx2::fma, avx2::scale, avx2::clamp,
+    avx2::dot, avx2::sum, avx2::min, avx2::max
+  };
+#endif
+
+  const kernels &select_kernels() {
+#ifdef QUOKKA_VEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return avx2_kernels;
+    return sse2_kernels;
+#else
+    return scalar_kernels;
+#endif
+  }
+
+  const kernels &K() {
+    static const kernels &k = select_kernels();
+    return k;
+  }
+
+  /* Arguments */
+
+  lua_array *array(const lua_value &v) {
+    if (!is<object_view>(v))
+      return nullptr;
+    lua_object &o = *std::get<object_view>(v);
+    return is<lua_array>(o) ? &std::get<lua_array>(o) : nullptr;
+  }
+
+  bool f64(const lua_array *a) {
+    return a->type == lua_array::element_type::FLOAT64;
+  }
+
+  double *f64_data(const lua_array *a) {
+    return static_cast<double *>(a->data);
+  }
+
+  // Elements of arrays of any type, for the scalar loops over non-float64 arrays
+  double load(const lua_array *a, size_t i) {
+    switch (a->type) {
+      case lua_array::element_type::FLOAT64: return static_cast<const double *>(a->data)[i];
+      case lua_array::element_type::INT32: return static_cast<const int32_t *>(a->data)[i];
+      default: return static_cast<const uint8_t *>(a->data)[i];
+    }
+  }
+
+  void store(lua_array *a, size_t i, double v) {
+    switch (a->type) {
+      case lua_array::element_type::FLOAT64: static_cast<double *>(a->data)[i] = v; break;
+      case lua_array::element_type::INT32: static_cast<int32_t *>(a->data)[i] = (int32_t)v; break;
+      default: static_cast<uint8_t *>(a->data)[i] = (uint8_t)v; break;
+    }
+  }
+
+  /* Library */
+
+  int vec_new(quokka_vm &vm, lua_args args, lua_value &result) {
+    lua_integer n;
+    if (!tointeger(args[0], n) || n < 0)
+      return 0;
+    result = vm.alloc_array(lua_array::element_type::FLOAT64, (size_t)n);
+    return 1;
+  }
+
+  int vec_add(quokka_vm &, lua_args args, lua_value &result) {
+    lua_array *d = array(args[0]), *a = array(args[1]), *b = array(args[2]);
+    if (!d || !a || !b)
+      return 0;
+    size_t n = std::min({ d->length, a->length, b->length });
+    if (f64(d) && f64(a) && f64(b))
+      K().add(f64_data(d), f64_data(a), f64_data(b), n);
+    else
+      for (size_t i = 0; i < n; i++) store(d, i, load(a, i) + load(b, i));
+    result = args[0];
+    return 1;
+  }
+
+  int vec_mul(quokka_vm &, lua_args args, lua_value &result) {
+    lua_array *d = array(args[0]), *a = array(args[1]), *b = array(args[2]);
+    if (!d || !a || !b)
+      return 0;
+    size_t n = std::min({ d->length, a->length, b->length });
+    if (f64(d) && f64(a) && f64(b))
+      K().mul(f64_data(d), f64_data(a), f64_data(b), n);
+    else
+      for (size_t i = 0; i < n; i++) store(d, i, load(a, i) * load(b, i));
+    result = args[0];
+    return 1;
+  }
+
+  int vec_fma(quokka_vm &, lua_args args, lua_value &result) {
+    lua_array *d = array(args[0]), *a = array(args[1]), *b = array(args[2]), *c = array(args[3]);
+    if (!d || !a || !b || !c)
+      return 0;
+    size_t n = std::min({ d->length, a->length, b->length, c->length });
+    if (f64(d) && f64(a) && f64(b) && f64(c))
+      K().fma(f64_data(d), f64_data(a), f64_data(b), f64_data(c), n);
+    else
+      for (size_t i = 0; i < n; i++) store(d, i, load(a, i) * load(b, i) + load(c, i));
+    result = args[0];
+    return 1;
+  }
+
+  int vec_scale(quokka_vm &, lua_args args, lua_value &result) {
+    lua_array *d = array(args[0]), *a = array(args[1]);
+    lua_number s;
+    if (!d || !a || !tonumber(args[2], s))
+      return 0;
+    size_t n = std::min(d->length, a->length);
+    if (f64(d) && f64(a))
+      K().scale(f64_data(d), f64_data(a), s, n);
+    else
+      for (size_t i = 0; i < n; i++) store(d, i, load(a, i) * s);
+    result = args[0];
+    return 1;
+  }
+
+  int vec_clamp(quokka_vm &, lua_args args, lua_value &result) {
+    lua_array *d = array(args[0]), *a = array(args[1]);
+    lua_number lo, hi;
+    if (!d || !a || !tonumber(args[2], lo) || !tonumber(args[3], hi))
+      return 0;
+    size_t n = std::min(d->length, a->length);
+    if (f64(d) && f64(a))
+      K().clamp(f64_data(d), f64_data(a), lo, hi, n);
+    else
+      for (size_t i = 0; i < n; i++) store(d, i, std::min<double>(std::max<double>(load(a, i), lo), hi));
+    result = args[0];
+    return 1;
+  }
+
+  int vec_dot(quokka_vm &, lua_args args, lua_value &result) {
+    lua_array *a = array(args[0]), *b = array(args[1]);
+    if (!a || !b)
+      return 0;
+    size_t n = std::min(a->length, b->length);
+    lua_number r = 0;
+    if (f64(a) && f64(b))
+      r = K().dot(f64_data(a), f64_data(b), n);
+    else
+      for (size_t i = 0; i < n; i++) r += load(a, i) * load(b, i);
+    result = r;
+    return 1;
+  }
+
+  int vec_sum(quokka_vm &, lua_args args, lua_value &result) {
+    lua_array *a = array(args[0]);
+    if (!a)
+      return 0;
+    lua_number r = 0;
+    if (f64(a))
+      r = K().sum(f64_data(a), a->length);
+    else
+      for (size_t i = 0; i < a->length; i++) r += load(a, i);
+    result = r;
+    return 1;
+  }
+
+  int vec_min(quokka_vm &, lua_args args, lua_value &result) {
+    lua_array *a = array(args[0]);
+    if (!a || a->length == 0)
+      return 0;
+    lua_number r;
+    if (f64(a)) {
+      r = K().min(f64_data(a), a->length);
+    } else {
+      r = load(a, 0);
+      for (size_t i = 1; i < a->length; i++) r = std::min<double>(r, load(a, i));
+    }
+    result = r;
+    return 1;
+  }
+
+  int vec_max(quokka_vm &, lua_args args, lua_value &result) {
+    lua_array *a = array(args[0]);
+    if (!a || a->length == 0)
+      return 0;
+    lua_number r;
+    if (f64(a)) {
+      r = K().max(f64_data(a), a->length);
+    } else {
+      r = load(a, 0);
+      for (size_t i = 1; i < a->length; i++) r = std::max<double>(r, load(a, i));
+    }
+    result = r;
+    return 1;
+  }
+
+  // Allocating an object may move the other objects of the VM, so the function is allocated
+  // before the table is looked up.
+  void define_function(quokka_vm &vm, const object_view &lib, const char *key, lua_fast_native f) {
+    object_view func = vm.alloc_fast_native_function(f);
+    table(lib).set(key, func);
+  }
+}  // namespace
+
+void vec::define(quokka_vm &vm) {
+  object_view lib = vm.alloc_object();
+  lib->emplace<lua_table>();
+  define_function(vm, lib, "new", vec_new);
+  define_function(vm, lib, "add", vec_add);
+  define_function(vm, lib, "mul", vec_mul);
+  define_function(vm, lib, "fma", vec_fma);
+  define_function(vm, lib, "scale", vec_scale);
+  define_function(vm, lib, "clamp", vec_clamp);
+  define_function(vm, lib, "dot", vec_dot);
+  define_function(vm, lib, "sum", vec_sum);
+  define_function(vm, lib, "min", vec_min);
+  define_function(vm, lib, "max", vec_max);
+  vm.env().set("vec", lib);
+}
@@ -1,20 +1,40 @@
 #include "quokka/engine/vm.h"
+#include "quokka/engine/ops.h"
 #include "quokka/engine/opcodes.h"
 
 #include <math.h>
 
 using namespace quokka::engine;
 
+namespace {
+  // Find the prototypes of which every closure captures the same upvals (see closure_pool::constant)
+  void mark_constant_closures(bytecode_prototype &proto, bool parent_constant) {
+    bool constant = parent_constant;
+    for (int i = 0; i < proto.num_upvalues; i++) {
+      if (proto.upvalues[i].instack)
+        constant = false;
+    }
+    proto.closures.constant = constant || proto.num_upvalues == 0;
+    for (int i = 0; i < proto.num_protos; i++)
+      mark_constant_closures(*proto.protos[i], proto.closures.constant);
+  }
+}  // namespace
+
 quokka_vm::quokka_vm() {
+  memory::scope mem(_memory.get());
   // Load distinguished env.
   object_view objstore = alloc_object();
-  lua_table table = objstore->emplace<lua_table>();
+  lua_table &table = objstore->emplace<lua_table>();
+  // Globals are accessed by constant keys, so the env is cached by shape as Lua's tables are
+  if constexpr (engine_traits::shapes)
+    table.shape = &_shapes;
   table.set("__QUOKKA_LE__", "0.0.1");
   _distinguished_env = lua_value(objstore);
 }
 
 void quokka_vm::load(bytecode_chunk &bytecode) {
   // TODO: Check header
+  memory::scope mem(_memory.get());
 
   // Add prototype to _rootprotos
   // Add closure to top of register stack (the root function)
@@ -35,20 +55,67 @@ void quokka_vm::load(bytecode_chunk &bytecode) {
       root_lua_f.upval_views.emplace(0, upv);
     }
   }
+
+  bool loaded = false;
+  for (size_t i = 0; i < _chunks.size(); i++)
+    loaded = loaded || _chunks[i] == &bytecode.root_func;
+  if (!loaded)
+    _chunks.emplace_back(&bytecode.root_func);
+
+  // The root function is only called once for each load, so the functions that only capture its
+  // upvals are constant too.
+  for (int i = 0; i < bytecode.root_func.num_protos; i++)
+    mark_constant_closures(*bytecode.root_func.protos[i], true);
 }
 
 object_view quokka_vm::alloc_object() {
-  for (size_t i = 0; i < _objects.size(); i++) {
-    if (_objects[i].is_free())
+  memory::scope mem(_memory.get());
+  return alloc_object(nullptr, 0);
+}
+
+object_view quokka_vm::alloc_object(const size_t *hints, size_t num_hints) {
+  if (_gc.budget > 0)
+    collect_step(_gc.budget);
+  for (size_t h = 0; h < num_hints; h++) {
+    size_t i = hints[h];
+    if (i >= _object_arena && i < _objects.size() && _objects[i].is_free()) {
+      _objects[i].defer(_deferred_refcount);
       return object_view(&_objects, i);
+    }
+  }
+  for (size_t i = _object_arena; i < _objects.size(); i++) {
+    if (_objects[i].is_free()) {
+      _objects[i].defer(_deferred_refcount);
+      return object_view(&_objects, i);
+    }
+  }
+  if (_deferred_refcount && _objects.size() >= _reconcile_threshold) {
+    // Free pending objects before growing the pool. The threshold grows with the number
+    // of objects left after reconciling, so that the cost is amortized over allocations.
+    size_t freed = reconcile();
+    _reconcile_threshold = (_objects.size() - freed) * 2 + 8;
+    if (freed > 0)
+      return alloc_object(hints, num_hints);
+  }
+  // Didn't find a free slot, emplace an object and use that. If the pool can't grow within the
+  // memory limit, collect cycles to make room first, as a last resort.
+  try {
+    _objects.emplace_back().defer(_deferred_refcount);
+  } catch (const lua_memory_error &) {
+    size_t collected = _gc.stats.collected_objects;
+    collect();
+    if (_gc.stats.collected_objects == collected)
+      throw;
+    return alloc_object(hints, num_hints);
   }
-  // Didn't find a free slot, emplace an object and use that.
-  _objects.emplace_back();
   return object_view(&_objects, _objects.size() - 1);
 }
 
 upval_view quokka_vm::alloc_upval() {
-  for (size_t i = 0; i < _upvals.size(); i++) {
+  memory::scope mem(_memory.get());
+  if (_gc.budget > 0)
+    collect_step(_gc.budget);
+  for (size_t i = _upval_arena; i < _upvals.size(); i++) {
     if (_upvals[i].is_free())
       return upval_view(&_upvals, i);
   }
@@ -57,10 +124,112 @@ upval_view quokka_vm::alloc_upval() {
   return upval_view(&_upvals, _upvals.size() - 1);
 }
 
-void quokka_vm::call(size_t nargs, int nreturn) {
+bool quokka_vm::call(size_t nargs, int nreturn) {
+  memory::scope mem(_memory.get());
   size_t stack_idx = _registers.size() - nargs - 1;
-  if (!precall(stack_idx, nreturn))
-    execute();
+  size_t num_frames = _callinfo.size();
+  bool ok = true;
+  try {
+    if (!precall(stack_idx, nreturn))
+      execute();
+  } catch (const lua_memory_error &) {
+    unwind(stack_idx, num_frames);
+    ok = false;
+  }
+  // Returning to the host is a safe point for deferred reference counts.
+  if (_deferred_refcount && _callinfo.size() == 0)
+    reconcile();
+  return ok;
+}
+
+void quokka_vm::unwind(size_t func_stack_idx, size_t num_frames) {
+  // Closures that escaped the call keep the values of its variables
+  close_upvals(func_stack_idx);
+  _callinfo.chop(num_frames);
+  _registers.chop(func_stack_idx);
+#ifdef QUOKKA_OPCODE_CYCLES
+  _op_last_proto = nullptr;
+#endif
+}
+
+size_t quokka_vm::reconcile() {
+  // Borrowed views can only be held by the registers, so a pending object that isn't in the
+  // registers has no references left.
+  for (size_t i = 0; i < _registers.size(); i++) {
+    if (is<object_view>(_registers[i])) {
+      const object_view &o = object(_registers[i]);
+      if (o.is_valid())
+        o->mark_borrowed();
+    }
+  }
+
+  size_t freed = 0;
+  for (size_t i = 0; i < _objects.size(); i++) {
+    if (_objects[i].is_pending() && _objects[i].release())
+      freed++;
+  }
+  return freed;
+}
+
+// Chop all trailing free slots of a pool, down to (at most) the start of the arena.
+template<typename T>
+static void release_arena(small_vector_base<T> &pool, size_t arena) {
+  size_t top = pool.size();
+  while (top > arena && pool[top - 1].is_free())
+    top--;
+  pool.chop(top);
+}
+
+bool quokka_vm::call_scoped(size_t nargs, int nreturn) {
+  size_t outer_object_arena = _object_arena;
+  size_t outer_upval_arena = _upval_arena;
+  // Escaped objects from a previous scoped call may have since been freed, so trim
+  // before starting the arena, to stop the arena from creeping up the pool.
+  if (_deferred_refcount)
+    reconcile();
+  release_arena(_objects, _object_arena);
+  release_arena(_upvals, _upval_arena);
+  _object_arena = _objects.size();
+  _upval_arena = _upvals.size();
+
+  bool ok = call(nargs, nreturn);
+
+  release_arena(_objects, _object_arena);
+  release_arena(_upvals, _upval_arena);
+  // Anything left in the arena has escaped, and is now part of the regular pool.
+  _object_arena = outer_object_arena;
+  _upval_arena = outer_upval_arena;
+  return ok;
+}
+
+bool quokka_vm::call_batch(const lua_value &fn, const lua_value *const *inputs, size_t nargs, lua_value *const *outputs, size_t nresults, size_t nrows) {
+  memory::scope mem(_memory.get());
+  size_t func_idx = _registers.size();
+  size_t num_frames = _callinfo.size();
+  bool ok = true;
+  try {
+    for (size_t row = 0; row < nrows; row++) {
+      // The previous call replaced the function with its results
+      set_register(func_idx, fn);
+      for (size_t i = 0; i < nargs; i++)
+        set_register(func_idx + 1 + i, inputs[i][row]);
+      _registers.chop(func_idx + 1 + nargs);
+
+      if (!precall(func_idx, (int)nresults))
+        execute();
+
+      for (size_t i = 0; i < nresults; i++)
+        outputs[i][row] = _registers[func_idx + i];
+    }
+  } catch (const lua_memory_error &) {
+    unwind(func_idx, num_frames);
+    ok = false;
+  }
+  _registers.chop(func_idx);
+  // As in call(), returning to the host is a safe point for deferred reference counts.
+  if (_deferred_refcount && _callinfo.size() == 0)
+    reconcile();
+  return ok;
 }
 
 lua_value &quokka_vm::argument(int id) {
@@ -73,11 +242,12 @@ int quokka_vm::num_arguments() {
 }
 
 void quokka_vm::push(const lua_value &v) {
+  memory::scope mem(_memory.get());
   _registers.emplace_back(v);
 }
 
-lua_value &quokka_vm::pop() {
-  lua_value &v = _registers.last();
+lua_value quokka_vm::pop() {
+  lua_value v = _registers.last();
   _registers.chop(_registers.size() - 1);
   return v;
 }
@@ -92,18 +262,196 @@ lua_table &quokka_vm::env() {
 
 object_view quokka_vm::alloc_native_function(lua_native_closure::func_t f) {
   object_view r = alloc_object();
-  r->emplace<lua_native_closure>(lua_native_closure{f});
+  r->emplace<lua_native_closure>().func = f;
   return r;
 }
 
+// The function is allocated before env() is looked up, as allocating an object may move the
+// env table.
 void quokka_vm::define_native_function(const lua_value &key, lua_native_closure::func_t f) {
-  env().set(key, alloc_native_function(f));
+  memory::scope mem(_memory.get());
+  object_view func = alloc_native_function(f);
+  env().set(key, func);
+}
+
+void quokka_vm::define_native_function(const lua_value &key, lua_native_closure::ptr_t f, void *ctx) {
+  memory::scope mem(_memory.get());
+  object_view func = alloc_native_function(f, ctx);
+  env().set(key, func);
+}
+
+object_view quokka_vm::alloc_native_function(lua_native_closure::ptr_t f, void *ctx) {
+  object_view r = alloc_object();
+  lua_native_closure &ncl = r->emplace<lua_native_closure>();
+  ncl.ptr = f;
+  ncl.ctx = ctx;
+  return r;
+}
+
+object_view quokka_vm::alloc_array(lua_array::element_type type, size_t length) {
+  memory::scope mem(_memory.get());
+  object_view r = alloc_object();
+  r->emplace<lua_array>(type, length);
+  return r;
+}
+
+object_view quokka_vm::alloc_array(double *data, size_t length) {
+  object_view r = alloc_object();
+  r->emplace<lua_array>(lua_array::element_type::FLOAT64, data, length);
+  return r;
+}
+
+object_view quokka_vm::alloc_array(int32_t *data, size_t length) {
+  object_view r = alloc_object();
+  r->emplace<lua_array>(lua_array::element_type::INT32, data, length);
+  return r;
+}
+
+object_view quokka_vm::alloc_array(uint8_t *data, size_t length) {
+  object_view r = alloc_object();
+  r->emplace<lua_array>(lua_array::element_type::UINT8, data, length);
+  return r;
+}
+
+object_view quokka_vm::alloc_fast_native_function(lua_fast_native f) {
+  object_view r = alloc_object();
+  r->emplace<lua_native_closure>().fast = f;
+  return r;
+}
+
+object_view quokka_vm::alloc_intrinsic(lua_intrinsic f) {
+  // Regular calls of the intrinsic, with the intrinsic as the context
+  object_view r = alloc_native_function([](quokka_vm &vm, void *ctx) {
+    static const lua_value nil;
+    int n = vm.num_arguments();
+    lua_value result;
+    reinterpret_cast<lua_intrinsic>(ctx)(n > 0 ? vm.argument(0) : nil, n > 1 ? vm.argument(1) : nil, result);
+    vm.push(result);
+    return 1;
+  }, reinterpret_cast<void *>(f));
+  native_func(r).intrinsic = f;
+  return r;
+}
+
+void quokka_vm::define_intrinsic(const lua_value &key, lua_intrinsic f) {
+  memory::scope mem(_memory.get());
+  object_view func = alloc_intrinsic(f);
+  env().set(key, func);
+}
+
+object_view quokka_vm::alloc_iterator(lua_iterator f) {
+  // Regular calls of the iterator, with the iterator as the context
+  object_view r = alloc_native_function([](quokka_vm &vm, void *ctx) {
+    int n = vm.num_arguments();
+    lua_value state = n > 0 ? vm.argument(0) : lua_value();
+    lua_value control = n > 1 ? vm.argument(1) : lua_value();
+    lua_value value;
+    if (!reinterpret_cast<lua_iterator>(ctx)(state, control, value)) {
+      vm.push(lua_value());
+      return 1;
+    }
+    vm.push(control);
+    vm.push(value);
+    return 2;
+  }, reinterpret_cast<void *>(f));
+  native_func(r).iterator = f;
+  return r;
 }
 
 // PRIVATE //
 
+void quokka_vm::set_register(size_t idx, const lua_value &v) {
+  if (is<object_view>(v)) {
+    if (idx < _registers.size() && &_registers[idx] == &v)
+      return;
+    _registers.emplace(idx, std::in_place_type<object_view>, std::get<object_view>(v), borrowed);
+  } else {
+    _registers.emplace(idx, v);
+  }
+}
+
+void quokka_vm::set_register_get(size_t idx, const lua_table &t, const lua_value &k) {
+  set_register_get(idx, t.find(k));
+}
+
+void quokka_vm::set_register_get(size_t idx, const lua_value *v) {
+  if (v == nullptr) {
+    _registers.emplace(idx);  // nil
+  } else if (idx < _registers.size() && is<object_view>(_registers[idx])) {
+    // The register may hold the last reference to the table, so take the value before
+    // the register is overwritten.
+    lua_value tmp = is<object_view>(*v)
+      ? lua_value(std::in_place_type<object_view>, std::get<object_view>(*v), borrowed) : *v;
+    _registers.emplace(idx, std::move(tmp));
+  } else {
+    set_register(idx, *v);
+  }
+}
+
+void quokka_vm::call_fast_native(lua_fast_native f, size_t func_idx, size_t nargs, int nreturn) {
+  // Registers are only contiguous within a segment, so arguments that cross into the next
+  // segment are copied.
+  const lua_value *args = nargs > 0 ? &_registers[func_idx + 1] : nullptr;
+  small_vector<lua_value, 8> copy;
+  if (nargs > 1 && &_registers[func_idx + nargs] != args + (nargs - 1)) {
+    for (size_t i = 1; i <= nargs; i++)
+      copy.emplace_back(_registers[func_idx + i]);
+    args = &copy[0];
+  }
+
+  lua_value result;
+  int n = f(*this, lua_args{args, (int)nargs}, result);
+  if (nreturn == MULTIRET)
+    nreturn = n;
+  if (nreturn > 0) {
+    if (n > 0)
+      set_register(func_idx, result);
+    else
+      _registers.emplace(func_idx);   // nil
+    for (int i = 1; i < nreturn; i++)
+      _registers.emplace(func_idx + i);
+  }
+  _registers.chop(func_idx + nreturn);
+}
+
+bool quokka_vm::call_intrinsic(size_t func_idx, unsigned int nargs) {
+  const lua_value &fn = _registers[func_idx];
+  if (!is<object_view>(fn) || !is<lua_native_closure>(*object(fn)))
+    return false;
+  lua_intrinsic f = native_func(object(fn)).intrinsic;
+  if (f == nullptr)
+    return false;
+
+  static const lua_value nil;
+  lua_value result;
+  f(nargs > 0 ? _registers[func_idx + 1] : nil, nargs > 1 ? _registers[func_idx + 2] : nil, result);
+  // As in postcall(), the result replaces the function, and the arguments are popped
+  set_register(func_idx, result);
+  _registers.chop(func_idx + 1);
+  return true;
+}
+
+bool quokka_vm::call_iterator(size_t ra, unsigned int nresults) {
+  const lua_value &fn = _registers[ra];
+  if (!is<object_view>(fn) || !is<lua_native_closure>(*object(fn)))
+    return false;
+  lua_iterator f = native_func(object(fn)).iterator;
+  if (f == nullptr)
+    return false;
+
+  // R(A+3), R(A+4) = R(A)(R(A+1), R(A+2)), with the remaining results nil
+  lua_value control = _registers[ra + 2];
+  lua_value value;
+  f(_registers[ra + 1], control, value);
+  set_register(ra + 3, control);
+  if (nresults > 1)
+    set_register(ra + 4, value);
+  for (unsigned int i = 2; i < nresults; i++)
+    _registers.emplace(ra + 3 + i);
+  return true;
+}
+
 bool quokka_vm::precall(size_t func_stack_idx, int nreturn) {
-  // TODO: Meta method, see ldo.c luaD_precall
   // object_view func_ref = _registers[func_stack_idx].std::get<object_view>(data);
   //lua_closure &closure = (*func_ref)->std::get<lua_closure>(data);
   object_view obj = object(_registers[func_stack_idx]);
@@ -113,7 +461,8 @@ bool quokka_vm::precall(size_t func_stack_idx, int nreturn) {
     bytecode_prototype *proto = lcl.proto;
     // Actual number of arguments, not necessarily what's required
     size_t nargs = _registers.size() - func_stack_idx - 1;
-    // Grow the stack pre-emptively
+    // Grow the stack pre-emptively. This only allocates new segments, the values of the
+    // frames below are not moved.
     _registers.reserve(_registers.size() + proto->max_stack_size);
     size_t base;
     if (proto->is_var_arg) {
@@ -123,7 +472,7 @@ bool quokka_vm::precall(size_t func_stack_idx, int nreturn) {
       base = _registers.size();
       for (i = 0; i < proto->num_params && i < nargs; i++) {
         // Copy to stack
-        _registers.emplace_back(_registers[fixed + i]);
+        set_register(_registers.size(), _registers[fixed + i]);
         _registers.emplace(fixed + i);  // Set original to nil
       }
       for (; i < proto->num_params; i++) {
@@ -148,19 +497,52 @@ bool quokka_vm::precall(size_t func_stack_idx, int nreturn) {
   } else if (is<lua_native_closure>(*obj)) {
     // Native closure
     lua_native_closure &ncl = native_func(obj);
+    if (ncl.fast != nullptr) {
+      call_fast_native(ncl.fast, func_stack_idx, _registers.size() - func_stack_idx - 1, nreturn);
+      return true;
+    }
     // Push a new call frame
     lua_call &ci = _callinfo.emplace_back();
     ci.callstatus = 0;
     ci.func_idx = func_stack_idx;
     ci.numresults = nreturn;
-    // Call function
-    int n = ncl.func(*this);
+    // Call function. The function pointer is copied out, as the native may allocate objects,
+    // which can move the closure.
+    lua_native_closure::ptr_t ptr = ncl.ptr;
+    int n = ptr != nullptr ? ptr(*this, ncl.ctx) : ncl.func(*this);
     postcall(_registers.size() - n, n);
     return true;
+  } else if (call_meta(func_stack_idx)) {
+    // A table with __call, which has been replaced by the metamethod
+    return precall(func_stack_idx, nreturn);
   }
   return true;
 }
 
+bool quokka_vm::call_lua(size_t func_idx, unsigned int nargs, int nreturn) {
+  // As the Lua closure path of precall(), without copying the closure's view or adjusting
+  // varargs. This is most calls, including method calls (OP_SELF then OP_CALL).
+  const lua_value &fn = _registers[func_idx];
+  if (!is<object_view>(fn))
+    return false;
+  const lua_object &obj = *std::get<object_view>(fn);
+  if (!is<lua_closure>(obj))
+    return false;
+  bytecode_prototype *proto = std::get<lua_closure>(obj).proto;
+  if (proto->is_var_arg)
+    return false;
+  _registers.reserve(_registers.size() + proto->max_stack_size);
+  for (; nargs < proto->num_params; nargs++)
+    _registers.emplace_back();
+  lua_call &ci = _callinfo.emplace_back();
+  ci.callstatus = CALL_STATUS_LUA;
+  ci.func_idx = func_idx;
+  ci.numresults = nreturn;
+  ci.info.lua.base = func_idx + 1;
+  ci.info.lua.pc = &proto->instructions[0];
+  return true;
+}
+
 #define RL_quokka_vm_PC(ci_ref) ((*ci_ref).info.lua.pc)
 // Obtain an upvalue
 #define RL_quokka_vm_UPV(i, target, cl_ref) { \
@@ -169,29 +551,88 @@ bool quokka_vm::precall(size_t func_stack_idx, int nreturn) {
 // Decode a B or C register, using a constant value or stack value where appropriate
 // Note that lua quokka_vm indexes constants from 1, but upvalues from 0 for some reason.
 #define RL_quokka_vm_RK(v) (opcode_util::is_const(v) ? proto->constants[opcode_util::val(v)] : _registers[_base + opcode_util::val(v)])
+// The inline cache of the current instruction (see inline_cache)
+#define RL_quokka_vm_IC() (proto->cache(RL_quokka_vm_PC(_ci_ref) - 1 - &proto->instructions[0]))
+// Rewrite the opcode of the current instruction, to specialise it (see opcode_util::unquicken)
+#define RL_quokka_vm_QUICKEN(op) \
+  opcode_util::set_opcode(proto->instructions[RL_quokka_vm_PC(_ci_ref) - 1 - &proto->instructions[0]], op)
+// Count a call or loop iteration towards compiling a prototype with the JIT
+#ifdef QUOKKA_JIT
+#define RL_quokka_vm_HOT(proto) do { \
+  if (proto->jit == nullptr && ++proto->jit_hotness == QUOKKA_JIT_THRESHOLD) \
+    quokka_jit::compile(*proto); } while (0)
+#else
+#define RL_quokka_vm_HOT(proto) do { } while (0)
+#endif
+// Take a sample for the profiler at a call or loop iteration, if one is pending (see lua_profiler)
+#define RL_quokka_vm_SAMPLE() do { \
+  if (_profiler != nullptr && _profiler->pending()) \
+    sample_stack(); } while (0)
+// Count the current instruction towards the instruction statistics (see opcode_stats), and
+// charge the cycles since the last one to it. CHARGE charges the last instruction before
+// running compiled code of proto, whose cycles are charged next, or before returning to the
+// host (with proto nullptr), after which nothing is charged until the next instruction.
+#if defined(QUOKKA_OPCODE_CYCLES)
+#define RL_quokka_vm_COUNT(proto) do { \
+  uint64_t now_ = opcode_clock(); \
+  charge_cycles(now_); \
+  _opstats.executed[(size_t)_code]++; \
+  proto->stats.executed++; \
+  _op_last = (size_t)_code; _op_last_proto = proto; _op_last_clock = now_; } while (0)
+#define RL_quokka_vm_CHARGE(proto) do { \
+  uint64_t now_ = opcode_clock(); \
+  charge_cycles(now_); \
+  _op_last = opcode_util::NUM_OPCODES; _op_last_proto = proto; _op_last_clock = now_; } while (0)
+#elif defined(QUOKKA_OPCODE_STATS)
+#define RL_quokka_vm_COUNT(proto) do { \
+  _opstats.executed[(size_t)_code]++; \
+  proto->stats.executed++; } while (0)
+#define RL_quokka_vm_CHARGE(proto) do { } while (0)
+#else
+#define RL_quokka_vm_COUNT(proto) do { } while (0)
+#define RL_quokka_vm_CHARGE(proto) do { } while (0)
+#endif
 
 void quokka_vm::execute() {
   _callinfo.last().callstatus |= CALL_STATUS_FRESH;
  new_call:
   ;
   _ci_ref = call_ref(&_callinfo, _callinfo.size() - 1);
-  reg_ref cl_reg_ref(&_registers, (*_ci_ref).func_idx);
-  _cl_ref = object(*cl_reg_ref);
+  _cl_ref = object(_registers[(*_ci_ref).func_idx]);
   bytecode_prototype *proto = lua_func(_cl_ref).proto;
   _base = (*_ci_ref).info.lua.base;
+  RL_quokka_vm_HOT(proto);
+  RL_quokka_vm_SAMPLE();
 
   while (true) {
+#ifdef QUOKKA_AOT
+    if (proto->aot != nullptr) {
+      // Run AOT compiled code until it exits at an instruction it doesn't handle
+      RL_quokka_vm_CHARGE(proto);
+      size_t pc = proto->aot(*this, RL_quokka_vm_PC(_ci_ref) - &proto->instructions[0]);
+      RL_quokka_vm_PC(_ci_ref) = &proto->instructions[pc];
+    }
+#endif
+#ifdef QUOKKA_JIT
+    if (proto->jit != nullptr) {
+      // Run compiled code until it exits at an instruction it doesn't handle
+      RL_quokka_vm_CHARGE(proto);
+      size_t pc = proto->jit->run(*this, RL_quokka_vm_PC(_ci_ref) - &proto->instructions[0]);
+      RL_quokka_vm_PC(_ci_ref) = &proto->instructions[pc];
+    }
+#endif
     _instruction = *(RL_quokka_vm_PC(_ci_ref)++);
     _code = opcode_util::get_opcode(_instruction);
     _arg_a = opcode_util::get_A(_instruction);
     _ra = _base + (size_t)_arg_a;
     _arg_b = opcode_util::get_B(_instruction);
     _arg_c = opcode_util::get_C(_instruction);
+    RL_quokka_vm_COUNT(proto);
 
     switch(_code) {
       case opcode::OP_MOVE:
         // Move R(B) to R(A)
-        _registers[_ra] = _registers[_base + opcode_util::val(_arg_b)];
+        set_register(_ra, _registers[_base + opcode_util::val(_arg_b)]);
         break;
       case opcode::OP_LOADK:
         // Move K(Bx) to R(A)
@@ -218,31 +659,30 @@ void quokka_vm::execute() {
         // R(A) = Upval[B]
         lua_value *tv;
         RL_quokka_vm_UPV(_arg_b, tv, _cl_ref);
-        _registers.emplace(_ra, *tv);
+        set_register(_ra, *tv);
         break;
       }
-      case opcode::OP_GETTABUP: {
+      case opcode::OP_GETTABUP:
         // R(A) = Upval[B][RK(C)]
-        lua_value *tuv;
-        RL_quokka_vm_UPV(_arg_b, tuv, _cl_ref);
-        lua_table &t = table(*tuv);
-        // _registers[ra] = table.get(RL_quokka_vm_RK(arg_c));
-        _registers.emplace(_ra, t.get(RL_quokka_vm_RK(_arg_c)));
+        if (opcode_util::is_const(_arg_c))
+          vm_ops::gettabup(*this, _arg_a, _arg_b, RL_quokka_vm_RK(_arg_c), RL_quokka_vm_IC());
+        else
+          vm_ops::gettabup(*this, _arg_a, _arg_b, RL_quokka_vm_RK(_arg_c));
         break;
-      }
-      case opcode::OP_GETTABLE: {
+      case opcode::OP_GETTABLE:
         // R(A) = R(B)[RK(C)]
-        lua_table &t = table(_registers[_base + opcode_util::val(_arg_b)]);
-        _registers.emplace(_ra, t.get(RL_quokka_vm_RK(_arg_c)));
+        if (opcode_util::is_const(_arg_c))
+          vm_ops::gettable(*this, _arg_a, opcode_util::val(_arg_b), RL_quokka_vm_RK(_arg_c), RL_quokka_vm_IC());
+        else
+          vm_ops::gettable(*this, _arg_a, opcode_util::val(_arg_b), RL_quokka_vm_RK(_arg_c));
         break;
-      }
-      case opcode::OP_SETTABUP: {
+      case opcode::OP_SETTABUP:
         // Upval[A][RK(B)] = RK(C)
-        lua_value *tupv;
-        RL_quokka_vm_UPV(_arg_a, tupv, _cl_ref);
-        table(*tupv).set(RL_quokka_vm_RK(_arg_b), RL_quokka_vm_RK(_arg_c));
+        if (opcode_util::is_const(_arg_b))
+          vm_ops::settabup(*this, _arg_a, RL_quokka_vm_RK(_arg_b), RL_quokka_vm_RK(_arg_c), RL_quokka_vm_IC());
+        else
+          vm_ops::settabup(*this, _arg_a, RL_quokka_vm_RK(_arg_b), RL_quokka_vm_RK(_arg_c));
         break;
-      }
       case opcode::OP_SETUPVAL: {
         // Upval[B] = R(A)
         // NOTE: Assigns to stack value
@@ -255,22 +695,23 @@ void quokka_vm::execute() {
       }
       case opcode::OP_SETTABLE:
         // R(A)[RK(B)] = RK(C)
-        table(_registers[_ra]).set(RL_quokka_vm_RK(_arg_b), RL_quokka_vm_RK(_arg_c));
+        if (opcode_util::is_const(_arg_b))
+          vm_ops::settable(*this, _arg_a, RL_quokka_vm_RK(_arg_b), RL_quokka_vm_RK(_arg_c), RL_quokka_vm_IC());
+        else
+          vm_ops::settable(*this, _arg_a, RL_quokka_vm_RK(_arg_b), RL_quokka_vm_RK(_arg_c));
         break;
       case opcode::OP_NEWTABLE: {
         // R(A) = {} (size = B,C)
-        object_view objref = alloc_object();
-        objref->emplace<lua_table>();
-        _registers.emplace(_ra, objref);
+        vm_ops::newtable(*this, _arg_a, _arg_b, _arg_c);
         break;
       }
-      case opcode::OP_SELF: {
+      case opcode::OP_SELF:
         // R(A + 1) = R(B); R(A) = R(B)[RK(C)]
-        _registers[_ra + 1] = _registers[_base + opcode_util::val(_arg_b)];
-        lua_table &t = table(_registers[_base + opcode_util::val(_arg_b)]);
-        _registers.emplace(_ra, t.get(RL_quokka_vm_RK(_arg_c)));
+        if (opcode_util::is_const(_arg_c))
+          vm_ops::self(*this, _arg_a, opcode_util::val(_arg_b), RL_quokka_vm_RK(_arg_c), RL_quokka_vm_IC());
+        else
+          vm_ops::self(*this, _arg_a, opcode_util::val(_arg_b), RL_quokka_vm_RK(_arg_c));
         break;
-      }
       case opcode::OP_ADD: {
         // R(A) = RK(B) + RK(C)
         lua_value &nb = RL_quokka_vm_RK(_arg_b);
@@ -281,6 +722,8 @@ void quokka_vm::execute() {
           _registers.emplace(_ra, result);
         } else if (tonumber(nb, lnb) && tonumber(nc, lnc)) {
           _registers.emplace(_ra, lnb + lnc);
+        } else {
+          arith_meta(lua_metamethod::ADD, nb, nc, _ra);
         }
         break;
       }
@@ -294,6 +737,8 @@ void quokka_vm::execute() {
           _registers.emplace(_ra, result);
         } else if (tonumber(nb, lnb) && tonumber(nc, lnc)) {
           _registers.emplace(_ra, lnb - lnc);
+        } else {
+          arith_meta(lua_metamethod::SUB, nb, nc, _ra);
         }
         break;
       }
@@ -307,6 +752,8 @@ void quokka_vm::execute() {
           _registers.emplace(_ra, result);
         } else if (tonumber(nb, lnb) && tonumber(nc, lnc)) {
           _registers.emplace(_ra, lnb * lnc);
+        } else {
+          arith_meta(lua_metamethod::MUL, nb, nc, _ra);
         }
         break;
       }
@@ -320,6 +767,8 @@ void quokka_vm::execute() {
           _registers.emplace(_ra, result);
         } else if (tonumber(nb, lnb) && tonumber(nc, lnc)) {
           _registers.emplace(_ra, fmod(lnb, lnc));
+        } else {
+          arith_meta(lua_metamethod::MOD, nb, nc, _ra);
         }
         break;
       }
@@ -330,6 +779,8 @@ void quokka_vm::execute() {
         lua_number lnb, lnc;
         if (tonumber(nb, lnb) && tonumber(nc, lnc)) {
           _registers.emplace(_ra, pow(lnb, lnc));
+        } else {
+          arith_meta(lua_metamethod::POW, nb, nc, _ra);
         }
         break;
       }
@@ -343,6 +794,8 @@ void quokka_vm::execute() {
           _registers.emplace(_ra, result);
         } else if (tonumber(nb, lnb) && tonumber(nc, lnc)) {
           _registers.emplace(_ra, lnb / lnc);
+        } else {
+          arith_meta(lua_metamethod::DIV, nb, nc, _ra);
         }
         break;
       }
@@ -356,6 +809,8 @@ void quokka_vm::execute() {
           _registers.emplace(_ra, result);
         } else if (tonumber(nb, lnb) && tonumber(nc, lnc)) {
           _registers.emplace(_ra, (lua_integer)(lnb / lnc));
+        } else {
+          arith_meta(lua_metamethod::IDIV, nb, nc, _ra);
         }
         break;
       }
@@ -366,6 +821,8 @@ void quokka_vm::execute() {
         if (is<lua_integer>(nb) && is<lua_integer>(nc)) {
           lua_integer result = std::get<lua_integer>(nb) & std::get<lua_integer>(nc);
           _registers.emplace(_ra, result);
+        } else {
+          arith_meta(lua_metamethod::BAND, nb, nc, _ra);
         }
         break;
       }
@@ -376,6 +833,8 @@ void quokka_vm::execute() {
         if (is<lua_integer>(nb) && is<lua_integer>(nc)) {
           lua_integer result = std::get<lua_integer>(nb) | std::get<lua_integer>(nc);
           _registers.emplace(_ra, result);
+        } else {
+          arith_meta(lua_metamethod::BOR, nb, nc, _ra);
         }
         break;
       }
@@ -386,6 +845,8 @@ void quokka_vm::execute() {
         if (is<lua_integer>(nb) && is<lua_integer>(nc)) {
           lua_integer result = std::get<lua_integer>(nb) ^ std::get<lua_integer>(nc);
           _registers.emplace(_ra, result);
+        } else {
+          arith_meta(lua_metamethod::BXOR, nb, nc, _ra);
         }
         break;
       }
@@ -396,6 +857,8 @@ void quokka_vm::execute() {
         if (is<lua_integer>(nb) && is<lua_integer>(nc)) {
           lua_integer result = std::get<lua_integer>(nb) << std::get<lua_integer>(nc);
           _registers.emplace(_ra, result);
+        } else {
+          arith_meta(lua_metamethod::SHL, nb, nc, _ra);
         }
         break;
       }
@@ -406,6 +869,8 @@ void quokka_vm::execute() {
         if (is<lua_integer>(nb) && is<lua_integer>(nc)) {
           lua_integer result = std::get<lua_integer>(nb) >> std::get<lua_integer>(nc);
           _registers.emplace(_ra, result);
+        } else {
+          arith_meta(lua_metamethod::SHR, nb, nc, _ra);
         }
         break;
       }
@@ -417,6 +882,8 @@ void quokka_vm::execute() {
           _registers.emplace(_ra, -std::get<lua_integer>(n));
         } else if (tonumber(n, ln)) {
           _registers.emplace(_ra, -ln);
+        } else {
+          arith_meta(lua_metamethod::UNM, n, n, _ra);
         }
         break;
       }
@@ -427,6 +894,8 @@ void quokka_vm::execute() {
         if (tointeger(n, li)) {
           // _registers[ra] = ~li;
           _registers.emplace(_ra, ~li);
+        } else {
+          arith_meta(lua_metamethod::BNOT, n, n, _ra);
         }
         break;
       }
@@ -444,13 +913,24 @@ void quokka_vm::execute() {
         } else if (is<object_view>(n)) {
           object_view o = object(n);
           if (is<lua_table>(*o)) {
-            _registers.emplace(_ra, (lua_integer) table(o).entries.size());
+            const lua_value *h = table(o).lacks_metamethod(lua_metamethod::LEN) ? nullptr : find_metamethod(n, lua_metamethod::LEN);
+            if (h != nullptr) {
+              lua_value f = *h;
+              lua_value len = call_metamethod(f, n, n);
+              set_register(_ra, len);
+            } else {
+              _registers.emplace(_ra, (lua_integer) table(o).entries.size());
+            }
+          } else if (is<lua_array>(*o)) {
+            _registers.emplace(_ra, (lua_integer) std::get<lua_array>(*o).length);
           }
         }
         break;
       }
       case opcode::OP_CONCAT: {
         // R(A) = R(B) .. .. R(C)
+        if (concat_meta(_ra, _base + _arg_b, _base + _arg_c))
+          break;
         if (_ra != _base + _arg_b)
           _registers.emplace(_ra, _registers[_base + _arg_b]);
         for (size_t i = _base + _arg_b + 1; i <= _base + _arg_c; i++)
@@ -464,24 +944,29 @@ void quokka_vm::execute() {
           close_upvals(_ra - 1);
         }
         RL_quokka_vm_PC(_ci_ref) += opcode_util::get_sBx(_instruction);
+        // Loop back-edge
+        if (opcode_util::get_sBx(_instruction) < 0) {
+          RL_quokka_vm_HOT(proto);
+          RL_quokka_vm_SAMPLE();
+        }
         break;
       }
       case opcode::OP_EQ: {
         // if ((RK(B) == RK(C)) ~= A) then pc++ (skip jmp), otherwise do next jump
-        if ((RL_quokka_vm_RK(_arg_b) == RL_quokka_vm_RK(_arg_c)) != _arg_a) {
+        if (vm_ops::eq(*this, RL_quokka_vm_RK(_arg_b), RL_quokka_vm_RK(_arg_c)) != _arg_a) {
           RL_quokka_vm_PC(_ci_ref)++;
         }
         break;
       }
       case opcode::OP_LT:
         // if ((RK(B) <  RK(C)) ~= A) then pc++ (skip jmp), otherwise do next jump
-        if ((RL_quokka_vm_RK(_arg_b) < RL_quokka_vm_RK(_arg_c)) != _arg_a) {
+        if (vm_ops::lt(*this, RL_quokka_vm_RK(_arg_b), RL_quokka_vm_RK(_arg_c)) != _arg_a) {
           RL_quokka_vm_PC(_ci_ref)++;
         }
         break;
       case opcode::OP_LE:
         // if ((RK(B) <= RK(C)) ~= A) then pc++ (skip jmp), otherwise do next jump
-        if ((RL_quokka_vm_RK(_arg_b) <= RL_quokka_vm_RK(_arg_c)) != _arg_a) {
+        if (vm_ops::le(*this, RL_quokka_vm_RK(_arg_b), RL_quokka_vm_RK(_arg_c)) != _arg_a) {
           RL_quokka_vm_PC(_ci_ref)++;
         }
         break;
@@ -502,15 +987,40 @@ void quokka_vm::execute() {
           RL_quokka_vm_PC(_ci_ref)++;
         } else {
           // R(A) = R(B), do next jump
-          _registers.emplace(_ra, tb);
+          set_register(_ra, tb);
           // Continue to next instruction (jmp)
         }
         break;
       }
+      case opcode::OP_CALL_INTRINSIC:
+        // OP_CALL of an intrinsic, guarded on R(A) still being an intrinsic
+        if (call_intrinsic(_ra, _arg_b - 1))
+          break;
+        // R(A) has changed (e.g. the global was reassigned), so go back to a regular call
+        RL_quokka_vm_QUICKEN(opcode::OP_CALL);
+        [[fallthrough]];
       case opcode::OP_CALL: {
         int nresults = _arg_c - 1;
+        if (_arg_b != 0 && _arg_b <= 3 && nresults == 1 && call_intrinsic(_ra, _arg_b - 1)) {
+          // Run calls to this intrinsic inline from now on
+          RL_quokka_vm_QUICKEN(opcode::OP_CALL_INTRINSIC);
+          break;
+        }
         if (_arg_b != 0) {
-          // Set new top? This should be done already.
+          // The arguments are the top of the stack (above them are temporaries of the caller,
+          // which are out of scope), so that natives and varargs don't see them as arguments.
+          _registers.chop(_ra + _arg_b);
+          if (call_lua(_ra, _arg_b - 1, nresults))
+            goto new_call;
+          // Fast natives are called in place, without going through precall() or a call frame
+          const lua_value &fn = _registers[_ra];
+          if (is<object_view>(fn) && is<lua_native_closure>(*object(fn))) {
+            lua_fast_native fast = native_func(object(fn)).fast;
+            if (fast != nullptr) {
+              call_fast_native(fast, _ra, _arg_b - 1, nresults);
+              break;
+            }
+          }
         }
         if (!precall(_ra, nresults)) {
           // Lua Func
@@ -552,8 +1062,10 @@ void quokka_vm::execute() {
           close_upvals(_base);
         }
         postcall(_ra, (_arg_b != 0 ? (_arg_b - 1) : (_registers.size() - _ra)));
-        if ((*_ci_ref).callstatus & CALL_STATUS_FRESH)
+        if ((*_ci_ref).callstatus & CALL_STATUS_FRESH) {
+          RL_quokka_vm_CHARGE(nullptr);
           return;   // Invoked externally, can just return
+        }
         else {
           goto new_call;
         }
@@ -583,6 +1095,40 @@ void quokka_vm::execute() {
             _registers.emplace(_ra + 3, idx);
           }
         }
+        RL_quokka_vm_HOT(proto);
+        RL_quokka_vm_SAMPLE();
+        break;
+      }
+      case opcode::OP_FORLOOP_INT: {
+        // OP_FORLOOP, where OP_FORPREP has made R(A), R(A+1) and R(A+2) integers. These are
+        // hidden from the script, so are updated in place without checking their type.
+        lua_integer &idx = *std::get_if<lua_integer>(&_registers[_ra]);
+        lua_integer limit = *std::get_if<lua_integer>(&_registers[_ra + 1]);
+        lua_integer step = *std::get_if<lua_integer>(&_registers[_ra + 2]);
+        lua_integer next = idx + step;
+        if ( (step > 0) ? (next <= limit) : (limit <= next) ) {
+          RL_quokka_vm_PC(_ci_ref) += opcode_util::get_sBx(_instruction);
+          idx = next;
+          // Only the visible loop variable is written as a value
+          vm_ops::set_number(*this, _arg_a + 3, next);
+        }
+        RL_quokka_vm_HOT(proto);
+        RL_quokka_vm_SAMPLE();
+        break;
+      }
+      case opcode::OP_FORLOOP_FLT: {
+        // OP_FORLOOP, where OP_FORPREP has made R(A), R(A+1) and R(A+2) floats
+        lua_number &idx = *std::get_if<lua_number>(&_registers[_ra]);
+        lua_number limit = *std::get_if<lua_number>(&_registers[_ra + 1]);
+        lua_number step = *std::get_if<lua_number>(&_registers[_ra + 2]);
+        lua_number next = idx + step;
+        if ( (step > 0) ? (next <= limit) : (limit <= next) ) {
+          RL_quokka_vm_PC(_ci_ref) += opcode_util::get_sBx(_instruction);
+          idx = next;
+          vm_ops::set_number(*this, _arg_a + 3, next);
+        }
+        RL_quokka_vm_HOT(proto);
+        RL_quokka_vm_SAMPLE();
         break;
       }
       case opcode::OP_FORPREP: {
@@ -612,26 +1158,34 @@ void quokka_vm::execute() {
           step.emplace<lua_number>(nstep);
         }
         RL_quokka_vm_PC(_ci_ref) += opcode_util::get_sBx(_instruction);
+        // Specialise the OP_FORLOOP of this loop for the types of its counter, limit and step
+        lua_instruction &loop = proto->instructions[RL_quokka_vm_PC(_ci_ref) - &proto->instructions[0]];
+        opcode_util::set_opcode(loop, is<lua_integer>(init) ? opcode::OP_FORLOOP_INT : opcode::OP_FORLOOP_FLT);
         break;
       }
       case opcode::OP_TFORCALL: {
         // R(A+3) ... R(A+2+C) = R(A)( R(A+1), R(A+2) )
+        // Iterators (e.g. next) are run in place, without copying the call or a call frame
+        if (call_iterator(_ra, _arg_c))
+          break;
         // Setup the R(A)( R(A+1), R(A+2) )
         size_t call_base = _ra + 3;
-        _registers.emplace(call_base + 2, _registers[_ra + 2]);
-        _registers.emplace(call_base + 1, _registers[_ra + 1]);
-        _registers.emplace(call_base, _registers[_ra]);
-        // Expecting _arg_c return values
+        set_register(call_base + 2, _registers[_ra + 2]);
+        set_register(call_base + 1, _registers[_ra + 1]);
+        set_register(call_base, _registers[_ra]);
+        // The arguments are the top of the stack, as the body of the loop is out of scope
+        _registers.chop(call_base + 3);
+        // Expecting _arg_c return values. A Lua function is run as a call from this frame,
+        // returning to the next instruction (OP_TFORLOOP) as OP_CALL does.
         if (!precall(call_base, _arg_c))
-          execute();
-        // Next instruction is OP_TFORLOOP, so let the loop go ahead
+          goto new_call;
         break;
       }
       case opcode::OP_TFORLOOP: {
         // if R(A+1) ~= nil then { R(A) = R(A+1); pc += sBx }
         lua_value &tv1 = _registers[_ra + 1];
         if (is_assigned(tv1)) {
-          _registers.emplace(_ra, tv1);
+          set_register(_ra, tv1);
           RL_quokka_vm_PC(_ci_ref) += opcode_util::get_sBx(_instruction);
         }
         break;
@@ -659,10 +1213,13 @@ void quokka_vm::execute() {
         }
         size_t stack_pop = _registers.size() - b;
 
-        // Work backwards, saves us assigning a new iterator var
-        lua_integer table_idx = ((c - 1) * fpf + b);
-        for (; b > 0; b--) {
-          t.set(table_idx--, _registers[_ra + b]);
+        // Set the elements in order, so that they extend the sequence of the table and are
+        // appended without searching its entries (see lua_table::sequence). Constructors with
+        // more elements than their size hint (e.g. from varargs) reserve them here.
+        lua_integer table_idx = (c - 1) * fpf + 1;
+        t.reserve(t.entries.size() + b);
+        for (size_t i = 1; i <= b; i++) {
+          t.set(table_idx++, _registers[_ra + i]);
         }
 
         // Pop the stack constants
@@ -671,8 +1228,7 @@ void quokka_vm::execute() {
       }
       case opcode::OP_CLOSURE: {
         // R(A) = closure(KPROTO[Bx])
-        lua_closure &this_closure = lua_func(_cl_ref);
-        bytecode_prototype &proto = *this_closure.proto->protos[opcode_util::get_Bx(_instruction)];
+        bytecode_prototype &proto = *lua_func(_cl_ref).proto->protos[opcode_util::get_Bx(_instruction)];
         object_view cache = lclosure_cache(proto, _base, _cl_ref);
         if (cache.is_valid()) {
           _registers.emplace(_ra, cache);
@@ -694,7 +1250,7 @@ void quokka_vm::execute() {
         
         int j;
         for (j = 0; j < b && j < n; j++)
-          _registers.emplace(_ra + j, _registers[_base - n + j]);
+          set_register(_ra + j, _registers[_base - n + j]);
         for (; j < b; j++)
           _registers.emplace(_ra + j); // nil
         
@@ -722,13 +1278,13 @@ bool quokka_vm::postcall(size_t first_result_idx, int nreturn) {
         // Set first result to nil
         _registers.emplace(first_result_idx);
       }
-      _registers.emplace(res, _registers[first_result_idx]);
+      set_register(res, _registers[first_result_idx]);
       break;
     }
     case MULTIRET: {
       // Multiple returns
       for (int i = 0; i < nreturn; i++)
-        _registers.emplace(res + i, _registers[first_result_idx + i]);
+        set_register(res + i, _registers[first_result_idx + i]);
       _registers.chop(res + nreturn);
       return false;
     }
@@ -737,11 +1293,11 @@ bool quokka_vm::postcall(size_t first_result_idx, int nreturn) {
       if (wanted <= nreturn) {
         // Have enough (or more than enough) results
         for (i = 0; i < wanted; i++)
-          _registers.emplace(res + i, _registers[first_result_idx + i]);
+          set_register(res + i, _registers[first_result_idx + i]);
       } else {
         // Not enough results, pad with nils
         for (i = 0; i < nreturn; i++)
-          _registers.emplace(res + i, _registers[first_result_idx + i]);
+          set_register(res + i, _registers[first_result_idx + i]);
         for (; i < wanted; i++)
           _registers.emplace(res + i);  // nil
       }
@@ -752,46 +1308,99 @@ bool quokka_vm::postcall(size_t first_result_idx, int nreturn) {
   return true;
 }
 
+bool quokka_vm::is_open_upval(const open_upval &ou) const {
+  // The upval may have been freed (and its slot reused) since it was opened
+  if (ou.idx >= _upvals.size())
+    return false;
+  const lua_upval &uv = _upvals[ou.idx];
+  return !uv.is_free() && is<size_t>(uv) && std::get<size_t>(uv) == ou.level;
+}
+
 void quokka_vm::close_upvals(size_t level) {
-  for (size_t i = 0; i < _upvals.size(); i++) {
-    lua_upval &uv = _upvals[i];
-    // Ensure upval is open
-    if (!uv.is_free() && is<size_t>(uv)) {
-      size_t stack_idx = std::get<size_t>(uv);
-      if (level <= stack_idx) {
-        // Close upval
-        uv.emplace<lua_value>(_registers[stack_idx]);
-      }
+  // Open upvals are sorted by level, so only the ones at or above the level are visited
+  size_t n = _open_upvals.size();
+  while (n > 0 && _open_upvals[n - 1].level >= level) {
+    const open_upval &ou = _open_upvals[--n];
+    if (is_open_upval(ou)) {
+      // Close upval
+      _upvals[ou.idx].emplace<lua_value>(_registers[ou.level]);
     }
   }
+  _open_upvals.chop(n);
 }
 
-object_view quokka_vm::lclosure_cache(bytecode_prototype &proto, size_t base, object_view parent_cl) {
-  object_view cl_ref = proto.closure_cache;
-  if (cl_ref.is_valid()) {
-    int num_upval = proto.num_upvalues;
-    for (int i = 0; i < num_upval; i++) {
-      bytecode_upvalue v = proto.upvalues[i];
-      lua_value tval_cache, tval_target;
-      // Get the actual upvalue from the closure cache
-      RL_quokka_vm_UPV(i, tval_cache, cl_ref);
-      // Get the target tval (either in the stack, or inherited from parent)
-      if (v.instack) {
-        tval_target = _registers[base + v.idx];
-      } else {
-        RL_quokka_vm_UPV(v.idx, tval_target, parent_cl);
-      }
+upval_view quokka_vm::find_upval(size_t level) {
+  size_t n = _open_upvals.size();
+  while (n > 0 && _open_upvals[n - 1].level >= level) {
+    n--;
+    if (!is_open_upval(_open_upvals[n])) {
+      // Drop the stale entry
+      for (size_t j = n + 1; j < _open_upvals.size(); j++)
+        _open_upvals[j - 1] = _open_upvals[j];
+      _open_upvals.chop(_open_upvals.size() - 1);
+    } else if (_open_upvals[n].level == level) {
+      return upval_view(&_upvals, _open_upvals[n].idx);
+    }
+  }
 
-      if (!(tval_cache == tval_target))
-        return object_view(); // upvalues don't match
+  // Upval could not be found - make a new one, keeping the list sorted
+  upval_view uvr = alloc_upval();
+  uvr->emplace<size_t>(level);
+  _open_upvals.emplace_back();
+  for (size_t j = _open_upvals.size() - 1; j > n; j--)
+    _open_upvals[j] = _open_upvals[j - 1];
+  _open_upvals[n] = open_upval{ level, uvr.index() };
+  return uvr;
+}
+
+bool quokka_vm::lclosure_matches(const lua_object &o, const bytecode_prototype &proto, size_t base, const lua_closure &parent) const {
+  if (!is<lua_closure>(o))
+    return false;
+  const lua_closure &cl = std::get<lua_closure>(o);
+  if (cl.proto != &proto)
+    return false;
+  // Upvals are compared by identity, as the closure must share its variables with the new one
+  for (int i = 0; i < proto.num_upvalues; i++) {
+    bytecode_upvalue v = proto.upvalues[i];
+    const upval_view &uv = cl.upval_views[i];
+    if (v.instack) {
+      // The upval must still be open on the register, as find_upval() would return it
+      const lua_upval &upv = *uv;
+      if (!is<size_t>(upv) || std::get<size_t>(upv) != base + v.idx)
+        return false;
+    } else if (uv.index() != parent.upval_views[v.idx].index()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+object_view quokka_vm::lclosure_cache(bytecode_prototype &proto, size_t base, object_view parent_cl) {
+  const lua_closure &parent = lua_func(parent_cl);
+  const closure_pool &pool = proto.closures;
+  for (size_t i = 0; i < closure_pool::SIZE; i++) {
+    size_t slot = pool.slots[i];
+    if (slot < _objects.size() && lclosure_matches(_objects[slot], proto, base, parent))
+      return object_view(&_objects, slot);
+  }
+  if (pool.constant) {
+    // The slots may have been taken by the closures of another VM loading the same chunk
+    for (size_t i = 0; i < _constant_closures.size(); i++) {
+      if (lclosure_matches(*_constant_closures[i], proto, base, parent))
+        return _constant_closures[i];
     }
   }
-  return cl_ref;
+  return object_view();
 }
 
 object_view quokka_vm::lclosure_new(bytecode_prototype &proto, size_t base, object_view parent_cl) {
   int num_upval = proto.num_upvalues;
-  object_view new_closure = alloc_object();
+  closure_pool &pool = proto.closures;
+  // A closure that has been freed leaves its slot to the next closure of the prototype. Closures
+  // are always counted, even with deferred reference counting, so that they are freed (rather
+  // than pending) as soon as they are dropped.
+  object_view new_closure = alloc_object(pool.slots, closure_pool::SIZE);
+  new_closure->defer(false);
   lua_closure &ncl = new_closure->emplace<lua_closure>();
   ncl.proto = &proto;
   
@@ -799,35 +1408,21 @@ object_view quokka_vm::lclosure_new(bytecode_prototype &proto, size_t base, obje
   for (int i = 0; i < num_upval; i++) {
     bytecode_upvalue v = proto.upvalues[i];
     if (v.instack) {
-      // Find upval
-      bool upval_found = false;
-      size_t level = base + v.idx;
-      for (size_t i = 0; i < _upvals.size() && !upval_found; i++) {
-        lua_upval &uv = _upvals[i];
-        // Ensure upval is open
-        if (!uv.is_free() && is<size_t>(uv)) {
-          size_t stack_idx = std::get<size_t>(uv);
-          if (stack_idx == level) {
-            ncl.upval_views.emplace(i, upval_view(&_upvals, i));
-            upval_found = true;
-          }
-        }
-      }
-
-      // Upval could not be found - make a new one
-      if (!upval_found) {
-        upval_view uvr = alloc_upval();
-        uvr->emplace<size_t>(level);
-        ncl.upval_views.emplace(i, uvr);
-      }
+      ncl.upval_views.emplace(i, find_upval(base + v.idx));
     } else {
       // Use upval from parent function
       ncl.upval_views.emplace(i, lua_func(parent_cl).upval_views[v.idx]);
     }
   }
 
-  // Save the closure in a cache in the prototype
-  proto.closure_cache = new_closure;
+  // Save the closure's slot in the prototype's pool, unless it reclaimed one of them
+  size_t slot = new_closure.index();
+  if (std::find(pool.slots, pool.slots + closure_pool::SIZE, slot) == pool.slots + closure_pool::SIZE) {
+    pool.slots[pool.next] = slot;
+    pool.next = (pool.next + 1) % closure_pool::SIZE;
+  }
+  if (pool.constant)
+    _constant_closures.emplace_back(new_closure);
 
   return new_closure;
 }
\ No newline at end of file
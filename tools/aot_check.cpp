@@ -0,0 +1,92 @@
+/**
+ * Checks that the sample scripts produce the same output when compiled with the AOT compiler
+ * (see aot_compiler) as they do in the interpreter. Built and run by `make aot_check`, which
+ * compiles each script with `quokka --aot`, and lists them in aot_scripts.h.
+ */
+#include "quokka/engine.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace quokka::engine;
+
+#define AOT_SCRIPT(name) bool name##_attach(bytecode_chunk &chunk);
+#include "aot_scripts.h"
+#undef AOT_SCRIPT
+
+struct aot_script {
+  const char *name;
+  bool (*attach)(bytecode_chunk &chunk);
+};
+
+static const aot_script scripts[] = {
+#define AOT_SCRIPT(name) { #name, name##_attach },
+#include "aot_scripts.h"
+#undef AOT_SCRIPT
+};
+
+/**
+ * Run a script, returning everything it prints. os.clock() always returns 0, so that the
+ * output of benchmarks is the same between runs.
+ * @param attach The attach function of the AOT compiled script, or nullptr to interpret it
+ * @param seconds Output for the time taken to run the script
+ * @return false if the AOT compiled code could not be attached to the script
+ */
+static bool run(const aot_script &script, bool (*attach)(bytecode_chunk &), std::string &out, double &seconds) {
+  quokka_vm v;
+  std::ifstream bytecode_in(std::string(AOT_GEN_PATH "/") + script.name + ".out");
+  bytecode_reader reader(bytecode_in);
+  bytecode_chunk chunk = reader.read_chunk();
+  if (attach != nullptr && !attach(chunk))
+    return false;
+
+  v.load(chunk);
+  intrinsics::define_all(v);
+  iterators::define_all(v);
+  metatables::define_all(v);
+  vec::define(v);
+  v.define_native_function("print", [&out](quokka_vm &v) {
+    for (int i = 0; i < v.num_arguments(); i++) {
+      if (i > 0) out += "\t";
+      out += tostring(v.argument(i)).c_str();
+    }
+    out += "\n";
+    return 0;
+  });
+
+  object_view clock_func = v.alloc_native_function([](quokka_vm &v, void *) {
+    v.push((lua_number)0);
+    return 1;
+  });
+  object_view os = v.alloc_object();
+  os->emplace<lua_table>().set("clock", clock_func);
+  v.env().set("os", os);
+
+  auto start = std::chrono::steady_clock::now();
+  v.call();
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return true;
+}
+
+int main() {
+  int failed = 0;
+  for (const aot_script &script : scripts) {
+    std::string interp_out, aot_out;
+    double interp_time = 0, aot_time = 0;
+    run(script, nullptr, interp_out, interp_time);
+
+    if (!run(script, script.attach, aot_out, aot_time)) {
+      std::cout << "FAIL " << script.name << ": compiled code does not match the bytecode" << std::endl;
+      failed++;
+    } else if (interp_out != aot_out) {
+      std::cout << "FAIL " << script.name << ": output differs" << std::endl;
+      std::cout << "--- interpreter" << std::endl << interp_out << "--- aot" << std::endl << aot_out;
+      failed++;
+    } else {
+      std::cout << "ok   " << script.name << " (interpreter " << interp_time << "s, aot " << aot_time << "s)" << std::endl;
+    }
+  }
+  return failed > 0 ? 1 : 0;
+}
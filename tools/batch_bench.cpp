@@ -0,0 +1,66 @@
+/**
+ * Benchmarks calling a Lua function over 1M records, one call at a time (push, call and pop
+ * for each record) and with quokka_vm::call_batch(). Built and run by `make batch_bench`.
+ */
+#include "quokka/engine.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace quokka::engine;
+
+static const size_t NUM_RECORDS = 1000000;
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cout << "Usage: batch_bench batch_bench.out" << std::endl;
+    return 1;
+  }
+  quokka_vm v;
+  std::ifstream bytecode_in(argv[1]);
+  bytecode_reader reader(bytecode_in);
+  bytecode_chunk chunk = reader.read_chunk();
+  v.load(chunk);
+  v.call();
+  lua_value process = v.env().get("process");
+
+  std::vector<lua_value> ids, prices, quantities;
+  for (size_t i = 0; i < NUM_RECORDS; i++) {
+    ids.emplace_back((lua_integer)i);
+    prices.emplace_back((lua_number)((i % 100) * 0.25));
+    quantities.emplace_back((lua_integer)(i % 17));
+  }
+
+  // One call per record
+  std::vector<lua_value> totals(NUM_RECORDS), flags(NUM_RECORDS);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < NUM_RECORDS; i++) {
+    v.push(process);
+    v.push(ids[i]);
+    v.push(prices[i]);
+    v.push(quantities[i]);
+    v.call(3, 2);
+    flags[i] = v.pop();
+    totals[i] = v.pop();
+  }
+  double single = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Batched
+  std::vector<lua_value> batch_totals(NUM_RECORDS), batch_flags(NUM_RECORDS);
+  const lua_value *inputs[] = { ids.data(), prices.data(), quantities.data() };
+  lua_value *outputs[] = { batch_totals.data(), batch_flags.data() };
+  start = std::chrono::steady_clock::now();
+  v.call_batch(process, inputs, 3, outputs, 2, NUM_RECORDS);
+  double batch = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (totals != batch_totals || flags != batch_flags) {
+    std::cout << "FAIL: batched results differ" << std::endl;
+    return 1;
+  }
+  std::cout << NUM_RECORDS << " records" << std::endl
+            << "call():       " << single << "s (" << (NUM_RECORDS / single) << " records/s)" << std::endl
+            << "call_batch(): " << batch << "s (" << (NUM_RECORDS / batch) << " records/s)" << std::endl;
+  return 0;
+}
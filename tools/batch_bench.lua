@@ -0,0 +1,8 @@
+-- The record processing function for tools/batch_bench.cpp
+function process(id, price, quantity)
+  local total = price * quantity
+  if id % 10 == 0 then
+    total = total * 0.9
+  end
+  return total, total > 100
+end